@@ -0,0 +1,7 @@
+// Variable lookups - locals, variables in outer scopes, globals, and short function calls
+function t(name, fn) { var s=getTime(); fn(); print(name, Math.round((getTime()-s)*1000)+"ms"); }
+t("locals", function() { var a=0,b=1,c=2,d=3,e=4; for (var i=0;i<100000;i++) { a=a+b+c+d+e; b=a&255; } });
+t("closure", function() { var x=1,y=2; (function(){ (function(){ var s=0; for (var i=0;i<100000;i++) s=s+x+y; })(); })(); });
+var g1=1,g2=2,g3=3;
+t("globals", function() { var s=0; for (var i=0;i<100000;i++) s=s+g1+g2+g3; });
+t("calls", function() { function add(p,q){ var r=p+q; return r; } var s=0; for (var i=0;i<50000;i++) s=add(s,i); });
@@ -19,6 +19,9 @@
 #include "jsparse.h"
 #include "socketserver.h"
 #include "network.h"
+#if defined(LINUX)
+#include "network_linux.h"
+#endif
 
 /*JSON{
   "type" : "idle",
@@ -54,6 +57,29 @@ void jswrap_net_kill() {
   }
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "blockNetSends",
+  "#if" : "defined(LINUX)",
+  "ifndef" : "RELEASE",
+  "generate" : "jswrap_net_blockNetSends",
+  "params" : [
+    ["count","int","How many TCP sends to block"]
+  ],
+  "return" : ["int","How many sends were still left to block from the last call"]
+}
+Make the next `count` TCP sends fail as if the socket's send buffer was full,
+so the socket waits until it is writable again - for testing only.
+*/
+#if defined(LINUX) && !defined(RELEASE)
+int jswrap_net_blockNetSends(int count) {
+  int left = net_linux_sendsToBlock;
+  net_linux_sendsToBlock = count;
+  return left;
+}
+#endif
+
 
 // ---------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------
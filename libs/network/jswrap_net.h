@@ -19,6 +19,7 @@
 bool jswrap_net_idle();
 void jswrap_net_init();
 void jswrap_net_kill();
+int jswrap_net_blockNetSends(int count);
 
 JsVar *jswrap_url_parse(JsVar *url, bool parseQuery);
 
@@ -42,6 +42,11 @@
 
 #define closesocket(SOCK) close(SOCK)
 
+#ifdef __linux__
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #if NET_DBG > 0
  #include "jsinteractive.h"
  #define DBG(format, ...) jsiConsolePrintf(format, ## __VA_ARGS__)
@@ -49,6 +54,97 @@
 #define DBG(format, ...) do { } while(0)
 #endif
 
+#ifdef USE_EPOLL
+/* Every socket we create or accept is added to one epoll set. net_linux_idle
+ * checks it once per idle loop and remembers which sockets have something
+ * waiting, so recv/accept only make a system call for those, and jshSleep
+ * can wait on the set (net_linux_sleep) rather than just delaying. */
+#define EPOLL_MAX_SOCKETS 1024 ///< sockets numbered above this aren't watched, and are always checked
+#define EPOLL_MAX_EVENTS 64 ///< events handled per idle loop - any more stay ready for next time
+
+#define SOCKET_WATCHED 1 ///< socket is in the epoll set
+#define SOCKET_READABLE 2 ///< data, a connection or an error is waiting
+#define SOCKET_WAIT_WRITE 4 ///< the last send would have blocked, so wait for EPOLLOUT
+
+static int epollFd = -1;
+static unsigned char socketFlags[EPOLL_MAX_SOCKETS];
+
+static bool net_linux_isWatched(int sckt) {
+  return sckt>=0 && sckt<EPOLL_MAX_SOCKETS && (socketFlags[sckt]&SOCKET_WATCHED);
+}
+
+static void net_linux_setEvents(int sckt, int op, uint32_t events) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = sckt;
+  if (epoll_ctl(epollFd, op, sckt, &ev)<0)
+    socketFlags[sckt] = 0; // not watched - we'll just check it every time
+}
+
+/// Add a new socket to the epoll set
+static void net_linux_watch(int sckt) {
+  if (sckt<0 || sckt>=EPOLL_MAX_SOCKETS) return;
+  if (epollFd<0) epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd<0) return;
+  socketFlags[sckt] = SOCKET_WATCHED; // level triggered, so anything already waiting gets reported
+  net_linux_setEvents(sckt, EPOLL_CTL_ADD, EPOLLIN);
+}
+#endif
+
+/// Is there something to read on this socket? Returns SOCKET_ERROR, 0, or 1
+static int net_linux_canRead(int sckt) {
+#ifdef USE_EPOLL
+  if (net_linux_isWatched(sckt)) {
+    // level triggered, so if there's still more epoll will tell us again
+    bool readable = socketFlags[sckt]&SOCKET_READABLE;
+    socketFlags[sckt] &= (unsigned char)~SOCKET_READABLE;
+    return readable;
+  }
+#endif
+  fd_set s;
+  FD_ZERO(&s);
+  FD_SET(sckt,&s);
+  struct timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 0;
+  return select(sckt+1,&s,NULL,NULL,&timeout);
+}
+
+/// Is there space to send on this socket? Returns SOCKET_ERROR, 0, or 1
+static int net_linux_canWrite(int sckt) {
+#ifdef USE_EPOLL
+  if (net_linux_isWatched(sckt))
+    return !(socketFlags[sckt]&SOCKET_WAIT_WRITE);
+#endif
+  fd_set writefds;
+  FD_ZERO(&writefds);
+  FD_SET(sckt, &writefds);
+  struct timeval time;
+  time.tv_sec = 0;
+  time.tv_usec = 0;
+  int n = select(sckt+1, 0, &writefds, 0, &time);
+  if (n==SOCKET_ERROR) return n;
+  return FD_ISSET(sckt, &writefds) ? 1 : 0;
+}
+
+/// Did the last call fail just because it would have had to block?
+static bool net_linux_wouldBlock() {
+  return errno==EAGAIN || errno==EWOULDBLOCK;
+}
+
+/// A send would have blocked - don't try again until there's space. Always returns 0 (nothing sent)
+static int net_linux_waitForWrite(int sckt) {
+#ifdef USE_EPOLL
+  if (net_linux_isWatched(sckt)) {
+    socketFlags[sckt] |= SOCKET_WAIT_WRITE;
+    net_linux_setEvents(sckt, EPOLL_CTL_MOD, EPOLLIN|EPOLLOUT);
+  }
+#else
+  NOT_USED(sckt);
+#endif
+  return 0;
+}
 
 /// Get an IP address from a name. Sets out_ip_addr to 0 on failure
 void net_linux_gethostbyname(JsNetwork *net, char * hostName, uint32_t* out_ip_addr) {
@@ -61,6 +157,37 @@ void net_linux_gethostbyname(JsNetwork *net, char * hostName, uint32_t* out_ip_a
 /// Called on idle. Do any checks required for this device
 void net_linux_idle(JsNetwork *net) {
   NOT_USED(net);
+#ifdef USE_EPOLL
+  if (epollFd<0) return;
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  int i, n = epoll_wait(epollFd, events, EPOLL_MAX_EVENTS, 0);
+  for (i=0;i<n;i++) {
+    int sckt = events[i].data.fd;
+    if (!net_linux_isWatched(sckt)) continue;
+    // errors and hangups are 'readable' so that recv reports them
+    if (events[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP))
+      socketFlags[sckt] |= SOCKET_READABLE;
+    if ((events[i].events & (EPOLLOUT|EPOLLERR|EPOLLHUP)) &&
+        (socketFlags[sckt] & SOCKET_WAIT_WRITE)) {
+      socketFlags[sckt] &= (unsigned char)~SOCKET_WAIT_WRITE;
+      net_linux_setEvents(sckt, EPOLL_CTL_MOD, EPOLLIN);
+    }
+  }
+#endif
+}
+
+/// Wait for up to the given time for one of our sockets to become ready. Returns false if we have no way of waiting on them
+bool net_linux_sleep(unsigned int usecs) {
+#ifdef USE_EPOLL
+  if (epollFd<0) return false;
+  // we don't handle the event here - it's still there for net_linux_idle
+  struct epoll_event event;
+  epoll_wait(epollFd, &event, 1, (int)(usecs/1000));
+  return true;
+#else
+  NOT_USED(usecs);
+  return false;
+#endif
 }
 
 /// Call just before returning to idle loop. This checks for errors and tries to recover. Returns true if no errors.
@@ -199,12 +326,20 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
     jsWarn("setsockopt(SO_NOSIGPIPE) failed\n");
 #endif
 
+#ifdef USE_EPOLL
+  net_linux_watch(sckt);
+#endif
   return sckt;
 }
 
 /// destroys the given socket
 void net_linux_closesocket(JsNetwork *net, int sckt) {
   NOT_USED(net);
+#ifdef USE_EPOLL
+  // closing removes it from the epoll set
+  if (sckt>=0 && sckt<EPOLL_MAX_SOCKETS)
+    socketFlags[sckt] = 0;
+#endif
   closesocket(sckt);
 }
 
@@ -212,17 +347,13 @@ void net_linux_closesocket(JsNetwork *net, int sckt) {
 int net_linux_accept(JsNetwork *net, int sckt) {
   NOT_USED(net);
   // TODO: look for unreffed servers?
-  fd_set s;
-  FD_ZERO(&s);
-  FD_SET(sckt,&s);
   // check for waiting clients
-  struct timeval timeout;
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 0;
-  int n = select(sckt+1,&s,NULL,NULL,&timeout);
-  if (n>0) {
+  if (net_linux_canRead(sckt)>0) {
     // we have a client waiting to connect... try to connect and see what happens
     int theClient = accept(sckt,0,0);
+#ifdef USE_EPOLL
+    if (theClient>=0) net_linux_watch(theClient);
+#endif
     return theClient;
   }
   return -1;
@@ -234,14 +365,11 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
   struct sockaddr_in fromAddr;
   int fromAddrLen = sizeof(fromAddr);
   int num = 0;
-  fd_set s;
-  FD_ZERO(&s);
-  FD_SET(sckt,&s);
-  // check for waiting clients
-  struct timeval timeout;
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 0;
-  int n = select(sckt+1,&s,NULL,NULL,&timeout);
+  int recvFlags = 0;
+#ifdef USE_EPOLL
+  recvFlags |= MSG_DONTWAIT; // epoll's idea of what's ready may be out of date
+#endif
+  int n = net_linux_canRead(sckt);
   if (n==SOCKET_ERROR) {
     // we probably disconnected
     return -1;
@@ -249,7 +377,8 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
     // receive data
     if (socketType & ST_UDP) {
       JsNetUDPPacketHeader *header = (JsNetUDPPacketHeader*)buf;
-      num = (int)recvfrom(sckt,buf+sizeof(JsNetUDPPacketHeader),len-sizeof(JsNetUDPPacketHeader),0,(struct sockaddr *)&fromAddr,(socklen_t*)&fromAddrLen);
+      num = (int)recvfrom(sckt,buf+sizeof(JsNetUDPPacketHeader),len-sizeof(JsNetUDPPacketHeader),recvFlags,(struct sockaddr *)&fromAddr,(socklen_t*)&fromAddrLen);
+      if (num<0 && net_linux_wouldBlock()) return 0;
       *(in_addr_t*)&header->host = fromAddr.sin_addr.s_addr;
       header->port = ntohs(fromAddr.sin_port);
       header->length = (uint16_t)num;
@@ -258,7 +387,8 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
       if (num==0) return -1; // select says data, but recv says 0 means connection is closed
       num += sizeof(JsNetUDPPacketHeader);
     } else {
-      num = (int)recvfrom(sckt,buf,len,0,(struct sockaddr *)&fromAddr,(socklen_t*)&fromAddrLen);
+      num = (int)recvfrom(sckt,buf,len,recvFlags,(struct sockaddr *)&fromAddr,(socklen_t*)&fromAddrLen);
+      if (num<0 && net_linux_wouldBlock()) return 0;
       if (num==0) return -1; // select says data, but recv says 0 means connection is closed
     }
   }
@@ -266,23 +396,25 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
   return num;
 }
 
+#ifndef RELEASE
+/// For testing: how many more TCP sends to fail as if the send buffer was full
+int net_linux_sendsToBlock = 0;
+#endif
+
 /// Send data if possible. returns nBytes on success, 0 on no data, or -1 on failure
 int net_linux_send(JsNetwork *net, SocketType socketType, int sckt, const void *buf, size_t len) {
   NOT_USED(net);
-  fd_set writefds;
-  FD_ZERO(&writefds);
-  FD_SET(sckt, &writefds);
-  struct timeval time;
-  time.tv_sec = 0;
-  time.tv_usec = 0;
-  int n = select(sckt+1, 0, &writefds, 0, &time);
+  int n = net_linux_canWrite(sckt);
   if (n==SOCKET_ERROR ) {
      // we probably disconnected so just get rid of this
     return -1;
-  } else if (FD_ISSET(sckt, &writefds)) {
+  } else if (n>0) {
     int flags = 0;
 #if !defined(SO_NOSIGPIPE) && defined(MSG_NOSIGNAL)
     flags |= MSG_NOSIGNAL;
+#endif
+#ifdef USE_EPOLL
+    flags |= MSG_DONTWAIT; // send what we can, and let epoll tell us when there's space for more
 #endif
     if (socketType & ST_UDP) {
       JsNetUDPPacketHeader *header = (JsNetUDPPacketHeader*)buf;
@@ -293,9 +425,17 @@ int net_linux_send(JsNetwork *net, SocketType socketType, int sckt, const void *
 
       DBG("Send %d %x:%d", len - sizeof(JsNetUDPPacketHeader), header->host, header->port);
       n = (int)sendto(sckt, buf + sizeof(JsNetUDPPacketHeader), header->length, flags, (struct sockaddr *)&sin, sizeof(sockaddr_in));
+      if (n<0 && net_linux_wouldBlock()) return net_linux_waitForWrite(sckt);
       n += sizeof(JsNetUDPPacketHeader);
     } else {
+#ifndef RELEASE
+      if (net_linux_sendsToBlock>0) {
+        net_linux_sendsToBlock--;
+        return net_linux_waitForWrite(sckt);
+      }
+#endif
       n = (int)send(sckt, buf, len, flags);
+      if (n<0 && net_linux_wouldBlock()) return net_linux_waitForWrite(sckt);
     }
     return n;
   } else
@@ -312,4 +452,7 @@ void netSetCallbacks_linux(JsNetwork *net) {
   net->recv = net_linux_recv;
   net->send = net_linux_send;
   net->chunkSize = 536;
+#ifdef USE_EPOLL
+  net->wakesFromSleep = true;
+#endif
 }
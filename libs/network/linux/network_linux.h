@@ -14,3 +14,11 @@
 #include "network.h"
 
 void netSetCallbacks_linux(JsNetwork *net);
+
+/// Wait for up to the given time for one of our sockets to become ready. Returns false if we have no way of waiting on them
+bool net_linux_sleep(unsigned int usecs);
+
+#ifndef RELEASE
+/// For testing: how many more TCP sends to fail as if the send buffer was full
+extern int net_linux_sendsToBlock;
+#endif
@@ -66,6 +66,7 @@ typedef struct JsNetwork {
   unsigned char _blank; ///< this is needed as jsvGetString for 'data' wants to add a trailing zero  
 
   int chunkSize; ///< Amount of memory to allocate for chunks of data when using send/recv
+  bool wakesFromSleep; ///< Set if jshSleep returns when a socket becomes ready, so open sockets don't have to keep us busy
 
   /// Called on idle. Do any checks required for this device
   void (*idle)(struct JsNetwork *net);
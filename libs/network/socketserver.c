@@ -203,6 +203,9 @@ size_t httpStringGet(JsVar *v, char *str, size_t len) {
 
 // -----------------------------
 
+/// Set whenever a socket sends, receives or accepts something (or fails) in socketIdle
+static bool socketHadActivity;
+
 static JsVar *socketGetArray(const char *name, bool create) {
   return jsvObjectGetChild(execInfo.hiddenRoot, name, create?JSV_ARRAY:0);
 }
@@ -278,6 +281,7 @@ int socketSendData(JsNetwork *net, JsVar *connection, int sckt, JsVar **sendData
   size_t bufLen = httpStringGet(*sendData, buf, sndBufLen);
   int num = netSend(net, socketType, sckt, buf, bufLen);
   DBG("socketSendData %x:%d (%d -> %d)\n", *(uint32_t*)buf, *(unsigned short*)(buf+sizeof(uint32_t)), bufLen, num);
+  if (num != 0) socketHadActivity = true;
   if (num < 0) return num; // an error occurred
   // Now cut what we managed to send off the beginning of sendData
   if (num > 0) {
@@ -507,6 +511,7 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
 
     if (!closeConnectionNow) {
       int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+      if (num != 0) socketHadActivity = true;
       if (num<0) {
         // we probably disconnected so just get rid of this
         closeConnectionNow = true;
@@ -672,6 +677,7 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
         }
         // Now read data if possible (and we have space for it)
         int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+        if (num != 0 && (alreadyConnected || num != SOCKET_ERR_NO_CONN)) socketHadActivity = true;
         if (!alreadyConnected && num == SOCKET_ERR_NO_CONN) {
           ; // ignore... it's just telling us we're not connected yet
         } else if (num < 0) {
@@ -765,6 +771,7 @@ bool socketIdle(JsNetwork *net) {
     _socketCloseAllConnections(net);
     return false;
   }
+  socketHadActivity = false;
   bool hadSockets = false;
   JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVERS,false);
   if (arr) {
@@ -782,6 +789,7 @@ bool socketIdle(JsNetwork *net) {
           int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(server,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
           theClient = netAccept(net, sckt);
       }
+      if (theClient >= 0) socketHadActivity = true;
       if (theClient >= 0) { // We have a new connection
         if ((socketType&ST_TYPE_MASK) == ST_HTTP) {
           JsVar *req = jspNewObject(0, "httpSRq");
@@ -832,9 +840,23 @@ bool socketIdle(JsNetwork *net) {
   if (socketServerConnectionsIdle(net)) hadSockets = true;
   if (socketClientConnectionsIdle(net)) hadSockets = true;
   netCheckError(net);
+  // If a socket becoming ready wakes us up anyway, we only need to stay busy if something happened
+  if (net->wakesFromSleep) return socketHadActivity;
   return hadSockets;
 }
 
+bool socketHasOpenSockets() {
+  const char *arrayNames[] = { HTTP_ARRAY_HTTP_SERVERS, HTTP_ARRAY_HTTP_SERVER_CONNECTIONS, HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS };
+  unsigned int i;
+  for (i=0;i<sizeof(arrayNames)/sizeof(arrayNames[0]);i++) {
+    JsVar *arr = socketGetArray(arrayNames[i], false);
+    bool isOpen = arr && !jsvArrayIsEmpty(arr);
+    jsvUnLock(arr);
+    if (isOpen) return true;
+  }
+  return false;
+}
+
 // -----------------------------
 
 JsVar *serverNew(SocketType socketType, JsVar *callback) {
@@ -23,6 +23,7 @@
 void socketInit();
 void socketKill(JsNetwork *net);
 bool socketIdle(JsNetwork *net);
+bool socketHasOpenSockets(); ///< Are any servers or connections open? (so they might call back later)
 
 // -----------------------------
 JsVar *serverNew(SocketType socketType, JsVar *callback);
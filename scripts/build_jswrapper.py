@@ -187,12 +187,56 @@ def getCDeclaration(jsondata, name):
     s.append(toCType(param[1]));
   return toCType(result[0])+" "+name+"("+",".join(s)+")";
 
+# The hash used for the perfect hash tables (FNV-1a) - must match jswSymbolHash
+def symbolHash(name):
+  h = 2166136261
+  for c in name:
+    h = ((h ^ ord(c)) * 16777619) & 0xFFFFFFFF
+  return h
+
+# Which slot a hash goes in, given its bucket's displacement - must match jswBinarySearch
+def symbolHashSlot(h, displacement, slotCount):
+  return ((((h ^ displacement) * 0x9E3779B1) & 0xFFFFFFFF) >> 8) % slotCount
+
+# Build a minimal perfect hash ('hash and displace') for a list of names. Names are
+# put in buckets, and each bucket (biggest first) is given a displacement that puts
+# all its names in unused slots. Returns (displacements, symbol index for each slot)
+# or None if we couldn't make one
+def buildSymbolHash(names):
+  n = len(names)
+  if n==0 or n>255: return None
+  hashes = [symbolHash(name) for name in names]
+  for bucketCount in range(max(1,n//4), n+1):
+    buckets = [[] for b in range(bucketCount)]
+    for i in range(n):
+      buckets[hashes[i] % bucketCount].append(i)
+    displacements = [0] * bucketCount
+    slots = [None] * n
+    ok = True
+    for b in sorted(range(bucketCount), key=lambda b: -len(buckets[b])):
+      if not buckets[b]: continue
+      found = False
+      for d in range(256):
+        s = [symbolHashSlot(hashes[i], d, n) for i in buckets[b]]
+        if len(set(s))==len(s) and all(slots[x]==None for x in s):
+          found = True
+          break
+      if not found:
+        ok = False
+        break
+      displacements[b] = d
+      for i,x in zip(buckets[b], s):
+        slots[x] = i
+    if ok: return (displacements, slots)
+  return None
+
 def codeOutSymbolTable(builtin):
   codeName = builtin["name"]
   # sort by name
   builtin["functions"] = sorted(builtin["functions"], key=lambda n: n["name"]);
   # output tables
   listSymbols = []
+  listNames = []
   listChars = ""
   strLen = 0
   for sym in builtin["functions"]:
@@ -202,6 +246,7 @@ def codeOutSymbolTable(builtin):
       continue # don't include libraries on global namespace
     if "generate" in sym:
       listSymbols.append("{"+", ".join([str(strLen), getArgumentSpecifier(sym), "(void (*)(void))"+sym["generate"]])+"}")
+      listNames.append(symName)
       listChars = listChars + symName + "\\0";
       strLen = strLen + len(symName) + 1
     else:
@@ -209,6 +254,18 @@ def codeOutSymbolTable(builtin):
   builtin["symbolTableChars"] = "\""+listChars+"\"";
   builtin["symbolTableCount"] = str(len(listSymbols));
   codeOut("static const JswSymPtr jswSymbols_"+codeName+"[] FLASH_SECT = {\n  "+",\n  ".join(listSymbols)+"\n};");
+  # output perfect hash tables
+  symbolHashTable = buildSymbolHash(listNames)
+  if symbolHashTable:
+    displacements, slots = symbolHashTable
+    codeOut("#ifdef JSWRAPPER_SYMBOL_HASH")
+    codeOut("static const unsigned char jswSymbols_"+codeName+"_hashDisp[] FLASH_SECT = {"+",".join([str(d) for d in displacements])+"};");
+    codeOut("static const unsigned char jswSymbols_"+codeName+"_hashSym[] FLASH_SECT = {"+",".join([str(i) for i in slots])+"};");
+    codeOut("#endif")
+    builtin["symbolHash"] = "JSW_SYMBOL_HASH(jswSymbols_"+codeName+"_hashDisp, jswSymbols_"+codeName+"_hashSym, "+str(len(displacements))+")"
+  else:
+    if len(listNames)>0: print (codeName+" has no perfect hash table - using binary search")
+    builtin["symbolHash"] = "JSW_SYMBOL_HASH(0, 0, 0)"
 
 def codeOutBuiltins(indent, builtin):
   codeOut(indent+"jswBinarySearch(&jswSymbolTables["+builtin["indexName"]+"], parent, name);");
@@ -382,22 +439,60 @@ codeOut('// --------------------------------------------------------------------
 codeOut('');
 
 codeOut("""
+// Create the builtin (or get its value) once we've found it in a symbol list
+static JsVar *jswCreateFromSymbol(const JswSymPtr *sym, JsVar *parent) {
+  unsigned short functionSpec = READ_FLASH_UINT16(&sym->functionSpec);
+  if ((functionSpec & JSWAT_EXECUTE_IMMEDIATELY_MASK) == JSWAT_EXECUTE_IMMEDIATELY)
+    return jsnCallFunction(sym->functionPtr, functionSpec, parent, 0, 0);
+  return jsvNewNativeFunctionShared(sym->functionPtr, functionSpec);
+}
+
+#ifndef RELEASE
+/// How many names jswBinarySearch has compared against symbols (see E.getSymbolCompares)
+unsigned int jswSymbolCompares = 0;
+#define JSW_COUNT_SYMBOL_COMPARE() jswSymbolCompares++
+#else
+#define JSW_COUNT_SYMBOL_COMPARE()
+#endif
+
+#ifdef JSWRAPPER_SYMBOL_HASH
+// The hash used for the perfect hash tables (FNV-1a) - must match symbolHash in build_jswrapper.py
+static uint32_t jswSymbolHash(const char *name) {
+  uint32_t hash = 2166136261u;
+  while (*name)
+    hash = (hash ^ (unsigned char)*(name++)) * 16777619u;
+  return hash;
+}
+#endif
+
 // Binary search coded to allow for JswSyms to be in flash on the esp8266 where they require
 // word accesses
 JsVar *jswBinarySearch(const JswSymList *symbolsPtr, JsVar *parent, const char *name) {
   uint8_t symbolCount = READ_FLASH_UINT8(&symbolsPtr->symbolCount);
+#ifdef JSWRAPPER_SYMBOL_HASH
+  uint8_t hashBuckets = READ_FLASH_UINT8(&symbolsPtr->hashBuckets);
+  if (hashBuckets) {
+    // Perfect hash - the only symbol that could match is the one in our slot
+    uint32_t hash = jswSymbolHash(name);
+    uint8_t displacement = READ_FLASH_UINT8(&symbolsPtr->hashDisplacements[hash % hashBuckets]);
+    unsigned int slot = (((hash ^ displacement) * 0x9E3779B1u) >> 8) % symbolCount;
+    const JswSymPtr *sym = &symbolsPtr->symbols[READ_FLASH_UINT8(&symbolsPtr->hashSymbols[slot])];
+    unsigned short strOffset = READ_FLASH_UINT16(&sym->strOffset);
+    JSW_COUNT_SYMBOL_COMPARE();
+    if (FLASH_STRCMP(name, &symbolsPtr->symbolChars[strOffset])) return 0;
+    return jswCreateFromSymbol(sym, parent);
+  }
+#endif
   int searchMin = 0;
   int searchMax = symbolCount - 1;
   while (searchMin <= searchMax) {
     int idx = (searchMin+searchMax) >> 1;
     const JswSymPtr *sym = &symbolsPtr->symbols[idx];
     unsigned short strOffset = READ_FLASH_UINT16(&sym->strOffset);
+    JSW_COUNT_SYMBOL_COMPARE();
     int cmp = FLASH_STRCMP(name, &symbolsPtr->symbolChars[strOffset]);
     if (cmp==0) {
-      unsigned short functionSpec = READ_FLASH_UINT16(&sym->functionSpec);
-      if ((functionSpec & JSWAT_EXECUTE_IMMEDIATELY_MASK) == JSWAT_EXECUTE_IMMEDIATELY)
-        return jsnCallFunction(sym->functionPtr, functionSpec, parent, 0, 0);
-      return jsvNewNativeFunction(sym->functionPtr, functionSpec);
+      return jswCreateFromSymbol(sym, parent);
     } else {
       if (cmp<0) {
         // searchMin is the same
@@ -454,6 +549,8 @@ for jsondata in jsondatas:
 # .irom.literal section used elsewhere has different readability attributes, sigh
 codeOut("#ifdef ESP8266\n#define FLASH_SECT __attribute__((section(\".irom.literal2\"))) __attribute__((aligned(4)))");
 codeOut("#else\n#define FLASH_SECT\n#endif\n");
+codeOut("#ifdef JSWRAPPER_SYMBOL_HASH\n#define JSW_SYMBOL_HASH(disp, syms, buckets) , disp, syms, buckets");
+codeOut("#else\n#define JSW_SYMBOL_HASH(disp, syms, buckets)\n#endif\n");
 
 print("Outputting Symbol Tables")
 idx = 0
@@ -475,7 +572,7 @@ codeOut('');
 codeOut('const JswSymList jswSymbolTables[] FLASH_SECT = {');
 for b in builtins:
   builtin = builtins[b]
-  codeOut("  {"+", ".join(["jswSymbols_"+builtin["name"], "jswSymbols_"+builtin["name"]+"_str", builtin["symbolTableCount"]])+"},");
+  codeOut("  {"+", ".join(["jswSymbols_"+builtin["name"], "jswSymbols_"+builtin["name"]+"_str", builtin["symbolTableCount"]])+" "+builtin["symbolHash"]+"},");
 codeOut('};');
 
 codeOut('');
@@ -533,12 +630,18 @@ if "parent" in builtins:
   codeOut('    if (v) return v;');
 codeOut('  } else { /* if (!parent) */')
 codeOut('    // ------------------------------------------ FUNCTIONS')
+# Pin names take priority, so if a builtin could be mistaken for one we must check pins first.
+# Otherwise we only check for pins once we know it's not a builtin
+pinLikeBuiltins = "!parent" in builtins and any(re.match("^[A-IV][0-9]+$", f["name"]) for f in builtins["!parent"]["functions"])
+if "!parent" in builtins and not pinLikeBuiltins:
+  codeOutBuiltins("    v = ", builtins["!parent"])
+  codeOut('    if (v) return v;');
 codeOut('    // Handle pin names - eg LED1 or D5 (this is hardcoded in build_jsfunctions.py)')
 codeOut('    Pin pin = jshGetPinFromString(name);')
 codeOut('    if (pin != PIN_UNDEFINED) {')
 codeOut('      return jsvNewFromPin(pin);')
 codeOut('    }')
-if "!parent" in builtins:
+if "!parent" in builtins and pinLikeBuiltins:
   codeOutBuiltins("    return ", builtins["!parent"])
 codeOut('  }');
 
@@ -707,12 +810,11 @@ for lib in jsmodules:
 codeOut('  return "'+','.join(librarynames)+'";')
 codeOut('}')
 
-codeOut('#ifdef EMSCRIPTEN')
-codeOut('// on Emscripten we cant easily hack around function calls with floats/etc so we must just do this brute-force by handling every call pattern we use')
-codeOut('JsVar *jswCallFunctionHack(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount) {')
-codeOut('  switch(argumentSpecifier) {')
-#for argSpec in argSpecs:
-#  codeOut('  case '+argSpec+":")
+# Output straight-line code to call a function for each argument specifier we use. On Emscripten
+# this is the only way we can call functions with floats/etc, and elsewhere it's faster than jsnCallFunction
+codeOut('#if defined(EMSCRIPTEN) || !defined(SAVE_ON_FLASH)')
+codeOut('bool jswCallFunctionBySpecifier(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount, JsVar **result) {')
+codeOut('  switch((int)argumentSpecifier) {')
 argSpecs = []
 for jsondata in jsondatas:
   if "generate" in jsondata:
@@ -741,22 +843,18 @@ for jsondata in jsondatas:
         n = n+1
 
       codeOut("    case "+argSpec+": {");
-      codeOut("      JsVar *result = 0;");
       if cmdstart:  codeOut(cmdstart); 
       cmd = "(("+toCType(result[0])+"(*)("+",".join(pTypes)+"))function)("+",".join(pValues)+")";
-      if result[0]: codeOut("      result = "+toCBox(result[0])+"("+cmd+");");
-      else: codeOut("      "+cmd+";");
+      if result[0]: codeOut("      *result = "+toCBox(result[0])+"("+cmd+");");
+      else:
+        codeOut("      "+cmd+";");
+        codeOut("      *result = 0;");
       if cmdend:  codeOut(cmdend); 
-      codeOut("      return result;");
+      codeOut("      return true;");
       codeOut("    }");
 
-
-      
-
-#((uint32_t (*)(size_t,size_t,size_t,size_t))function)(argData[0],argData[1],argData[2],argData[3]);
-codeOut('  default: jsExceptionHere(JSET_ERROR,"Unknown argspec %d",argumentSpecifier);')
+codeOut('  default: return false; // not a specifier used by any builtin (eg. from E.nativeCall)')
 codeOut('  }')
-codeOut('  return 0;')
 codeOut('}')
 codeOut('#endif')
 
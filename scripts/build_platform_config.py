@@ -259,9 +259,9 @@ codeOut("""
 #define DEFAULT_SLEEP_PIN_INDICATOR (Pin)-1 // no indicator
 
 // When to send the message that the IO buffer is getting full
-#define IOBUFFER_XOFF ((TXBUFFERMASK)*6/8)
+#define IOBUFFER_XOFF ((IOBUFFERMASK)*6/8)
 // When to send the message that we can start receiving again
-#define IOBUFFER_XON ((TXBUFFERMASK)*3/8)
+#define IOBUFFER_XON ((IOBUFFERMASK)*3/8)
 
 """);
 
@@ -326,12 +326,14 @@ if "default_console_baudrate" in board.info:
 
 codeOut("");
 if LINUX:
-  bufferSizeIO = 256
-  bufferSizeTX = 256
+  bufferSizeIO = 1024
+  bufferSizeTX = 1024
+  bufferSizeIOChars = 4096
   bufferSizeTimer = 16
 elif EMSCRIPTEN:
   bufferSizeIO = 256
-  bufferSizeTX = 256
+  bufferSizeTX = 512
+  bufferSizeIOChars = 0
   bufferSizeTimer = 16
 else:
   # IO buffer - for received chars, setWatch, etc
@@ -340,16 +342,29 @@ else:
   if board.chip["ram"]>=96: bufferSizeIO = 256
   # NRF52 needs this as Bluetooth traffic is funnelled through the buffer
   if board.chip["family"]=="NRF52": bufferSizeIO = 256
-  # TX buffer - for print/write/etc
-  bufferSizeTX = 32 
-  if board.chip["ram"]>=20: bufferSizeTX = 128
+  # TX buffer - bytes for print/write/etc
+  bufferSizeTX = 64
+  if board.chip["ram"]>=20: bufferSizeTX = 256
+  # Bulk RX buffer - blocks of data from USB/DMA/Bluetooth are stored here with one event each
+  bufferSizeIOChars = 0
+  if board.chip["ram"]>=32: bufferSizeIOChars = 512
+  if board.chip["ram"]>=96: bufferSizeIOChars = 1024
   bufferSizeTimer = 4 if board.chip["ram"]<20 else 16
 
 if 'util_timer_tasks' in board.info:
   bufferSizeTimer = board.info['util_timer_tasks']
-
-codeOut("#define IOBUFFERMASK "+str(bufferSizeIO-1)+" // (max 255) amount of items in event buffer - events take 5 bytes each")
-codeOut("#define TXBUFFERMASK "+str(bufferSizeTX-1)+" // (max 255) amount of items in the transmit buffer - 2 bytes each")
+if 'io_char_buffer' in board.info:
+  bufferSizeIOChars = board.info['io_char_buffer']
+if 'io_buffer' in board.info:
+  bufferSizeIO = board.info['io_buffer']
+if 'tx_buffer' in board.info:
+  bufferSizeTX = board.info['tx_buffer']
+if bufferSizeIO & (bufferSizeIO-1) or bufferSizeTX & (bufferSizeTX-1):
+  die("IO and TX buffer sizes must be powers of 2")
+
+codeOut("#define IOBUFFERMASK "+str(bufferSizeIO-1)+" // amount of items in event buffer - events take 5 bytes each")
+codeOut("#define TXBUFFERMASK "+str(bufferSizeTX-1)+" // bytes in the transmit buffer - data is stored in runs with a 3 byte header")
+codeOut("#define IOCHARBUFFERSIZE "+str(bufferSizeIOChars)+" // (max 65535) bytes for blocks of received characters, or 0 to store them in events")
 codeOut("#define UTILTIMERTASK_TASKS ("+str(bufferSizeTimer)+") // Must be power of 2 - and max 256")
 
 codeOut("");
@@ -27,6 +27,23 @@
 #include "trigger.h"
 #endif
 
+// ----------------------------------------------------------------------------
+//                                                                      ATOMICS
+/* The IO and transmit queues are lock-free, using compare-and-swap on their
+ * indices. Where the CPU can't do that (eg. Cortex M0) there's only one core,
+ * so we disable IRQs around the code that needs to be atomic instead. */
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_1) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+#define jshAtomicStart()
+#define jshAtomicEnd()
+#define jshAtomicCompareAndSwap(PTR, OLDVAL, NEWVAL) __sync_bool_compare_and_swap(PTR, OLDVAL, NEWVAL)
+#define jshMemoryBarrier() __sync_synchronize()
+#else
+#define jshAtomicStart() jshInterruptOff()
+#define jshAtomicEnd() jshInterruptOn()
+#define jshAtomicCompareAndSwap(PTR, OLDVAL, NEWVAL) ((*(PTR)==(OLDVAL)) ? ((*(PTR)=(NEWVAL)),true) : false)
+#define jshMemoryBarrier()
+#endif
+
 // ----------------------------------------------------------------------------
 //                                                              WATCH CALLBACKS
 #define JSEVENTCALLBACK_PIN_MASK 0xFFFFFF00
@@ -35,23 +52,31 @@ JshEventCallbackCallback jshEventCallbacks[EV_EXTI_MAX+1-EV_EXTI0];
 // ----------------------------------------------------------------------------
 //                                                         DATA TRANSMIT BUFFER
 
-/**
- * A single character to be transmitted.
- */
-typedef struct {
-  IOEventFlags flags; //!< Where this data should be transmitted
-  unsigned char data; //!< data to transmit
-} PACKED_FLAGS TxBufferItem;
+/* Data to transmit is stored as runs of bytes for the same device:
+ *
+ *   [device][length][taken][data ...]
+ *
+ * jshTransmit adds to the last run if it's for the same device, or starts a
+ * new one. jshGetCharToTransmit takes bytes from the first run for a device
+ * with data left, and frees runs from the tail once all their data is taken.
+ * A run's length is only changed with compare-and-swap, so the producer can
+ * tell if the run was freed just as it was being added to. */
+#define TXRUN_LENGTH 1 ///< offset of the length
+#define TXRUN_TAKEN 2  ///< offset of the number of bytes already taken for transmission
+#define TXRUN_HEADER 3 ///< size of the header before the data
+#define TXRUN_MAXLENGTH 254
+#define TXRUN_FREED 255 ///< length of a run that has been freed
+#define TXBUFFERIDX(X) ((X)&TXBUFFERMASK)
 
 /**
- * An array of items to transmit.
+ * Runs of bytes to transmit.
  */
-volatile TxBufferItem txBuffer[TXBUFFERMASK+1];
+volatile unsigned char txBuffer[TXBUFFERMASK+1];
 
 /**
- * The head and tail of the list.
+ * The head and tail of the list, and the start of the last run (only valid if txHead!=txTail).
  */
-volatile unsigned char txHead=0, txTail=0;
+volatile unsigned int txHead=0, txTail=0, txLastRun=0;
 
 typedef enum {
   SDS_NONE,
@@ -73,8 +98,42 @@ Pin jshSerialDeviceCTSPins[JSHSERIALDEVICESTATUSES];
 
 // ----------------------------------------------------------------------------
 //                                                              IO EVENT BUFFER
+/* Multiple IRQs/threads can push events. They reserve a slot by advancing
+ * ioHead with compare-and-swap, and write the event's flags last. Slots that
+ * are empty or not written yet have flags of EV_NONE.
+ *
+ * Only the main loop takes events. It swaps a slot's flags for EV_NONE (or
+ * IOEVENT_TAKEN if the event is taken from the middle of the queue) before
+ * reading it, so a producer appending characters to that event can tell. */
 volatile IOEvent ioBuffer[IOBUFFERMASK+1];
-volatile unsigned char ioHead=0, ioTail=0;
+volatile unsigned int ioHead=0, ioTail=0;
+#define IOBUFFERIDX(X) ((X)&IOBUFFERMASK)
+/// Flags of an event jshPopIOEventOfType took from the middle of the queue. Its type is EV_NONE, so nothing matches it
+#define IOEVENT_TAKEN ((IOEventFlags)EV_CHARS_MASK)
+
+#if IOCHARBUFFERSIZE>0
+#if IOCHARBUFFERSIZE>65535
+#error IOCHARBUFFERSIZE must fit in IOEventData.bulk
+#endif
+/* Blocks of received characters (see jshPushIOCharEvents). Each block is
+ * contiguous and starts with the device it came from, and an EV_BULK_CHARS
+ * event in ioBuffer points to it. Blocks are freed on the pop after the one
+ * that returned their event, so consumers can read them straight from here.
+ *
+ * Only the producer writes ioCharHead, and only the consumer writes
+ * ioCharTail. One producer at a time can add blocks - the others push normal
+ * character events instead - so blocks are queued in the order they are in
+ * the buffer. */
+volatile char ioCharBuffer[IOCHARBUFFERSIZE];
+/// Where the next block goes, and the start of the oldest block still in use
+volatile unsigned int ioCharHead=0, ioCharTail=0;
+/// Nonzero while something is adding a block
+volatile unsigned char ioCharProducing = 0;
+/// Set when the last event popped was EV_BULK_CHARS, so its block can be freed
+bool ioCharBlockPopped = false;
+/// Largest block we'll add in one go, so a burst can't fill the whole buffer
+#define IOCHARBUFFER_MAXBLOCK (IOCHARBUFFERSIZE/4)
+#endif
 
 // ----------------------------------------------------------------------------
 
@@ -169,6 +228,72 @@ void jshResetDevices() {
 
 // ----------------------------------------------------------------------------
 
+/// Is there enough space in txBuffer to start a new run?
+static bool jshTransmitHasSpace() {
+  unsigned int used = TXBUFFERIDX(txHead - txTail);
+  return used + TXRUN_HEADER + 1 <= TXBUFFERMASK;
+}
+
+/// Add a byte to txBuffer - jshTransmitHasSpace must be true. Only ever called from one thread at a time
+static void jshTransmitAdd(IOEventFlags device, unsigned char data) {
+  unsigned int head = txHead;
+  if (head != txTail) { // try and add to the last run
+    unsigned int run = txLastRun;
+    volatile unsigned char *length = &txBuffer[TXBUFFERIDX(run+TXRUN_LENGTH)];
+    unsigned char len = *length;
+    if (txBuffer[run]==device && len<TXRUN_MAXLENGTH) {
+      txBuffer[head] = data;
+      jshAtomicStart();
+      // this fails if jshGetCharToTransmit freed the run in the meantime
+      bool added = jshAtomicCompareAndSwap(length, len, (unsigned char)(len+1));
+      jshAtomicEnd();
+      if (added) {
+        txHead = TXBUFFERIDX(head+1);
+        return;
+      }
+    }
+  }
+  // Start a new run
+  txBuffer[head] = (unsigned char)device;
+  txBuffer[TXBUFFERIDX(head+TXRUN_LENGTH)] = 1;
+  txBuffer[TXBUFFERIDX(head+TXRUN_TAKEN)] = 0;
+  txBuffer[TXBUFFERIDX(head+TXRUN_HEADER)] = data;
+  txLastRun = head;
+  jshMemoryBarrier();
+  txHead = TXBUFFERIDX(head+TXRUN_HEADER+1);
+}
+
+/** Move 'run' on to the next run in txBuffer, or return false if there are
+ * no more before 'head'. jshGetCharToTransmit can be called from more than one
+ * place (eg. jshTransmitClearDevice), so 'run' may be freed while we look. */
+static bool jshTransmitNextRun(unsigned int *run, unsigned int head) {
+  if (*run == txLastRun) return false;
+  // only the last run is added to, so this one's length can't change now
+  jshMemoryBarrier();
+  unsigned char len = txBuffer[TXBUFFERIDX(*run+TXRUN_LENGTH)];
+  if (len==TXRUN_FREED || (unsigned int)(TXRUN_HEADER+len) >= TXBUFFERIDX(head - *run))
+    return false;
+  *run = TXBUFFERIDX(*run+TXRUN_HEADER+len);
+  return true;
+}
+
+/// Free any runs at the tail of txBuffer that have had all their data taken
+static void jshTransmitFreeRuns() {
+  while (txTail != txHead) {
+    unsigned int run = txTail;
+    volatile unsigned char *length = &txBuffer[TXBUFFERIDX(run+TXRUN_LENGTH)];
+    unsigned char len = *length;
+    if (txBuffer[TXBUFFERIDX(run+TXRUN_TAKEN)] < len) return; // still has data
+    unsigned int end = TXBUFFERIDX(run+TXRUN_HEADER+len);
+    /* If this is the last run and data doesn't end at txHead, jshTransmitAdd
+     * is adding to it right now - leave it until next time. */
+    if (run==txLastRun && end!=txHead) return;
+    // This fails if jshTransmitAdd just added to the run
+    if (!jshAtomicCompareAndSwap(length, len, TXRUN_FREED)) return;
+    txTail = end;
+  }
+}
+
 /**
  * Queue a character for transmission.
  */
@@ -218,14 +343,11 @@ void jshTransmit(
   // If the device is EV_NONE then there is nowhere to send the data.
   if (device==EV_NONE) return;
 
-  // The txHead global points to the current item in the txBuffer.  Since we are adding a new
-  // character, we increment the head pointer.   If it has caught up with the tail, then that means
-  // we have filled the array backing the list.  What we do next is to wait for space to free up.
-  unsigned char txHeadNext = (unsigned char)((txHead+1)&TXBUFFERMASK);
-  if (txHeadNext==txTail) {
+  // If we've filled the buffer, wait for space to free up.
+  if (!jshTransmitHasSpace()) {
     jsiSetBusy(BUSY_TRANSMIT, true);
     bool wasConsoleLimbo = device==EV_LIMBO && jsiGetConsoleDevice()==EV_LIMBO;
-    while (txHeadNext==txTail) {
+    while (!jshTransmitHasSpace()) {
       // wait for send to finish as buffer is about to overflow
       if (jshIsInInterrupt()) {
         // if we're printing from an IRQ, don't wait - it's unlikely TX will ever finish
@@ -249,10 +371,7 @@ void jshTransmit(
     }
     jsiSetBusy(BUSY_TRANSMIT, false);
   }
-  // Save the device and data for the new character to be transmitted.
-  txBuffer[txHead].flags = device;
-  txBuffer[txHead].data = data;
-  txHead = txHeadNext;
+  jshTransmitAdd(device, data);
 
   jshUSARTKick(device); // set up interrupts if required
 }
@@ -271,8 +390,13 @@ void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...) {
 
 // Return the device at the top of the transmit queue (or EV_NONE)
 IOEventFlags jshGetDeviceToTransmit() {
-  if (!jshHasTransmitData()) return EV_NONE;
-  return IOEVENTFLAGS_GETTYPE(txBuffer[txTail].flags);
+  unsigned int run = txTail, head = txHead;
+  if (run == head) return EV_NONE;
+  do {
+    if (txBuffer[TXBUFFERIDX(run+TXRUN_TAKEN)] < txBuffer[TXBUFFERIDX(run+TXRUN_LENGTH)])
+      return (IOEventFlags)txBuffer[run];
+  } while (jshTransmitNextRun(&run, head));
+  return EV_NONE;
 }
 
 /**
@@ -294,25 +418,30 @@ int jshGetCharToTransmit(
     }
   }
 
-  unsigned char tempTail = txTail;
-  while (txHead != tempTail) {
-    if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == device) {
-      unsigned char data = txBuffer[tempTail].data;
-      if (tempTail != txTail) { // so we weren't right at the back of the queue
-        // we need to work back from tempTail (until we hit tail), shifting everything forwards
-        unsigned char this = tempTail;
-        unsigned char last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
-        while (this!=txTail) { // if this==txTail, then last is before it, so stop here
-          txBuffer[this] = txBuffer[last];
-          this = last;
-          last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
-        }
+  jshTransmitFreeRuns();
+  // find the first run for this device that still has data in it
+  unsigned int run = txTail, head = txHead;
+  if (run == head) return -1; // no data :(
+  do {
+    volatile unsigned char *taken = &txBuffer[TXBUFFERIDX(run+TXRUN_TAKEN)];
+    volatile unsigned char *length = &txBuffer[TXBUFFERIDX(run+TXRUN_LENGTH)];
+    /* More than one thing can take data at once (eg. jshTransmitClearDevice
+     * while the IRQ is sending), so each byte is claimed with compare-and-swap.
+     * Runs are only freed once all their data is taken, so that fails too if
+     * the run is freed. */
+    unsigned char t = *taken;
+    while (txBuffer[run]==device && t<*length && *length!=TXRUN_FREED) {
+      unsigned char data = txBuffer[TXBUFFERIDX(run+TXRUN_HEADER+t)];
+      jshAtomicStart();
+      bool claimed = jshAtomicCompareAndSwap(taken, t, (unsigned char)(t+1));
+      jshAtomicEnd();
+      if (claimed) {
+        jshTransmitFreeRuns();
+        return data;
       }
-      txTail = (unsigned char)((txTail+1)&TXBUFFERMASK); // advance the tail
-      return data; // return data
+      t = *taken;
     }
-    tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
-  }
+  } while (jshTransmitNextRun(&run, head));
   return -1; // no data :(
 }
 
@@ -343,14 +472,14 @@ void jshTransmitMove(IOEventFlags from, IOEventFlags to) {
       c = jshGetCharToTransmit(from);
     }
   } else {
-    // Otherwise just rename the contents of the buffer
+    // Otherwise just rename the runs in the buffer
     jshInterruptOff();
-    unsigned char tempTail = txTail;
-    while (tempTail != txHead) {
-      if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == from) {
-        txBuffer[tempTail].flags = (txBuffer[tempTail].flags&~EV_TYPE_MASK) | to;
-      }
-      tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+    unsigned int run = txTail, head = txHead;
+    if (run != head) {
+      do {
+        if (txBuffer[run] == from)
+          txBuffer[run] = (unsigned char)to;
+      } while (jshTransmitNextRun(&run, head));
     }
     jshInterruptOn();
   }
@@ -372,41 +501,48 @@ void CALLED_FROM_INTERRUPT jshIOEventOverflowed() {
   jsErrorFlags |= JSERR_RX_FIFO_FULL;
 }
 
+/// Add an event to ioBuffer. Returns false if the queue is full
+static bool jshPushEventInternal(IOEvent *evt) {
+  unsigned int head, nextHead;
+  // reserve a slot
+  do {
+    head = ioHead;
+    nextHead = IOBUFFERIDX(head+1);
+    if (ioTail == nextHead) return false;
+  } while (!jshAtomicCompareAndSwap(&ioHead, head, nextHead));
+  // fill it in - the slot is only valid once flags is set
+  ioBuffer[head].data = evt->data;
+  jshMemoryBarrier();
+  ioBuffer[head].flags = evt->flags;
+  return true;
+}
+
 /// Push an IO event into the ioBuffer (designed to be called from IRQ)
 void CALLED_FROM_INTERRUPT jshPushEvent(IOEvent *evt) {
-  /* Make new buffer
-   *
-   * We're disabling IRQs for this bit because it's actually quite likely for
-   * USB and USART data to be coming in at the same time, and it can trip
-   * things up if one IRQ interrupts another. */
-  jshInterruptOff();
-  unsigned char nextHead = (unsigned char)((ioHead+1) & IOBUFFERMASK);
-  if (ioTail == nextHead) {
-    jshInterruptOn();
-    jshIOEventOverflowed();
-    return; // queue full - dump this event!
-  }
-  ioBuffer[ioHead] = *evt;
-  ioHead = nextHead;
-  jshInterruptOn();
+  /* It's quite likely for USB and USART data to be coming in at the same
+   * time, so this has to cope with one IRQ interrupting another. */
+  jshAtomicStart();
+  bool pushed = jshPushEventInternal(evt);
+  jshAtomicEnd();
+  if (!pushed) jshIOEventOverflowed(); // queue full - dump this event!
 }
 
-/// Attempt to push characters onto an existing event
+/** Attempt to push characters onto an existing event. Only one IRQ/thread
+ * pushes characters for any given device, but the event could be popped
+ * while we do this - in which case the compare-and-swap on flags fails. */
 static bool jshPushIOCharEventAppend(IOEventFlags channel, char charData) {
-  unsigned char lastHead = (unsigned char)((ioHead+IOBUFFERMASK) & IOBUFFERMASK); // one behind head
-  if (ioHead!=ioTail && lastHead!=ioTail) {
-    // we can do this because we only read in main loop, and we're in an interrupt here
-    if (IOEVENTFLAGS_GETTYPE(ioBuffer[lastHead].flags) == channel) {
-      unsigned char c = (unsigned char)IOEVENTFLAGS_GETCHARS(ioBuffer[lastHead].flags);
-      if (c < IOEVENT_MAXCHARS) {
-        // last event was for this event type, and it has chars left
-        ioBuffer[lastHead].data.chars[c] = charData;
-        IOEVENTFLAGS_SETCHARS(ioBuffer[lastHead].flags, c+1);
-        return true; // char added, job done
-      }
-    }
-  }
-  return false;
+  unsigned int head = ioHead;
+  if (head == ioTail) return false;
+  volatile IOEvent *last = &ioBuffer[IOBUFFERIDX(head+IOBUFFERMASK)]; // one behind head
+  IOEventFlags flags = last->flags; // EV_NONE if popped or not written yet
+  if (IOEVENTFLAGS_GETTYPE(flags) != channel) return false;
+  unsigned char c = (unsigned char)IOEVENTFLAGS_GETCHARS(flags);
+  if (c >= IOEVENT_MAXCHARS) return false;
+  // last event was for this event type, and it has chars left
+  last->data.chars[c] = charData;
+  IOEventFlags newFlags = flags;
+  IOEVENTFLAGS_SETCHARS(newFlags, c+1);
+  return jshAtomicCompareAndSwap((volatile unsigned char *)&last->flags, (unsigned char)flags, (unsigned char)newFlags);
 }
 
 /// Try and handle events in the IRQ itself. true if handled and shouldn't go in queue
@@ -422,7 +558,7 @@ static bool jshPushIOCharEventHandler(IOEventFlags channel, char charData) {
 
 // Set flow control (as we're going to use more data)
 static void jshPushIOCharEventFlowControl(IOEventFlags channel) {
-  if (DEVICE_HAS_DEVICE_STATE(channel) && jshGetEventsUsed() > IOBUFFER_XOFF)
+  if (DEVICE_HAS_DEVICE_STATE(channel) && jshGetIOBufferUsage() > IOBUFFER_XOFF)
     jshSetFlowControlXON(channel, false);
 }
 
@@ -445,12 +581,122 @@ void jshPushIOCharEvent(
   jshPushIOCharEventFlowControl(channel);
 }
 
+#if IOCHARBUFFERSIZE>0
+/** Find space for 'size' contiguous bytes in ioCharBuffer, or return -1. The
+ * consumer only ever frees space, so an old value of the tail is safe to use */
+static int jshIOCharBufferAlloc(unsigned int size) {
+  unsigned int head = ioCharHead, tail = ioCharTail;
+  // head==tail means empty, so we must never fill the buffer right up to the tail
+  if (head >= tail) {
+    if (head+size < IOCHARBUFFERSIZE || (head+size==IOCHARBUFFERSIZE && tail>0))
+      return (int)head;
+    if (size < tail) return 0; // wrap around and leave the end unused
+  } else if (head+size < tail)
+    return (int)head;
+  return -1;
+}
+
+/** Push a block of characters as one EV_BULK_CHARS event. Returns false if
+ * there wasn't space, or something else is adding a block right now */
+static bool jshPushIOCharBlock(IOEventFlags channel, char *data, unsigned int count) {
+  jshAtomicStart();
+  bool locked = jshAtomicCompareAndSwap(&ioCharProducing, 0, 1);
+  jshAtomicEnd();
+  if (!locked) return false;
+  int alloc = jshIOCharBufferAlloc(count+1);
+  if (alloc<0 || IOBUFFERIDX(ioHead+1)==ioTail) {
+    ioCharProducing = 0;
+    return false;
+  }
+  unsigned int start = (unsigned int)alloc;
+  ioCharBuffer[start] = (char)channel;
+  unsigned int i, length = 0;
+  for (i=0;i<count;i++)
+    if (!jshPushIOCharEventHandler(channel, data[i]))
+      ioCharBuffer[start+1+length++] = data[i];
+  if (length) {
+    IOEvent evt;
+    evt.flags = EV_BULK_CHARS;
+    evt.data.bulk.start = (unsigned short)start;
+    evt.data.bulk.length = (unsigned short)length;
+    jshMemoryBarrier(); // data must be written before the event is
+    if (jshPushEventInternal(&evt)) {
+      /* Only move the head once the event is queued - jshIOCharBufferRelease
+       * reads the head before looking for blocks that are still in use */
+      unsigned int end = start+1+length;
+      jshMemoryBarrier();
+      ioCharHead = (end==IOCHARBUFFERSIZE) ? 0 : end;
+    } else // another IRQ/thread filled the queue - dump the data, as the characters have been handled already
+      jshIOEventOverflowed();
+  }
+  jshMemoryBarrier();
+  ioCharProducing = 0;
+  return true;
+}
+
+/// Free the block used by the last popped event (if any). Called before popping another event
+static void jshIOCharBufferRelease() {
+  if (!ioCharBlockPopped) return;
+  ioCharBlockPopped = false;
+  /* Everything from the oldest block that still has an event in the queue is
+   * in use. Read the head first: a block's event is queued before the head
+   * moves past it, so if we miss the event, the head is still at its start */
+  unsigned int tail = ioCharHead;
+  jshMemoryBarrier();
+  unsigned int i = ioTail;
+  while (i!=ioHead) {
+    if (IOEVENTFLAGS_GETTYPE(ioBuffer[i].flags)==EV_BULK_CHARS) {
+      tail = ioBuffer[i].data.bulk.start;
+      break;
+    }
+    i = IOBUFFERIDX(i+1);
+  }
+  ioCharTail = tail;
+}
+
+/// How many bytes of ioCharBuffer are in use
+static unsigned int jshGetIOCharBufferUsed() {
+  unsigned int head = ioCharHead, tail = ioCharTail;
+  return (head>=tail) ? head-tail : head+IOCHARBUFFERSIZE-tail;
+}
+#endif
+
 void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count) {
-  // TODO: optimise me!
+#if IOCHARBUFFERSIZE>0
+  // Push blocks of data as a single event each, so they can be handled in one go
+  while (count > IOEVENT_MAXCHARS) {
+    unsigned int len = count;
+    if (len > IOCHARBUFFER_MAXBLOCK) len = IOCHARBUFFER_MAXBLOCK;
+    if (!jshPushIOCharBlock(channel, data, len)) break; // no space - fall back to normal events
+    data += len;
+    count -= len;
+    jshPushIOCharEventFlowControl(channel);
+  }
+#endif
   unsigned int i;
   for (i=0;i<count;i++) jshPushIOCharEvent(channel, data[i]);
 }
 
+IOEventFlags jshGetEventDevice(IOEvent *event) {
+  IOEventFlags type = IOEVENTFLAGS_GETTYPE(event->flags);
+#if IOCHARBUFFERSIZE>0
+  if (type==EV_BULK_CHARS)
+    return (IOEventFlags)ioCharBuffer[event->data.bulk.start];
+#endif
+  return type;
+}
+
+const char *jshGetEventChars(IOEvent *event, unsigned int *count) {
+#if IOCHARBUFFERSIZE>0
+  if (IOEVENTFLAGS_GETTYPE(event->flags)==EV_BULK_CHARS) {
+    *count = event->data.bulk.length;
+    return (const char *)&ioCharBuffer[event->data.bulk.start+1];
+  }
+#endif
+  *count = (unsigned int)IOEVENTFLAGS_GETCHARS(event->flags);
+  return event->data.chars;
+}
+
 /* Signal an IO watch event as having happened.
 On the esp8266 we need this to be loaded into static RAM because it can run at interrupt time */
 void CALLED_FROM_INTERRUPT jshPushIOWatchEvent(
@@ -499,41 +745,67 @@ void CALLED_FROM_INTERRUPT jshPushIOEvent(
   jshPushEvent(&evt);
 }
 
+/** Take the event in slot 'i' of ioBuffer and leave 'newFlags' in its place,
+ * or return false if it hasn't been written yet */
+static bool jshTakeIOEvent(unsigned int i, IOEvent *result, IOEventFlags newFlags) {
+  jshAtomicStart();
+  IOEventFlags flags;
+  // changing the flags stops jshPushIOCharEventAppend from changing the event
+  do {
+    flags = ioBuffer[i].flags;
+  } while (flags!=EV_NONE && !jshAtomicCompareAndSwap((volatile unsigned char *)&ioBuffer[i].flags, (unsigned char)flags, (unsigned char)newFlags));
+  jshAtomicEnd();
+  if (flags==EV_NONE) return false;
+  result->flags = flags;
+  result->data = ioBuffer[i].data;
+#if IOCHARBUFFERSIZE>0
+  if (IOEVENTFLAGS_GETTYPE(flags)==EV_BULK_CHARS)
+    ioCharBlockPopped = true;
+#endif
+  return true;
+}
+
+/// Move the tail past any events that jshPopIOEventOfType has already taken
+static void jshSkipTakenIOEvents() {
+  unsigned int tail = ioTail;
+  while (tail!=ioHead && ioBuffer[tail].flags==IOEVENT_TAKEN) {
+    ioBuffer[tail].flags = EV_NONE; // ready for a producer to write
+    jshMemoryBarrier();
+    tail = IOBUFFERIDX(tail+1);
+    ioTail = tail;
+  }
+}
+
 // returns true on success
 bool jshPopIOEvent(IOEvent *result) {
-  if (ioHead==ioTail) return false;
-  *result = ioBuffer[ioTail];
-  ioTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
+#if IOCHARBUFFERSIZE>0
+  jshIOCharBufferRelease();
+#endif
+  jshSkipTakenIOEvents();
+  unsigned int tail = ioTail;
+  if (ioHead==tail) return false;
+  if (!jshTakeIOEvent(tail, result, EV_NONE)) return false;
+  jshMemoryBarrier();
+  ioTail = IOBUFFERIDX(tail+1);
   return true;
 }
 
 // returns true on success
 bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result) {
   // Special case for top - it's easier!
-  if (IOEVENTFLAGS_GETTYPE(ioBuffer[ioTail].flags) == eventType)
+  if (jshIsTopEvent(eventType))
     return jshPopIOEvent(result);
-  // Now check non-top
-  unsigned char i = ioTail;
-  while (ioHead!=i) {
-    if (IOEVENTFLAGS_GETTYPE(ioBuffer[i].flags) == eventType) {
-      /* We need IRQ off for this, because if we get data it's possible
-      that the IRQ will push data and will try and add characters to this
-      exact position in the buffer */
-      jshInterruptOff();
-      *result = ioBuffer[i];
-      // work back and shift all items in out queue
-      unsigned char n = (unsigned char)((i+IOBUFFERMASK) & IOBUFFERMASK);
-      while (n!=ioTail) {
-        ioBuffer[i] = ioBuffer[n];
-        i = n;
-        n = (unsigned char)((n+IOBUFFERMASK) & IOBUFFERMASK);
-      }
-      // finally update the tail pointer, and return
-      ioTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
-      jshInterruptOn();
-      return true;
-    }
-    i = (unsigned char)((i+1) & IOBUFFERMASK);
+#if IOCHARBUFFERSIZE>0
+  jshIOCharBufferRelease();
+#endif
+  /* Now check non-top. Rather than shifting the events before it along
+   * (which producers could be appending to), the event is marked as taken
+   * and jshPopIOEvent skips it when it gets to the tail */
+  unsigned int i = ioTail;
+  while (ioHead!=i && ioBuffer[i].flags!=EV_NONE) {
+    if (jshGetEventDevice((IOEvent*)&ioBuffer[i]) == eventType)
+      return jshTakeIOEvent(i, result, IOEVENT_TAKEN);
+    i = IOBUFFERIDX(i+1);
   }
   return false;
 }
@@ -548,19 +820,33 @@ bool jshHasEvents() {
 
 /// Check if the top event is for the given device
 bool jshIsTopEvent(IOEventFlags eventType) {
-  if (ioHead==ioTail) return false;
-  return IOEVENTFLAGS_GETTYPE(ioBuffer[ioTail].flags) == eventType;
+  jshSkipTakenIOEvents();
+  if (ioHead==ioTail || ioBuffer[ioTail].flags==EV_NONE) return false;
+  return jshGetEventDevice((IOEvent*)&ioBuffer[ioTail]) == eventType;
 }
 
 int jshGetEventsUsed() {
-  int spaceUsed = (ioHead >= ioTail) ? ((int)ioHead-(int)ioTail) : /*or rolled*/((int)ioHead+IOBUFFERMASK+1-(int)ioTail);
-  return spaceUsed;
+  return (int)IOBUFFERIDX(ioHead - ioTail);
+}
+
+int jshGetIOBufferUsage() {
+  int used = jshGetEventsUsed();
+#if IOCHARBUFFERSIZE>0
+  int charsUsed = (int)(jshGetIOCharBufferUsed() * IOBUFFERMASK / IOCHARBUFFERSIZE);
+  if (charsUsed > used) used = charsUsed;
+#endif
+  return used;
 }
 
 bool jshHasEventSpaceForChars(int n) {
   int spacesNeeded = 4 + (n/IOEVENT_MAXCHARS); // be sensible - leave a little spare
   int spaceUsed = jshGetEventsUsed();
   int spaceLeft = IOBUFFERMASK+1-spaceUsed;
+#if IOCHARBUFFERSIZE>0
+  // If it'll fit in ioCharBuffer, the characters will only need one event
+  if (n <= IOCHARBUFFER_MAXBLOCK && spaceLeft > 4 && jshIOCharBufferAlloc((unsigned int)n+1) >= 0)
+    return true;
+#endif
   return spaceLeft > spacesNeeded;
 }
 
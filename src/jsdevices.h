@@ -108,6 +108,9 @@ typedef enum {
 #endif
 #if I2C_COUNT>=1
   EV_I2C_MAX = EV_I2C1 + I2C_COUNT - 1,
+#endif
+#if IOCHARBUFFERSIZE>0
+  EV_BULK_CHARS,             // A block of received characters in ioCharBuffer - see jshPushIOCharEvents
 #endif
   EV_DEVICE_MAX,
   // EV_DEVICE_MAX should not be >64 - see DEVICE_INITIALISED_FLAGS
@@ -167,6 +170,10 @@ typedef enum {
 typedef union {
   unsigned int time; ///< BOTTOM 32 BITS of time the event occurred
   char chars[IOEVENT_MAXCHARS]; ///< Characters received
+  struct {
+    unsigned short start;  ///< EV_BULK_CHARS: index of the block in ioCharBuffer (first byte is the device)
+    unsigned short length; ///< EV_BULK_CHARS: number of characters in the block
+  } PACKED_FLAGS bulk;
 } PACKED_FLAGS IOEventData;
 
 // IO Events - these happen when a pin changes
@@ -185,19 +192,29 @@ void jshPushIOEvent(IOEventFlags channel, JsSysTime time);
 void jshPushIOWatchEvent(IOEventFlags channel); // push an even when a pin changes state
 /// Push a single character event (for example USART RX)
 void jshPushIOCharEvent(IOEventFlags channel, char charData);
-/// Push many character events at once (for example USB RX)
+/// Push many character events at once (for example USB RX). Blocks go in as a single EV_BULK_CHARS event if possible
 void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count);
+/// Get the device a character event came from (including EV_BULK_CHARS), or the event type for other events
+IOEventFlags jshGetEventDevice(IOEvent *event);
+/** Get the characters in a character event and set 'count'. For EV_BULK_CHARS
+ * the data is only valid until the next call to jshPopIOEvent/jshPopIOEventOfType */
+const char *jshGetEventChars(IOEvent *event, unsigned int *count);
 
 bool jshPopIOEvent(IOEvent *result); ///< returns true on success
 bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result); ///< returns true on success
 /// Do we have any events pending? Will jshPopIOEvent return true?
 bool jshHasEvents();
-/// Check if the top event is for the given device
+/// Check if the top event is for the given device (EV_BULK_CHARS events match the device they came from)
 bool jshIsTopEvent(IOEventFlags eventType);
 
 /// How many event blocks are left? compare this to IOBUFFERMASK
 int jshGetEventsUsed();
 
+/** How full the input buffers are, in events - the fuller of the event queue
+ * and the bulk character buffer (scaled to IOBUFFERMASK). Compare this to
+ * IOBUFFER_XON/XOFF for flow control */
+int jshGetIOBufferUsage();
+
 /// Do we have enough space for N characters?
 bool jshHasEventSpaceForChars(int n);
 
@@ -60,7 +60,9 @@ typedef enum {
 
 JsVar *events = 0; // Array of events to execute
 JsVarRef timerArray = 0; // Linked List of timers to check and run
+JsVar *timerQueue = 0; // Heap of the names in timerArray, ordered by when they fire
 JsVarRef watchArray = 0; // Linked List of input watches to check and run
+JsVar *watchTable = 0; // Flat string of JsiWatch for everything in watchArray, with the watches for each pin together
 // ----------------------------------------------------------------------------
 IOEventFlags consoleDevice = DEFAULT_CONSOLE_DEVICE; ///< The console device for user interaction
 #ifndef SAVE_ON_FLASH
@@ -425,6 +427,310 @@ void jsiSetSleep(JsiSleepType isSleep) {
 #endif
 }
 
+/* Each timer's "time" is the system time it should fire at. timerQueue is a
+ * flat string of refs to the timers' names in timerArray, kept as a binary heap
+ * ordered by that time, so jsiIdle only has to look at the first one. Like the
+ * array index in jsvar.c, element 0 is the number of timers in it. */
+
+static JsSysTime jsiTimerGetTime(JsVar *timerPtr) {
+  return (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
+}
+
+static JsSysTime jsiTimerQueueGetTime(JsVarRef timerName) {
+  JsVar *timerPtr = jsvSkipNameAndUnLock(jsvLock(timerName));
+  JsSysTime time = jsiTimerGetTime(timerPtr);
+  jsvUnLock(timerPtr);
+  return time;
+}
+
+/// Should timer a (which fires at aTime) fire before timer b? Timers due at the same time fire in the order they were added
+static bool jsiTimerQueueIsBefore(JsVarRef a, JsSysTime aTime, JsVarRef b, JsSysTime bTime) {
+  if (aTime != bTime) return aTime < bTime;
+  return _jsvGetAddressOf(a)->varData.integer < _jsvGetAddressOf(b)->varData.integer;
+}
+
+static JsVarRef *jsiTimerQueueGet() {
+  return timerQueue ? (JsVarRef*)jsvGetFlatStringPointer(timerQueue) : 0;
+}
+
+/// Move the timer at position i of the queue up or down until it's in the right place
+static void jsiTimerQueueFix(JsVarRef *queue, unsigned int i) {
+  JsVarRef ref = queue[i];
+  JsSysTime time = jsiTimerQueueGetTime(ref);
+  while (i>1 && jsiTimerQueueIsBefore(ref, time, queue[i/2], jsiTimerQueueGetTime(queue[i/2]))) {
+    queue[i] = queue[i/2];
+    i = i/2;
+  }
+  while (i*2 <= queue[0]) {
+    unsigned int child = i*2;
+    JsSysTime childTime = jsiTimerQueueGetTime(queue[child]);
+    if (child+1 <= queue[0]) {
+      JsSysTime otherTime = jsiTimerQueueGetTime(queue[child+1]);
+      if (jsiTimerQueueIsBefore(queue[child+1], otherTime, queue[child], childTime)) {
+        child++;
+        childTime = otherTime;
+      }
+    }
+    if (!jsiTimerQueueIsBefore(queue[child], childTime, ref, time)) break;
+    queue[i] = queue[child];
+    i = child;
+  }
+  queue[i] = ref;
+}
+
+/// Return the position of the given timer (not its name) in the queue, or 0
+static unsigned int jsiTimerQueueFind(JsVarRef *queue, JsVar *timerPtr) {
+  JsVarRef timerRef = jsvGetRef(timerPtr);
+  for (unsigned int i=1;i<=queue[0];i++)
+    if (jsvGetFirstChild(_jsvGetAddressOf(queue[i])) == timerRef)
+      return i;
+  return 0;
+}
+
+/// Make sure there's space in the queue for another timer, and return it (or 0 if out of memory)
+static JsVarRef *jsiTimerQueueMakeSpace() {
+  JsVarRef *queue = jsiTimerQueueGet();
+  unsigned int length = timerQueue ? (unsigned int)(jsvGetCharactersInVar(timerQueue)/sizeof(JsVarRef)) : 0;
+  if (queue && queue[0]+1 < length) return queue;
+  unsigned int newLength = (length<16) ? 16 : length*2;
+  JsVar *newQueue = jsvNewFlatStringOfLength((unsigned int)(newLength*sizeof(JsVarRef)));
+  if (!newQueue) {
+    jsErrorFlags |= JSERR_MEMORY;
+    return 0;
+  }
+  JsVarRef *newQueuePtr = (JsVarRef*)jsvGetFlatStringPointer(newQueue);
+  queue = jsiTimerQueueGet(); // allocating may have caused a GC, but flat strings don't move
+  if (queue) memcpy(newQueuePtr, queue, (queue[0]+1)*sizeof(JsVarRef));
+  else newQueuePtr[0] = 0;
+  jsvUnLock(timerQueue);
+  timerQueue = newQueue;
+  return newQueuePtr;
+}
+
+/// Add the timer with this name (which must already be in timerArray) to the queue
+static bool jsiTimerQueueAdd(JsVar *timerName) {
+  JsVarRef *queue = jsiTimerQueueMakeSpace();
+  if (!queue) return false;
+  queue[0]++;
+  queue[queue[0]] = jsvGetRef(timerName);
+  jsiTimerQueueFix(queue, queue[0]);
+  return true;
+}
+
+/// Create timerQueue from the contents of timerArray
+static void jsiTimerQueueBuild() {
+  jsvUnLock(timerQueue);
+  timerQueue = 0;
+  if (!timerArray) return;
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *timerName = jsvObjectIteratorGetKey(&it);
+    jsiTimerQueueAdd(timerName);
+    jsvUnLock(timerName);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(timerArrayPtr);
+}
+
+JsVarInt jsiTimerAdd(JsVar *timerPtr) {
+  // make sure we can queue the timer before we add it
+  if (!jsiTimerQueueMakeSpace()) return -1;
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsVarInt itemIndex = jsvArrayAddToEnd(timerArrayPtr, timerPtr, 1) - 1;
+  JsVar *timerName = jsvGetLastChild(timerArrayPtr) ? jsvLock(jsvGetLastChild(timerArrayPtr)) : 0;
+  if (timerName && jsvGetFirstChild(timerName)==jsvGetRef(timerPtr))
+    jsiTimerQueueAdd(timerName);
+  jsvUnLock2(timerName, timerArrayPtr);
+  return itemIndex;
+}
+
+void jsiTimerRemove(JsVar *timerName) {
+  JsVarRef *queue = jsiTimerQueueGet();
+  if (queue) {
+    JsVar *timerPtr = jsvSkipName(timerName);
+    unsigned int i = jsiTimerQueueFind(queue, timerPtr);
+    jsvUnLock(timerPtr);
+    if (i) {
+      queue[i] = queue[queue[0]];
+      queue[0]--;
+      if (i <= queue[0]) jsiTimerQueueFix(queue, i);
+    }
+  }
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  jsvRemoveChild(timerArrayPtr, timerName);
+  jsvUnLock(timerArrayPtr);
+}
+
+void jsiTimerSetTime(JsVar *timerPtr, JsSysTime time) {
+  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(time));
+  JsVarRef *queue = jsiTimerQueueGet();
+  unsigned int i = queue ? jsiTimerQueueFind(queue, timerPtr) : 0;
+  if (i) jsiTimerQueueFix(queue, i);
+}
+
+void jsiTimersShift(JsSysTime offset) {
+  if (!timerArray) return;
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+    // every timer moves by the same amount, so the queue stays in order
+    jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(jsiTimerGetTime(timerPtr) + offset));
+    jsvUnLock(timerPtr);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(timerArrayPtr);
+}
+
+/* watchTable is rebuilt from watchArray whenever a watch is added or removed,
+ * with all the watches for a pin next to each other (in the order they were
+ * added). watchChannelStart/End cache which part of it is for each EXTI
+ * channel, so an event only has to look at the watches for its own pin.
+ * End is 0 if we don't know yet. */
+static unsigned short watchChannelStart[EXTI_COUNT];
+static unsigned short watchChannelEnd[EXTI_COUNT];
+static unsigned char watchTableChanges = 0; ///< incremented each time watchTable is rebuilt
+static bool watchTableIncomplete = false; ///< there wasn't memory to rebuild watchTable, so it may not have every watch in it
+
+static JsiWatch *jsiWatchTableGet(unsigned int *count) {
+  if (!watchTable) {
+    *count = 0;
+    return 0;
+  }
+  JsiWatch *table = (JsiWatch*)jsvGetFlatStringPointer(watchTable);
+  *count = (unsigned int)(jsvGetCharactersInVar(watchTable)/sizeof(JsiWatch));
+  // if watches were removed when we couldn't rebuild it, there are unused entries at the end
+  while (*count && !table[*count-1].watch) (*count)--;
+  return table;
+}
+
+void jsiWatchesChanged() {
+  watchTableChanges++;
+  memset(watchChannelEnd, 0, sizeof(watchChannelEnd));
+  unsigned int oldCount;
+  JsiWatch *oldTable = jsiWatchTableGet(&oldCount);
+  JsVar *watchArrayPtr = watchArray ? jsvLock(watchArray) : 0;
+  unsigned int count = watchArrayPtr ? (unsigned int)jsvGetChildren(watchArrayPtr) : 0;
+  JsVar *newTable = 0;
+  if (count) {
+    newTable = jsvNewFlatStringOfLength((unsigned int)(count*sizeof(JsiWatch)));
+    oldTable = jsiWatchTableGet(&oldCount); // allocating may have caused a GC, but flat strings don't move
+  }
+  watchTableIncomplete = count && !newTable;
+  if (watchTableIncomplete) {
+    jsErrorFlags |= JSERR_MEMORY;
+    if (oldTable) {
+      /* No memory for a new table, so keep using the old one - without the
+       * watches that have been removed. Any new ones will be missing until
+       * jsiIdle manages to rebuild it. */
+      unsigned int n = 0;
+      for (unsigned int i=0;i<oldCount;i++) {
+        // a removed watch's name may have been freed already, so just compare refs
+        JsVarRef ref = jsvGetFirstChild(watchArrayPtr);
+        while (ref && ref!=oldTable[i].watch)
+          ref = jsvGetNextSibling(_jsvGetAddressOf(ref));
+        if (ref) oldTable[n++] = oldTable[i];
+      }
+      memset(&oldTable[n], 0, (oldCount-n)*sizeof(JsiWatch));
+      jsvUnLock(watchArrayPtr);
+      return;
+    }
+  }
+  if (newTable) {
+    JsiWatch *table = (JsiWatch*)jsvGetFlatStringPointer(newTable);
+    unsigned int n = 0;
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, watchArrayPtr);
+    while (jsvObjectIteratorHasValue(&it) && n<count) {
+      JsVar *watchName = jsvObjectIteratorGetKey(&it);
+      JsVar *watchPtr = jsvSkipName(watchName);
+      JsiWatch w;
+      w.watch = jsvGetRef(watchName);
+      w.pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+      w.edge = (signed char)jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "edge", 0));
+      w.recur = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "recur", 0));
+      w.debounce = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
+      w.state = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state", 0));
+      w.hasLastTime = false;
+      w.lastTime = 0;
+      // keep the state of watches we already knew about
+      for (unsigned int i=0;i<oldCount;i++) {
+        if (oldTable[i].watch == w.watch) {
+          w.state = oldTable[i].state;
+          w.hasLastTime = oldTable[i].hasLastTime;
+          w.lastTime = oldTable[i].lastTime;
+          break;
+        }
+      }
+      // put it after the last watch for the same pin, or at the end
+      unsigned int i = n;
+      while (i>0 && table[i-1].pin!=w.pin) i--;
+      if (!i) i = n;
+      memmove(&table[i+1], &table[i], (n-i)*sizeof(JsiWatch));
+      table[i] = w;
+      n++;
+      jsvUnLock2(watchPtr, watchName);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+  }
+  jsvUnLock2(watchArrayPtr, watchTable);
+  watchTable = newTable;
+}
+
+/// Return the watches for the pin this EXTI event is for (or 0), and set *count to the number of them
+static JsiWatch *jsiWatchesForEvent(IOEvent *event, unsigned int *count) {
+  unsigned int tableCount;
+  JsiWatch *table = jsiWatchTableGet(&tableCount);
+  unsigned int channel = (unsigned int)(IOEVENTFLAGS_GETTYPE(event->flags) - EV_EXTI0);
+  unsigned int start = watchChannelStart[channel];
+  unsigned int end = watchChannelEnd[channel];
+  // something other than watches could have moved the channel to a different pin, so check
+  if (!end || (start<end && !jshIsEventForPin(event, table[start].pin))) {
+    start = end = tableCount;
+    for (unsigned int i=0;i<tableCount;i++) {
+      if (jshIsEventForPin(event, table[i].pin)) {
+        start = end = i;
+        while (end<tableCount && table[end].pin==table[start].pin) end++;
+        break;
+      }
+    }
+    watchChannelStart[channel] = (unsigned short)start;
+    watchChannelEnd[channel] = (unsigned short)end;
+  }
+  *count = end-start;
+  return table ? &table[start] : 0;
+}
+
+/// Find the native copy of the given watch object, or 0
+static JsiWatch *jsiWatchFind(JsVar *watchPtr) {
+  unsigned int count;
+  JsiWatch *table = jsiWatchTableGet(&count);
+  JsVarRef watchRef = jsvGetRef(watchPtr);
+  for (unsigned int i=0;i<count;i++)
+    if (jsvGetFirstChild(_jsvGetAddressOf(table[i].watch)) == watchRef)
+      return &table[i];
+  return 0;
+}
+
+void jsiWatchRemove(JsVar *watchName) {
+  JsVar *watchPtr = jsvSkipName(watchName);
+  Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+  jsvUnLock(watchPtr);
+  JsVar *watchArrayPtr = jsvLock(watchArray);
+  jsvRemoveChild(watchArrayPtr, watchName);
+  jsvUnLock(watchArrayPtr);
+  jsiWatchesChanged();
+  // Now check if this pin is still being watched
+  if (!jsiIsWatchingPin(pin))
+    jshPinWatch(pin, false); // 'unwatch' pin
+}
+
 static JsVarRef _jsiInitNamedArray(const char *name) {
   JsVar *array = jsvObjectGetChild(execInfo.hiddenRoot, name, JSV_ARRAY);
   JsVarRef arrayRef = 0;
@@ -454,11 +760,15 @@ void jsiSoftInit(bool hasBeenReset) {
   // Load timer/watch arrays
   timerArray = _jsiInitNamedArray(JSI_TIMERS_NAME);
   watchArray = _jsiInitNamedArray(JSI_WATCHES_NAME);
+  jsiWatchesChanged();
 
   // Make sure we set up lastIdleTime, as this could be used
   // when adding an interval from onInit (called below)
   jsiLastIdleTime = jshGetSystemTime();
   jsiTimeSinceCtrlC = 0xFFFFFFFF;
+  // Timers are saved with times relative to jsiLastIdleTime
+  jsiTimersShift(jsiLastIdleTime);
+  jsiTimerQueueBuild();
 
   // Set up interpreter flags and remove
   JsVar *flags = jsvObjectGetChild(execInfo.hiddenRoot, JSI_JSFLAGS_NAME, 0);
@@ -506,9 +816,6 @@ void jsiSoftInit(bool hasBeenReset) {
     jsvUnLock(watchArrayPtr);
   }
 
-  // Timers are stored by time in the future now, so no need
-  // to fiddle with them.
-
   // Execute `init` events on `E`
   jsiExecuteEventCallbackOn("E", INIT_CALLBACK_NAME, 0, 0);
   // Execute the `onInit` function
@@ -738,10 +1045,22 @@ void jsiSoftKill() {
     events=0;
   }
   if (timerArray) {
+    // store timers relative to now, so they're still right whenever we start again
+    jsiTimersShift(-jsiLastIdleTime);
     jsvUnRefRef(timerArray);
     timerArray=0;
   }
+  jsvUnLock(timerQueue);
+  timerQueue=0;
   if (watchArray) {
+    // Store the state we kept natively in the watches
+    unsigned int count;
+    JsiWatch *table = jsiWatchTableGet(&count);
+    for (unsigned int i=0;i<count;i++) {
+      JsVar *watchPtr = jsvSkipNameAndUnLock(jsvLock(table[i].watch));
+      jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(table[i].state));
+      jsvUnLock(watchPtr);
+    }
     // Check any existing watches and disable interrupts for them
     JsVar *watchArrayPtr = jsvLock(watchArray);
     JsvObjectIterator it;
@@ -758,6 +1077,9 @@ void jsiSoftKill() {
     jsvUnLock(watchArrayPtr);
     watchArray=0;
   }
+  jsvUnLock(watchTable);
+  watchTable=0;
+  watchTableIncomplete = false;
   // Save flags if required
   if (jsFlags)
     jsvObjectSetChildAndUnLock(execInfo.hiddenRoot, JSI_JSFLAGS_NAME, jsvNewFromInteger(jsFlags));
@@ -1774,32 +2096,22 @@ bool jsiHasTimers() {
   return hasTimers;
 }
 
-/// Is the given watch object meant to be executed when the current value of the pin is pinIsHigh
-bool jsiShouldExecuteWatch(JsVar *watchPtr, bool pinIsHigh) {
-  int watchEdge = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "edge", 0));
-  return watchEdge==0 || // any edge
-      (pinIsHigh && watchEdge>0) || // rising edge
-      (!pinIsHigh && watchEdge<0); // falling edge
+/// Is the given watch meant to be executed when the current value of the pin is pinIsHigh
+static bool jsiShouldExecuteWatch(JsiWatch *watch, bool pinIsHigh) {
+  return watch->edge==0 || // any edge
+      (pinIsHigh && watch->edge>0) || // rising edge
+      (!pinIsHigh && watch->edge<0); // falling edge
 }
 
 bool jsiIsWatchingPin(Pin pin) {
   if (jshGetPinShouldStayWatched(pin))
     return true;
-  bool isWatched = false;
-  JsVar *watchArrayPtr = jsvLock(watchArray);
-  JsvObjectIterator it;
-  jsvObjectIteratorNew(&it, watchArrayPtr);
-  while (jsvObjectIteratorHasValue(&it)) {
-    JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
-    JsVar *pinVar = jsvObjectGetChild(watchPtr, "pin", 0);
-    if (jshGetPinFromVar(pinVar) == pin)
-      isWatched = true;
-    jsvUnLock2(pinVar, watchPtr);
-    jsvObjectIteratorNext(&it);
-  }
-  jsvObjectIteratorFree(&it);
-  jsvUnLock(watchArrayPtr);
-  return isWatched;
+  unsigned int count;
+  JsiWatch *table = jsiWatchTableGet(&count);
+  for (unsigned int i=0;i<count;i++)
+    if (table[i].pin == pin)
+      return true;
+  return false;
 }
 
 void jsiCtrlC() {
@@ -1819,21 +2131,18 @@ static JsVar *jsiExtractIOEventData(IOEvent *event, int *eventsHandled) {
 
   JsVar *stringData = jsvNewFromEmptyString();
   if (stringData) {
+    IOEventFlags device = jshGetEventDevice(event);
     JsvStringIterator it;
     jsvStringIteratorNew(&it, stringData, 0);
 
-    int i, chars = IOEVENTFLAGS_GETCHARS(event->flags);
-    while (chars) {
-      for (i=0;i<chars;i++) {
-        jsvStringIteratorAppend(&it, event->data.chars[i]);
-      }
+    while (true) {
+      unsigned int chars;
+      const char *data = jshGetEventChars(event, &chars);
+      jsvStringIteratorAppendBuf(&it, data, chars);
       // look down the stack and see if there is more data
-      if (jshIsTopEvent(IOEVENTFLAGS_GETTYPE(event->flags))) {
-        jshPopIOEvent(event);
-        (*eventsHandled)++;
-        chars = IOEVENTFLAGS_GETCHARS(event->flags);
-      } else
-        chars = 0;
+      if (!jshIsTopEvent(device)) break;
+      jshPopIOEvent(event);
+      (*eventsHandled)++;
     }
     jsvStringIteratorFree(&it);
   }
@@ -1855,9 +2164,25 @@ int jsiHandleIOEventForUSART(JsVar *usartClass, IOEvent *event) {
 }
 
 void jsiHandleIOEventForConsole(IOEvent *event) {
-  int i, c = IOEVENTFLAGS_GETCHARS(event->flags);
+  unsigned int i, c;
+  const char *chars = jshGetEventChars(event, &c);
   jsiSetBusy(BUSY_INTERACTIVE, true);
-  for (i=0;i<c;i++) jsiHandleChar(event->data.chars[i]);
+  if (chars == event->data.chars) {
+    for (i=0;i<c;i++) jsiHandleChar(chars[i]);
+  } else {
+    /* Bulk data is freed when the next event is popped, which executing a
+     * line of code could do (eg. the debugger) - so copy it first */
+    JsVar *data = jsvNewStringOfLength(c, chars);
+    if (data) {
+      JsvStringIterator it;
+      jsvStringIteratorNew(&it, data, 0);
+      while (jsvStringIteratorHasChar(&it)) {
+        jsiHandleChar(jsvStringIteratorGetCharAndNext(&it));
+      }
+      jsvStringIteratorFree(&it);
+      jsvUnLock(data);
+    }
+  }
   jsiSetBusy(BUSY_INTERACTIVE, false);
 }
 
@@ -1873,11 +2198,14 @@ void jsiIdle() {
   // Just process what was in the event queue at the start
   int maxEvents = jshGetEventsUsed();
 
+  // if there wasn't memory to rebuild the table of watches, try again
+  if (watchTableIncomplete && jshGetEventsUsed())
+    jsiWatchesChanged();
   while ((maxEvents--)>0 && jshPopIOEvent(&event)) {
     jsiSetBusy(BUSY_INTERACTIVE, true);
     wasBusy = true;
 
-    IOEventFlags eventType = IOEVENTFLAGS_GETTYPE(event.flags);
+    IOEventFlags eventType = jshGetEventDevice(&event);
 
     loopsIdling = 0; // because we're not idling
     if (eventType == consoleDevice) {
@@ -1934,123 +2262,124 @@ void jsiIdle() {
       jsvUnLock(i2cClass);
 #endif
     } else if (DEVICE_IS_EXTI(eventType)) { // ---------------------------------------------------------------- PIN WATCH
-      // we have an event... find out what it was for...
-      // Check everything in our Watch array
-      JsVar *watchArrayPtr = jsvLock(watchArray);
-      JsvObjectIterator it;
-      jsvObjectIteratorNew(&it, watchArrayPtr);
-      while (jsvObjectIteratorHasValue(&it)) {
-        bool hasDeletedWatch = false;
-        JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
-        Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
-
-        if (jshIsEventForPin(&event, pin)) {
-          /** Work out event time. Events time is only stored in 32 bits, so we need to
-           * use the correct 'high' 32 bits from the current time.
-           *
-           * We know that the current time is always newer than the event time, so
-           * if the bottom 32 bits of the current time is less than the bottom
-           * 32 bits of the event time, we need to subtract a full 32 bits worth
-           * from the current time.
-           */
-          JsSysTime time = jshGetSystemTime();
-          if (((unsigned int)time) < (unsigned int)event.data.time)
-            time = time - 0x100000000LL;
-          // finally, mask in the event's time
-          JsSysTime eventTime = (time & ~0xFFFFFFFFLL) | (JsSysTime)event.data.time;
-
-          // Now actually process the event
-          bool pinIsHigh = (event.flags&EV_EXTI_IS_HIGH)!=0;
-
-          bool executeNow = false;
-          JsVarInt debounce = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
-          if (debounce<=0) {
-            executeNow = true;
-          } else { // Debouncing - use timeouts to ensure we only fire at the right time
-            // store the current state of the pin
-            bool oldWatchState = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state",0));
-            JsVar *timeout = jsvObjectGetChild(watchPtr, "timeout", 0);
-            if (timeout) { // if we had a timeout, update the callback time
-              JsSysTime timeoutTime = jsiLastIdleTime + (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timeout, "time", 0));
-              jsvUnLock(jsvObjectSetChild(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce)));
+      /** Work out event time. Events time is only stored in 32 bits, so we need to
+       * use the correct 'high' 32 bits from the current time.
+       *
+       * We know that the current time is always newer than the event time, so
+       * if the bottom 32 bits of the current time is less than the bottom
+       * 32 bits of the event time, we need to subtract a full 32 bits worth
+       * from the current time.
+       */
+      JsSysTime time = jshGetSystemTime();
+      if (((unsigned int)time) < (unsigned int)event.data.time)
+        time = time - 0x100000000LL;
+      // finally, mask in the event's time
+      JsSysTime eventTimeForWatches = (time & ~0xFFFFFFFFLL) | (JsSysTime)event.data.time;
+      bool pinIsHigh = (event.flags&EV_EXTI_IS_HIGH)!=0;
+
+      // we have an event... find the watches for its pin
+      unsigned int watchCount;
+      JsiWatch *watch = jsiWatchesForEvent(&event, &watchCount);
+      while (watchCount) {
+        JsVar *watchName = jsvLock(watch->watch);
+        JsVarInt watchId = jsvGetInteger(watchName);
+        JsVar *watchPtr = jsvSkipName(watchName);
+        Pin pin = watch->pin;
+        JsSysTime eventTime = eventTimeForWatches;
+        unsigned char changes = watchTableChanges;
+
+        // Now actually process the event
+        bool executeNow = false;
+        JsVarInt debounce = watch->debounce;
+        if (debounce<=0) {
+          executeNow = true;
+        } else { // Debouncing - use timeouts to ensure we only fire at the right time
+          // the current state of the pin
+          bool oldWatchState = watch->state;
+          JsVar *timeout = jsvObjectGetChild(watchPtr, "timeout", 0);
+          if (timeout) { // if we had a timeout, update the callback time
+            JsSysTime timeoutTime = jsiTimerGetTime(timeout);
+            jsiTimerSetTime(timeout, eventTime + debounce);
+            jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
+            if (eventTime > timeoutTime && pinIsHigh!=oldWatchState) {
+              // timeout should have fired, but we didn't get around to executing it!
+              // Do it now (with the old timeout time)
+              executeNow = true;
+              eventTime = timeoutTime - debounce;
+              watch->state = pinIsHigh;
+              // Remove the timeout
+              JsVar *idArr = jsvNewArray(&timeout, 1);
+              jswrap_interface_clearTimeout(idArr);
+              jsvUnLock(idArr);
+              jsvObjectRemoveChild(watchPtr, "timeout");
+            }
+          } else if (pinIsHigh!=oldWatchState) { // else create a new timeout
+            timeout = jsvNewObject();
+            if (timeout) {
+              jsvObjectSetChild(timeout, "watch", watchPtr); // no unlock
+              jsvObjectSetChildAndUnLock(timeout, "time", jsvNewFromLongInteger(eventTime + debounce));
+              jsvObjectSetChildAndUnLock(timeout, "callback", jsvObjectGetChild(watchPtr, "callback", 0));
+              jsvObjectSetChildAndUnLock(timeout, "pin", jsvNewFromPin(pin));
               jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
-              if (eventTime > timeoutTime && pinIsHigh!=oldWatchState) {
-                // timeout should have fired, but we didn't get around to executing it!
-                // Do it now (with the old timeout time)
-                executeNow = true;
-                eventTime = timeoutTime - debounce;
-                jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(pinIsHigh));
-                // Remove the timeout
-                JsVar *idArr = jsvNewArray(&timeout, 1);
-                jswrap_interface_clearTimeout(idArr);
-                jsvUnLock(idArr);
-                jsvObjectRemoveChild(watchPtr, "timeout");
-              }
-            } else if (pinIsHigh!=oldWatchState) { // else create a new timeout
-              timeout = jsvNewObject();
-              if (timeout) {
-                jsvObjectSetChild(timeout, "watch", watchPtr); // no unlock
-                jsvObjectSetChildAndUnLock(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce));
-                jsvObjectSetChildAndUnLock(timeout, "callback", jsvObjectGetChild(watchPtr, "callback", 0));
-                jsvObjectSetChildAndUnLock(timeout, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-                jsvObjectSetChildAndUnLock(timeout, "pin", jsvNewFromPin(pin));
-                jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
-                // Add to timer array
-                jsiTimerAdd(timeout);
-                // Add to our watch
-                jsvObjectSetChild(watchPtr, "timeout", timeout); // no unlock
-              }
+              // Add to timer array
+              jsiTimerAdd(timeout);
+              // Add to our watch
+              jsvObjectSetChild(watchPtr, "timeout", timeout); // no unlock
             }
-            jsvUnLock(timeout);
           }
+          jsvUnLock(timeout);
+        }
 
-          // If we want to execute this watch right now...
-          if (executeNow) {
-            JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(eventTime)/1000);
-            if (jsiShouldExecuteWatch(watchPtr, pinIsHigh)) { // edge triggering
-              JsVar *watchCallback = jsvObjectGetChild(watchPtr, "callback", 0);
-              bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
-              JsVar *data = jsvNewObject();
-              if (data) {
-                jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
-                jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-                // set both data.time, and watch.lastTime in one go
-                jsvObjectSetChild(data, "time", timePtr); // no unlock
-                jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
-                Pin dataPin = jshGetEventDataPin(eventType);
-                if (jshIsPinValid(dataPin))
-                  jsvObjectSetChildAndUnLock(data, "data", jsvNewFromBool((event.flags&EV_EXTI_DATA_PIN_HIGH)!=0));
-              }
-              if (!jsiExecuteEventCallback(0, watchCallback, 1, &data) && watchRecurring) {
-                jsError("Ctrl-C while processing watch - removing it.");
-                jsErrorFlags |= JSERR_CALLBACK;
-                watchRecurring = false;
-              }
-              jsvUnLock(data);
-              if (!watchRecurring) {
-                // free all
-                jsvObjectIteratorRemoveAndGotoNext(&it, watchArrayPtr);
-                hasDeletedWatch = true;
-                if (!jsiIsWatchingPin(pin))
-                  jshPinWatch(pin, false);
-              }
-              jsvUnLock(watchCallback);
+        // If we want to execute this watch right now...
+        if (executeNow) {
+          bool hadLastTime = watch->hasLastTime;
+          JsSysTime lastTime = watch->lastTime;
+          watch->hasLastTime = true;
+          watch->lastTime = eventTime;
+          if (jsiShouldExecuteWatch(watch, pinIsHigh)) { // edge triggering
+            JsVar *watchCallback = jsvObjectGetChild(watchPtr, "callback", 0);
+            bool watchRecurring = watch->recur;
+            JsVar *data = jsvNewObject();
+            if (data) {
+              jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
+              jsvObjectSetChildAndUnLock(data, "lastTime", hadLastTime ? jsvNewFromFloat(jshGetMillisecondsFromTime(lastTime)/1000) : 0);
+              jsvObjectSetChildAndUnLock(data, "time", jsvNewFromFloat(jshGetMillisecondsFromTime(eventTime)/1000));
+              jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
+              Pin dataPin = jshGetEventDataPin(eventType);
+              if (jshIsPinValid(dataPin))
+                jsvObjectSetChildAndUnLock(data, "data", jsvNewFromBool((event.flags&EV_EXTI_DATA_PIN_HIGH)!=0));
+            }
+            if (!jsiExecuteEventCallback(0, watchCallback, 1, &data) && watchRecurring) {
+              jsError("Ctrl-C while processing watch - removing it.");
+              jsErrorFlags |= JSERR_CALLBACK;
+              watchRecurring = false;
             }
-            jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
+            jsvUnLock(data);
+            // the callback may have already removed it
+            if (!watchRecurring && jsvGetRefs(watchName))
+              jsiWatchRemove(watchName);
+            jsvUnLock(watchCallback);
           }
         }
+        jsvUnLock2(watchPtr, watchName);
 
-        jsvUnLock(watchPtr);
-        if (!hasDeletedWatch)
-          jsvObjectIteratorNext(&it);
+        if (changes == watchTableChanges) {
+          watch++;
+          watchCount--;
+        } else {
+          // Watches were added or removed, so find where we'd got to in the new watchTable
+          watch = jsiWatchesForEvent(&event, &watchCount);
+          while (watchCount && _jsvGetAddressOf(watch->watch)->varData.integer <= watchId) {
+            watch++;
+            watchCount--;
+          }
+        }
       }
-      jsvObjectIteratorFree(&it);
-      jsvUnLock(watchArrayPtr);
     }
   }
 
   // Reset Flow control if it was set...
-  if (jshGetEventsUsed() < IOBUFFER_XON) {
+  if (jshGetIOBufferUsage() < IOBUFFER_XON) {
     jshSetFlowControlAllReady();
   }
 
@@ -2065,135 +2394,109 @@ void jsiIdle() {
   if (oldTimeSinceCtrlC > jsiTimeSinceCtrlC)
     jsiTimeSinceCtrlC = 0xFFFFFFFF;
 
-  JsVar *timerArrayPtr = jsvLock(timerArray);
-  JsvObjectIterator it;
-  // Go through all intervals and decrement time
-  jsvObjectIteratorNew(&it, timerArrayPtr);
-  while (jsvObjectIteratorHasValue(&it)) {
-    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
-    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
-    JsSysTime timeUntilNext = timerTime - timePassed;
-    jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timeUntilNext));
-    jsvUnLock(timerPtr);
-    jsvObjectIteratorNext(&it);
-  }
-  jsvObjectIteratorFree(&it);
-  // Now go through intervals and execute if needed
-  do {
-    jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
-    jsvObjectIteratorNew(&it, timerArrayPtr);
-    while (jsvObjectIteratorHasValue(&it) && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
-      bool hasDeletedTimer = false;
-      JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
-      JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
-      if (timerTime<=0) {
-        // we're now doing work
-        jsiSetBusy(BUSY_INTERACTIVE, true);
-        wasBusy = true;
-        JsVar *timerCallback = jsvObjectGetChild(timerPtr, "callback", 0);
-        JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0); // for debounce - may be undefined
-        bool exec = true;
-        JsVar *data = 0;
-        if (watchPtr) {
-          bool watchState = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state", 0));
-          bool timerState = jsvGetBoolAndUnLock(jsvObjectGetChild(timerPtr, "state", 0));
-          jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(timerState));
-          exec = false;
-          if (watchState!=timerState) {
-            // Create the 'time' variable that will be passed to the user and stored as last time
-            JsVarInt delay = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
-            JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(jsiLastIdleTime+timerTime-delay)/1000);
-            // If it's the right edge...
-            if (jsiShouldExecuteWatch(watchPtr, timerState)) {
-              data = jsvNewObject();
-              // if we were from a watch then we were delayed by the debounce time...
-              if (data) {
-                exec = true;
-                // if it was a watch, set the last state up
-                jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(timerState));
-                // set up the lastTime variable of data to what was in the watch
-                jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-                // set up the watches lastTime to this one
-                jsvObjectSetChild(data, "time", timePtr); // don't unlock - use this later
-                jsvObjectSetChildAndUnLock(data, "pin", jsvObjectGetChild(watchPtr, "pin", 0));
-              }
-            }
-            // Update lastTime regardless of which edge we're watching
-            jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
-          }
-        }
-        bool removeTimer = false;
-        if (exec) {
-          bool execResult;
+  /* Timers store the time they should fire at, and timerQueue keeps them in
+   * that order - so we only have to look at the ones that are due */
+  JsVarRef *timerQueuePtr;
+  while ((timerQueuePtr = jsiTimerQueueGet()) && timerQueuePtr[0]) {
+    JsVar *timerName = jsvLock(timerQueuePtr[1]);
+    JsVar *timerPtr = jsvSkipName(timerName);
+    JsSysTime timerTime = jsiTimerGetTime(timerPtr);
+    if (timerTime > time) {
+      minTimeUntilNext = timerTime - time;
+      jsvUnLock2(timerPtr, timerName);
+      break;
+    }
+    // we're now doing work
+    jsiSetBusy(BUSY_INTERACTIVE, true);
+    wasBusy = true;
+    JsVar *timerCallback = jsvObjectGetChild(timerPtr, "callback", 0);
+    JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0); // for debounce - may be undefined
+    bool exec = true;
+    bool watchRecurring = false;
+    JsVar *data = 0;
+    if (watchPtr) {
+      JsiWatch *watch = jsiWatchFind(watchPtr);
+      bool timerState = jsvGetBoolAndUnLock(jsvObjectGetChild(timerPtr, "state", 0));
+      exec = false;
+      if (watch && watch->state!=timerState) {
+        watch->state = timerState;
+        watchRecurring = watch->recur;
+        // if we were from a watch then we were delayed by the debounce time...
+        JsSysTime watchTime = timerTime - watch->debounce;
+        // If it's the right edge...
+        if (jsiShouldExecuteWatch(watch, timerState)) {
+          data = jsvNewObject();
           if (data) {
-            execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
-          } else {
-            JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
-            execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
-            jsvUnLock(argsArray);
-          }
-          if (!execResult) {
-            JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
-            if (interval) { // if interval then it's setInterval not setTimeout
-              jsvUnLock(interval);
-              jsError("Ctrl-C while processing interval - removing it.");
-              jsErrorFlags |= JSERR_CALLBACK;
-              removeTimer = true;
-            }
+            exec = true;
+            // if it was a watch, set the last state up
+            jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(timerState));
+            // set up the lastTime variable of data to what was in the watch
+            jsvObjectSetChildAndUnLock(data, "lastTime", watch->hasLastTime ? jsvNewFromFloat(jshGetMillisecondsFromTime(watch->lastTime)/1000) : 0);
+            jsvObjectSetChildAndUnLock(data, "time", jsvNewFromFloat(jshGetMillisecondsFromTime(watchTime)/1000));
+            jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(watch->pin));
           }
         }
-        jsvUnLock(data);
-        if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
-          jsvObjectRemoveChild(watchPtr, "timeout");
-          // Deal with non-recurring watches
-          if (exec) {
-            bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
-            if (!watchRecurring) {
-              JsVar *watchArrayPtr = jsvLock(watchArray);
-              JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
-              if (watchNamePtr) {
-                jsvRemoveChild(watchArrayPtr, watchNamePtr);
-                jsvUnLock(watchNamePtr);
-              }
-              jsvUnLock(watchArrayPtr);
-              Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
-              if (!jsiIsWatchingPin(pin))
-                jshPinWatch(pin, false);
-            }
-          }
-          jsvUnLock(watchPtr);
-        }
-        // Load interval *after* executing code, in case it has changed
+        // Update lastTime regardless of which edge we're watching
+        watch->hasLastTime = true;
+        watch->lastTime = watchTime;
+      }
+    }
+    bool removeTimer = false;
+    if (exec) {
+      bool execResult;
+      if (data) {
+        execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
+      } else {
+        JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
+        execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
+        jsvUnLock(argsArray);
+      }
+      if (!execResult) {
         JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
-        if (!removeTimer && interval) {
-          timerTime = timerTime + jsvGetLongInteger(interval);
-          jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timerTime));
-        } else {
-          // free
-          // Beware... may have already been removed!
-          jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
-          hasDeletedTimer = true;
-          timerTime = -1;
+        if (interval) { // if interval then it's setInterval not setTimeout
+          jsvUnLock(interval);
+          jsError("Ctrl-C while processing interval - removing it.");
+          jsErrorFlags |= JSERR_CALLBACK;
+          removeTimer = true;
         }
-        jsvUnLock2(timerCallback,interval);
       }
-      // update the time until the next timer
-      if (timerTime>=0 && timerTime < minTimeUntilNext)
-        minTimeUntilNext = timerTime;
-      // update the timer's time
-      if (!hasDeletedTimer)
-        jsvObjectIteratorNext(&it);
-      jsvUnLock(timerPtr);
     }
-    jsvObjectIteratorFree(&it);
-  } while (jsiStatus & JSIS_TIMERS_CHANGED);
-  jsvUnLock(timerArrayPtr);
-  /* We might have left the timers loop with stuff to do because the contents of it
-   * changed. It's not a big deal because it could only have changed because a timer
-   * got executed - so `wasBusy` got set and we know we're going to go around the
-   * loop again before sleeping.
-   */
-
+    jsvUnLock(data);
+    if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
+      jsvObjectRemoveChild(watchPtr, "timeout");
+      // Deal with non-recurring watches
+      if (exec && !watchRecurring) {
+        JsVar *watchArrayPtr = jsvLock(watchArray);
+        JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
+        jsvUnLock(watchArrayPtr);
+        if (watchNamePtr) {
+          jsiWatchRemove(watchNamePtr);
+          jsvUnLock(watchNamePtr);
+        }
+      }
+      jsvUnLock(watchPtr);
+    }
+    // Load interval *after* executing code, in case it has changed
+    JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
+    bool isDueAgain = false;
+    if (!jsvGetRefs(timerName)) {
+      // the timer was cleared while we were executing it - nothing to do
+    } else if (!removeTimer && interval) {
+      timerTime = timerTime + jsvGetLongInteger(interval);
+      jsiTimerSetTime(timerPtr, timerTime);
+      isDueAgain = timerTime <= time;
+    } else {
+      jsiTimerRemove(timerName);
+    }
+    jsvUnLock2(timerCallback,interval);
+    jsvUnLock2(timerPtr, timerName);
+    /* If an interval is so far behind that it's already due again, leave it
+     * until next time around the idle loop so we don't get stuck here */
+    if (isDueAgain) {
+      minTimeUntilNext = 0;
+      break;
+    }
+  }
   // Check for events that might need to be processed from other libraries
   if (jswIdle()) wasBusy = true;
 
@@ -2280,13 +2583,34 @@ void jsiIdle() {
       minTimeUntilNext > jshGetTimeFromMilliseconds(10) &&
       !jsvMoreFreeVariablesThan(JS_VARS_BEFORE_IDLE_GC)) {
     jsiSetBusy(BUSY_INTERACTIVE, true);
+#ifdef JSV_GC_INCREMENTAL_VARS
+    /* Only do a bit at a time, so we can handle events in between. If
+     * there's more to do, come back here next time around the loop */
+    if (jsvGarbageCollectIncremental())
+      loopsIdling = 0;
+#else
     jsvGarbageCollect();
+#endif
     jsiSetBusy(BUSY_INTERACTIVE, false);
     /* Return here so we run around the idle loop again
      * and check whether any events came in during GC. If not
      * then we'll sleep. */
     return;
   }
+#ifdef JSV_GC_INCREMENTAL_VARS
+  /* If a flat string couldn't be allocated because memory was fragmented
+   * then move a few vars at a time down to the bottom of memory */
+  if (loopsIdling==1 &&
+      minTimeUntilNext > jshGetTimeFromMilliseconds(10)) {
+    jsiSetBusy(BUSY_INTERACTIVE, true);
+    bool more = jsvDefragmentIncremental();
+    jsiSetBusy(BUSY_INTERACTIVE, false);
+    if (more) {
+      loopsIdling = 0;
+      return;
+    }
+  }
+#endif
 
   // Go to sleep!
   if (loopsIdling>=1 && // once around the idle loop without having done any work already (just in case)
@@ -2411,7 +2735,7 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
     JsVar *timerInterval = jsvObjectGetChild(timer, "interval", 0);
     user_callback(timerInterval ? "setInterval(" : "setTimeout(", user_data);
     jsiDumpJSON(user_callback, user_data, timerCallback, 0);
-    cbprintf(user_callback, user_data, ", %f); // %v\n", jshGetMillisecondsFromTime(timerInterval ? jsvGetLongInteger(timerInterval) : jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timer, "time", 0))), timerNumber);
+    cbprintf(user_callback, user_data, ", %f); // %v\n", jshGetMillisecondsFromTime(timerInterval ? jsvGetLongInteger(timerInterval) : (jsiTimerGetTime(timer) - jsiLastIdleTime)), timerNumber);
     jsvUnLock3(timerInterval, timerCallback, timerNumber);
     // next
     jsvUnLock(timer);
@@ -2456,17 +2780,6 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
   }
 }
 
-JsVarInt jsiTimerAdd(JsVar *timerPtr) {
-  JsVar *timerArrayPtr = jsvLock(timerArray);
-  JsVarInt itemIndex = jsvArrayAddToEnd(timerArrayPtr, timerPtr, 1) - 1;
-  jsvUnLock(timerArrayPtr);
-  return itemIndex;
-}
-
-void jsiTimersChanged() {
-  jsiStatus |= JSIS_TIMERS_CHANGED;
-}
-
 #ifdef USE_DEBUGGER
 void jsiDebuggerLoop() {
   // exit if:
@@ -2510,7 +2823,7 @@ void jsiDebuggerLoop() {
     while (jshGetEventsUsed()>IOBUFFERMASK*1/2 &&
            !(jsiStatus & JSIS_EXIT_DEBUGGER) &&
            !(execInfo.execute & EXEC_CTRL_C_MASK)) {
-      if (jshPopIOEvent(&event) && IOEVENTFLAGS_GETTYPE(event.flags)==consoleDevice)
+      if (jshPopIOEvent(&event) && jshGetEventDevice(&event)==consoleDevice)
         jsiHandleIOEventForConsole(&event);
     }
     // otherwise grab the remaining console events
@@ -142,7 +142,6 @@ typedef enum {
   JSIS_NONE,
   JSIS_ECHO_OFF           = 1<<0, ///< do we provide any user feedback? OFF=no
   JSIS_ECHO_OFF_FOR_LINE  = 1<<1, ///< Echo is off just for one line, then back on
-  JSIS_TIMERS_CHANGED     = 1<<2,
 #ifdef USE_DEBUGGER
   JSIS_IN_DEBUGGER        = 1<<3, ///< We're inside the debug loop
   JSIS_EXIT_DEBUGGER      = 1<<4, ///< we've been asked to exit the debug loop
@@ -175,10 +174,28 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data);
 #define TIMER_MIN_INTERVAL 0.1 // in milliseconds
 #define TIMER_MAX_INTERVAL 31536000001000ULL // in milliseconds
 extern JsVarRef timerArray; // Linked List of timers to check and run
+extern JsVar *timerQueue; // Heap of the names in timerArray, ordered by when they fire
 extern JsVarRef watchArray; // Linked List of input watches to check and run
 
-extern JsVarInt jsiTimerAdd(JsVar *timerPtr);
-extern void jsiTimersChanged(); // Flag timers changed so we can skip out of the loop if needed
+/// A native copy of a watch in watchArray, so pin events don't have to look in the watch object
+typedef struct {
+  JsVarRef watch;     ///< The watch's name in watchArray
+  Pin pin;
+  signed char edge;   ///< 1 = rising, -1 = falling, 0 = both
+  bool recur;
+  bool state;         ///< The (debounced) state of the pin. Only written to the watch object in jsiSoftKill
+  bool hasLastTime;
+  JsVarInt debounce;  ///< Debounce time in JsSysTime units, or 0
+  JsSysTime lastTime; ///< When the pin's state last changed
+} JsiWatch;
+extern JsVar *watchTable; // Flat string of JsiWatch for everything in watchArray, with the watches for each pin together
+
+extern JsVarInt jsiTimerAdd(JsVar *timerPtr); // Add a timer (with "time" set to the system time it fires at) and return its id
+extern void jsiTimerRemove(JsVar *timerName); // Remove a timer, given its name in timerArray
+extern void jsiTimerSetTime(JsVar *timerPtr, JsSysTime time); // Change the system time a timer fires at
+extern void jsiTimersShift(JsSysTime offset); // Add offset to the time of every timer
+extern void jsiWatchesChanged(); // Rebuild watchTable - call after adding or removing watches
+extern void jsiWatchRemove(JsVar *watchName); // Remove a watch (and stop watching its pin if nothing else is), given its name in watchArray
 // end for jswrap_interactive/io.c ------------------------------------------------
 
 #ifdef USE_DEBUGGER
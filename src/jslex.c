@@ -347,6 +347,48 @@ static void jslLexRegex() {
   jsvStringIteratorFree(&it);
 }
 
+/* Raw literal (LEX_RAW_*) from pretokenised code. The value is already
+ * decoded, so we just copy it out without having to parse anything */
+static void jslLexRawToken() {
+  int rawTk = (unsigned char)lex->currCh;
+  jslGetNextCh();
+  if (rawTk==LEX_RAW_STRING8 || rawTk==LEX_RAW_STRING16) {
+    size_t length = (unsigned char)lex->currCh;
+    jslGetNextCh();
+    if (rawTk==LEX_RAW_STRING16) {
+      length |= ((size_t)(unsigned char)lex->currCh)<<8;
+      jslGetNextCh();
+    }
+    lex->tokenValue = jsvNewFromEmptyString();
+    if (!lex->tokenValue) {
+      lex->tk = LEX_EOF;
+      return;
+    }
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, lex->tokenValue, 0);
+    while (length--) {
+      jslTokenAppendChar(lex->currCh);
+      jsvStringIteratorAppend(&it, lex->currCh);
+      jslGetNextCh();
+    }
+    jsvStringIteratorFree(&it);
+    lex->tk = LEX_STR;
+  } else {
+    JsVarInt value = 0;
+    if (rawTk==LEX_RAW_INT8 || rawTk==LEX_RAW_INT16) {
+      value = (unsigned char)lex->currCh;
+      jslGetNextCh();
+    }
+    if (rawTk==LEX_RAW_INT16) {
+      value |= ((JsVarInt)(unsigned char)lex->currCh)<<8;
+      jslGetNextCh();
+    }
+    itostr(value, lex->token, 10);
+    lex->tokenl = (unsigned char)strlen(lex->token);
+    lex->tk = LEX_INT;
+  }
+}
+
 void jslSkipWhiteSpace() {
   jslSkipWhiteSpace_start:
   // Skip whitespace
@@ -393,8 +435,13 @@ void jslGetNextToken() {
   // tokens
   if (((unsigned char)lex->currCh) < jslJumpTableStart ||
       ((unsigned char)lex->currCh) > jslJumpTableEnd) {
-    // if unhandled by the jump table, just pass it through as a single character
-    jslSingleChar();
+    if (((unsigned char)lex->currCh) >= _LEX_RAW_START &&
+        ((unsigned char)lex->currCh) <= _LEX_RAW_END) {
+      jslLexRawToken();
+    } else {
+      // if unhandled by the jump table, just pass it through as a single character
+      jslSingleChar();
+    }
   } else {
     switch(jslJumpTable[((unsigned char)lex->currCh) - jslJumpTableStart]) {
     case JSLJT_ID: {
@@ -671,6 +718,7 @@ void jslInit(JsVar *var) {
   lex->tokenl = 0;
   lex->tokenValue = 0;
   lex->lineNumberOffset = 0;
+  lex->originalVar = 0;
   // set up iterator
   jsvStringIteratorNew(&lex->it, lex->sourceVar, 0);
   jsvUnLock(lex->it.var); // see jslGetNextCh
@@ -900,6 +948,29 @@ bool jslMatch(int expected_tk) {
   return true;
 }
 
+/** For jslNewTokenisedStringFromLexer - if the current token can be stored
+ * as a raw literal, return which LEX_RAW_* token to use (else 0). Raw data
+ * may not contain a newline character, as anything that works out line numbers
+ * (eg. for errors) would count it as a new line - so those are stored as text */
+static int jslGetRawTokenType() {
+  if (lex->tk==LEX_STR) {
+    size_t length = jsvGetStringLength(lex->tokenValue);
+    if ((length&255)=='\n' || (length>>8)=='\n' ||
+        jsvGetStringIndexOf(lex->tokenValue, '\n')>=0)
+      return 0;
+    if (length<=0xFF) return LEX_RAW_STRING8;
+    if (length<=0xFFFF) return LEX_RAW_STRING16;
+  } else if (lex->tk==LEX_INT) {
+    long long value = stringToInt(jslGetTokenValueAsString());
+    if ((value&255)=='\n' || ((value>>8)&255)=='\n')
+      return 0;
+    if (value==0) return LEX_RAW_INT0;
+    if (value>0 && value<=0xFF) return LEX_RAW_INT8;
+    if (value>0 && value<=0xFFFF) return LEX_RAW_INT16;
+  }
+  return 0;
+}
+
 JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
   // New method - tokenise functions
   // save old lex
@@ -912,11 +983,16 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
   jslSeekToP(charFrom);
   int lastTk = LEX_EOF;
   while (lex->tk!=LEX_EOF && jsvStringIteratorGetIndex(&lex->it)<=charTo+1) {
-    if ((lex->tk==LEX_ID || lex->tk==LEX_FLOAT || lex->tk==LEX_INT) &&
+    int rawTk = jslGetRawTokenType();
+    if ((lex->tk==LEX_ID || lex->tk==LEX_FLOAT || lex->tk==LEX_INT) && !rawTk &&
         ( lastTk==LEX_ID ||  lastTk==LEX_FLOAT ||  lastTk==LEX_INT)) {
       length++; // we need to insert a space
     }
-    if (lex->tk==LEX_ID ||
+    if (rawTk==LEX_RAW_STRING8 || rawTk==LEX_RAW_STRING16) {
+      length += 1 + (size_t)(rawTk==LEX_RAW_STRING16 ? 2 : 1) + jsvGetStringLength(lex->tokenValue);
+    } else if (rawTk) {
+      length += 1 + (size_t)(rawTk-LEX_RAW_INT0);
+    } else if (lex->tk==LEX_ID ||
         lex->tk==LEX_INT ||
         lex->tk==LEX_FLOAT ||
         lex->tk==LEX_STR ||
@@ -926,7 +1002,7 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
     } else {
       length++; // for single token
     }
-    lastTk = lex->tk;
+    lastTk = rawTk ? rawTk : lex->tk;
     jslGetNextToken();
   }
 
@@ -942,11 +1018,32 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
     jsvStringIteratorClone(&it, &charFrom->it);
     lastTk = LEX_EOF;
     while (lex->tk!=LEX_EOF && jsvStringIteratorGetIndex(&lex->it)<=charTo+1) {
-      if ((lex->tk==LEX_ID || lex->tk==LEX_FLOAT || lex->tk==LEX_INT) &&
+      int rawTk = jslGetRawTokenType();
+      if ((lex->tk==LEX_ID || lex->tk==LEX_FLOAT || lex->tk==LEX_INT) && !rawTk &&
           ( lastTk==LEX_ID ||  lastTk==LEX_FLOAT ||  lastTk==LEX_INT)) {
         jsvStringIteratorSetCharAndNext(&dstit, ' ');
       }
-      if (lex->tk==LEX_ID ||
+      if (rawTk==LEX_RAW_STRING8 || rawTk==LEX_RAW_STRING16) {
+        // store the string's value directly, so we don't have to decode escapes again
+        size_t l = jsvGetStringLength(lex->tokenValue);
+        jsvStringIteratorSetCharAndNext(&dstit, (char)rawTk);
+        jsvStringIteratorSetCharAndNext(&dstit, (char)(l&255));
+        if (rawTk==LEX_RAW_STRING16)
+          jsvStringIteratorSetCharAndNext(&dstit, (char)(l>>8));
+        JsvStringIterator valit;
+        jsvStringIteratorNew(&valit, lex->tokenValue, 0);
+        while (jsvStringIteratorHasChar(&valit))
+          jsvStringIteratorSetCharAndNext(&dstit, jsvStringIteratorGetCharAndNext(&valit));
+        jsvStringIteratorFree(&valit);
+      } else if (rawTk) {
+        // store the integer's value as binary
+        int value = (int)stringToInt(jslGetTokenValueAsString());
+        jsvStringIteratorSetCharAndNext(&dstit, (char)rawTk);
+        if (rawTk>=LEX_RAW_INT8)
+          jsvStringIteratorSetCharAndNext(&dstit, (char)(value&255));
+        if (rawTk>=LEX_RAW_INT16)
+          jsvStringIteratorSetCharAndNext(&dstit, (char)(value>>8));
+      } else if (lex->tk==LEX_ID ||
           lex->tk==LEX_INT ||
           lex->tk==LEX_FLOAT ||
           lex->tk==LEX_STR ||
@@ -960,7 +1057,7 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
       } else { // single char for the token
         jsvStringIteratorSetCharAndNext(&dstit, (char)lex->tk);
       }
-      lastTk = lex->tk;
+      lastTk = rawTk ? rawTk : lex->tk;
       jslSkipWhiteSpace();
       jsvStringIteratorFree(&it);
       jsvStringIteratorClone(&it, &lex->it);
@@ -977,6 +1074,32 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
   return var;
 }
 
+JsVar *jslNewTokenisedStringFromCode(JsVar *code) {
+  JsLex newLex;
+  JsLex *oldLex = jslSetLex(&newLex);
+  jslInit(code);
+  // Check there are no nested function definitions (including getters/setters)
+  bool hasFunctions = false;
+  while (lex->tk!=LEX_EOF && !hasFunctions) {
+    hasFunctions = lex->tk==LEX_R_FUNCTION ||
+                   lex->tk==LEX_ARROW_FUNCTION ||
+                   lex->tk==LEX_R_CLASS ||
+                   lex->tk==LEX_UNFINISHED_COMMENT ||
+                   (lex->tk==LEX_ID && (jslIsToken("get", 0) || jslIsToken("set", 0)));
+    jslGetNextToken();
+  }
+  JsVar *var = 0;
+  if (!hasFunctions) {
+    JslCharPos charFrom;
+    jslCharPosNew(&charFrom, code, 0);
+    var = jslNewTokenisedStringFromLexer(&charFrom, jsvGetStringLength(code));
+    jslCharPosFree(&charFrom);
+  }
+  jslKill();
+  jslSetLex(oldLex);
+  return var;
+}
+
 JsVar *jslNewStringFromLexer(JslCharPos *charFrom, size_t charTo) {
   // Original method - just copy it verbatim
   size_t maxLength = charTo + 1 - jsvStringIteratorGetIndex(&charFrom->it);
@@ -1037,19 +1160,86 @@ JsVar *jslNewStringFromLexer(JslCharPos *charFrom, size_t charTo) {
   return var;
 }
 
+/** If we're executing a pretokenised copy of some code, change `tokenPos` to the
+ * position of the same token in the original code (the copy has the same tokens,
+ * without whitespace or comments). Returns the var that `tokenPos` is now in */
+static JsVar *jslGetPositionSourceVar(size_t *tokenPos) {
+  if (!lex->originalVar) return lex->sourceVar;
+  JsLex *oldLex = lex;
+  JsLex newLex;
+  lex = &newLex;
+  // count the tokens before tokenPos in the copy...
+  jslInit(oldLex->sourceVar);
+  size_t tokens = 0;
+  while (lex->tk!=LEX_EOF && lex->tokenStart<*tokenPos) {
+    tokens++;
+    jslGetNextToken();
+  }
+  jslKill();
+  // ...and skip that many in the original
+  jslInit(oldLex->originalVar);
+  while (lex->tk!=LEX_EOF && tokens--)
+    jslGetNextToken();
+  *tokenPos = lex->tokenStart;
+  jslKill();
+  lex = oldLex;
+  return lex->originalVar;
+}
+
 /// Return the line number at the current character position (this isn't fast as it searches the string)
 unsigned int jslGetLineNumber() {
   size_t line;
   size_t col;
-  jsvGetLineAndCol(lex->sourceVar, lex->tokenStart, &line, &col);
+  size_t tokenPos = lex->tokenStart;
+  JsVar *code = jslGetPositionSourceVar(&tokenPos);
+  jsvGetLineAndCol(code, tokenPos, &line, &col);
   return (unsigned int)line;
 }
 
 /// Do we need a space between these two characters when printing a function's text?
 bool jslNeedSpaceBetween(unsigned char lastch, unsigned char ch) {
-  return (lastch>=_LEX_R_LIST_START || ch>=_LEX_R_LIST_START) &&
-         (lastch>=_LEX_R_LIST_START || isAlpha((char)lastch) || isNumeric((char)lastch)) &&
-         (ch>=_LEX_R_LIST_START || isAlpha((char)ch) || isNumeric((char)ch));
+  bool lastIsWord = lastch>=_LEX_R_LIST_START && lastch<=_LEX_R_LIST_END;
+  bool isWord = ch>=_LEX_R_LIST_START && ch<=_LEX_R_LIST_END;
+  return (lastIsWord || isWord) &&
+         (lastIsWord || isAlpha((char)lastch) || isNumeric((char)lastch)) &&
+         (isWord || isAlpha((char)ch) || isNumeric((char)ch));
+}
+
+/** For printing tokenised strings - raw literals are printed as if they were
+ * the first character of their text. Returns 0 for other characters. */
+static unsigned char jslGetRawTokenFirstChar(unsigned char ch) {
+  if (ch==LEX_RAW_STRING8 || ch==LEX_RAW_STRING16) return '"';
+  if (ch>=LEX_RAW_INT0 && ch<=LEX_RAW_INT16) return '0';
+  return 0;
+}
+
+/** Print a raw literal (LEX_RAW_*) whose data follows in `it` as JS source
+ * code. Returns the amount of characters output */
+static size_t jslPrintRawToken(unsigned char ch, JsvStringIterator *it, vcbprintf_callback user_callback, void *user_data) {
+  if (ch==LEX_RAW_STRING8 || ch==LEX_RAW_STRING16) {
+    size_t length = (unsigned char)jsvStringIteratorGetCharAndNext(it);
+    if (ch==LEX_RAW_STRING16)
+      length |= ((size_t)(unsigned char)jsvStringIteratorGetCharAndNext(it))<<8;
+    size_t chars = 2;
+    user_callback("\"", user_data);
+    while (length--) {
+      const char *s = escapeCharacter(jsvStringIteratorGetCharAndNext(it), false);
+      chars += strlen(s);
+      user_callback(s, user_data);
+    }
+    user_callback("\"", user_data);
+    return chars;
+  } else {
+    JsVarInt value = 0;
+    if (ch>=LEX_RAW_INT8)
+      value = (unsigned char)jsvStringIteratorGetCharAndNext(it);
+    if (ch>=LEX_RAW_INT16)
+      value |= ((JsVarInt)(unsigned char)jsvStringIteratorGetCharAndNext(it))<<8;
+    char buf[8];
+    itostr(value, buf, 10);
+    user_callback(buf, user_data);
+    return strlen(buf);
+  }
 }
 
 /// Output a tokenised string, replacing tokens with their text equivalents
@@ -1061,10 +1251,16 @@ void jslPrintTokenisedString(JsVar *code, vcbprintf_callback user_callback, void
   jsvStringIteratorNew(&it, code, 0);
   while (jsvStringIteratorHasChar(&it)) {
     unsigned char ch = (unsigned char)jsvStringIteratorGetCharAndNext(&it);
-    if (jslNeedSpaceBetween(lastch, ch))
+    unsigned char rawCh = jslGetRawTokenFirstChar(ch);
+    if (jslNeedSpaceBetween(lastch, rawCh ? rawCh : ch))
       user_callback(" ", user_data);
-    jslFunctionCharAsString(ch, buf, sizeof(buf));
-    user_callback(buf, user_data);
+    if (rawCh) {
+      jslPrintRawToken(ch, &it, user_callback, user_data);
+      ch = rawCh;
+    } else {
+      jslFunctionCharAsString(ch, buf, sizeof(buf));
+      user_callback(buf, user_data);
+    }
     lastch = ch;
   }
   jsvStringIteratorFree(&it);
@@ -1072,7 +1268,8 @@ void jslPrintTokenisedString(JsVar *code, vcbprintf_callback user_callback, void
 
 void jslPrintPosition(vcbprintf_callback user_callback, void *user_data, size_t tokenPos) {
   size_t line,col;
-  jsvGetLineAndCol(lex->sourceVar, tokenPos, &line, &col);
+  JsVar *code = jslGetPositionSourceVar(&tokenPos);
+  jsvGetLineAndCol(code, tokenPos, &line, &col);
   if (lex->lineNumberOffset)
     line += (size_t)lex->lineNumberOffset - 1;
   cbprintf(user_callback, user_data, "line %d col %d\n", line, col);
@@ -1080,9 +1277,10 @@ void jslPrintPosition(vcbprintf_callback user_callback, void *user_data, size_t
 
 void jslPrintTokenLineMarker(vcbprintf_callback user_callback, void *user_data, size_t tokenPos, char *prefix) {
   size_t line = 1,col = 1;
-  jsvGetLineAndCol(lex->sourceVar, tokenPos, &line, &col);
-  size_t startOfLine = jsvGetIndexFromLineAndCol(lex->sourceVar, line, 1);
-  size_t lineLength = jsvGetCharsOnLine(lex->sourceVar, line);
+  JsVar *code = jslGetPositionSourceVar(&tokenPos);
+  jsvGetLineAndCol(code, tokenPos, &line, &col);
+  size_t startOfLine = jsvGetIndexFromLineAndCol(code, line, 1);
+  size_t lineLength = jsvGetCharsOnLine(code, line);
   size_t prefixLength = 0;
 
   if (prefix) {
@@ -1104,20 +1302,29 @@ void jslPrintTokenLineMarker(vcbprintf_callback user_callback, void *user_data,
   // print the string until the end of the line, or 60 chars (whichever is less)
   int chars = 0;
   JsvStringIterator it;
-  jsvStringIteratorNew(&it, lex->sourceVar, startOfLine);
+  jsvStringIteratorNew(&it, code, startOfLine);
   unsigned char lastch = 0;
   while (jsvStringIteratorHasChar(&it) && chars<60 && lastch!=255) {
     unsigned char ch = (unsigned char)jsvStringIteratorGetCharAndNext(&it);
     if (ch == '\n') break;
-    if (jslNeedSpaceBetween(lastch, ch)) {
+    unsigned char rawCh = jslGetRawTokenFirstChar(ch);
+    if (jslNeedSpaceBetween(lastch, rawCh ? rawCh : ch)) {
       col++;
       user_callback(" ", user_data);
     }
-    char buf[32];
-    jslFunctionCharAsString(ch, buf, sizeof(buf));
-    size_t len = strlen(buf);
+    size_t len;
+    if (rawCh) {
+      size_t rawStart = jsvStringIteratorGetIndex(&it);
+      len = jslPrintRawToken(ch, &it, user_callback, user_data);
+      len -= jsvStringIteratorGetIndex(&it) - rawStart; // the raw data takes up columns too
+      ch = rawCh;
+    } else {
+      char buf[32];
+      jslFunctionCharAsString(ch, buf, sizeof(buf));
+      len = strlen(buf);
+      user_callback(buf, user_data);
+    }
     if (len) col += len-1;
-    user_callback(buf, user_data);
     chars++;
     lastch = ch;
   }
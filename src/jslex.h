@@ -99,7 +99,16 @@ _LEX_R_LIST_START,
     LEX_R_SUPER,
     LEX_R_STATIC,
     LEX_R_OF,
-_LEX_R_LIST_END = LEX_R_OF /* always the last entry */
+_LEX_R_LIST_END = LEX_R_OF, /* always the last reserved word */
+
+    // raw literals - only ever found in pretokenised code
+_LEX_RAW_START,
+    LEX_RAW_STRING8 = _LEX_RAW_START, ///< string, followed by 8 bit length and the string's (unescaped) data
+    LEX_RAW_STRING16, ///< string, followed by 16 bit length (LSB first) and the string's (unescaped) data
+    LEX_RAW_INT0, ///< the integer 0
+    LEX_RAW_INT8, ///< integer, followed by one byte of value
+    LEX_RAW_INT16, ///< integer, followed by two bytes of value (LSB first)
+_LEX_RAW_END = LEX_RAW_INT16
 } LEX_TYPES;
 
 
@@ -137,6 +146,9 @@ typedef struct JsLex
    */
   JsVar *sourceVar; // the actual string var
   JsvStringIterator it; // Iterator for the string
+  /** If sourceVar is a pretokenised copy of some code (see jslNewTokenisedStringFromCode),
+   * the code itself (not locked) - so we can report positions in the code the user wrote */
+  JsVar *originalVar;
 } JsLex;
 
 // The lexer
@@ -175,6 +187,11 @@ JsVar *jslNewStringFromLexer(JslCharPos *charFrom, size_t charTo);
 /// Create a new STRING from part of the lexer - keywords get tokenised
 JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo);
 
+/** Create a new tokenised STRING from all of the code in `code`. Returns 0 if
+ * out of memory, or if the code defines functions of its own (as their code would
+ * then get stored in tokenised form too) */
+JsVar *jslNewTokenisedStringFromCode(JsVar *code);
+
 /// Return the line number at the current character position (this isn't fast as it searches the string)
 unsigned int jslGetLineNumber();
 
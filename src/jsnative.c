@@ -56,24 +56,17 @@
 JsVar *jsnCallFunction(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount) {
 #ifdef USE_CALLFUNCTION_HACK
   // on Emscripten we cant easily hack around function calls with floats/etc so we must just do this brute-force by handling every call pattern we use
-  return jswCallFunctionHack(function, argumentSpecifier, thisParam, paramData, paramCount);
+  JsVar *hackResult = 0;
+  if (!jswCallFunctionBySpecifier(function, argumentSpecifier, thisParam, paramData, paramCount, &hackResult))
+    jsExceptionHere(JSET_ERROR,"Unknown argspec %d",argumentSpecifier);
+  return hackResult;
 #else
 #ifndef SAVE_ON_FLASH
-  // Handle common call types quickly:
-  // ------- void(void)
-  if (argumentSpecifier==JSWAT_VOID) {
-    ((void (*)())function)();
-    return 0;
-  }
-  // ------- JsVar*(void)
-  if (argumentSpecifier==JSWAT_JSVAR) {
-    return ((JsVar *(*)())function)();
-  }
-  // ------- void('this')
-  if (argumentSpecifier==(JSWAT_VOID | JSWAT_THIS_ARG)) {
-    ((void (*)(JsVar *))function)(thisParam);
-    return 0;
-  }
+  /* Every builtin's argument specifier has straight-line code generated for it
+   * by build_jswrapper.py, so use that if we can */
+  JsVar *specResult;
+  if (jswCallFunctionBySpecifier(function, argumentSpecifier, thisParam, paramData, paramCount, &specResult))
+    return specResult;
 #endif
   // Now do it the hard way...
 
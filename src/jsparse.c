@@ -80,9 +80,20 @@ void jspSetError(bool lineReported) {
 bool jspHasError() {
   return JSP_HAS_ERROR;
 }
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+static unsigned int jspScopesIdCounter = 0;
+/// Called whenever execInfo.scopesVar is changed to a different list of scopes
+static void jspeiScopesChanged() {
+  execInfo.scopesId = ++jspScopesIdCounter;
+}
+#endif
+
 void jspeiClearScopes() {
   jsvUnLock(execInfo.scopesVar);
   execInfo.scopesVar = 0;
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  jspeiScopesChanged();
+#endif
 }
 
 bool jspeiAddScope(JsVar *scope) {
@@ -90,6 +101,9 @@ bool jspeiAddScope(JsVar *scope) {
     execInfo.scopesVar = jsvNewEmptyArray();
   if (!execInfo.scopesVar) return false;
   jsvArrayPush(execInfo.scopesVar, scope);
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  jspeiScopesChanged();
+#endif
   return true;
 }
 
@@ -104,6 +118,9 @@ void jspeiRemoveScope() {
     jsvUnLock(execInfo.scopesVar);
     execInfo.scopesVar = 0;
   }
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  jspeiScopesChanged();
+#endif
 }
 
 JsVar *jspeiFindInScopes(const char *name) {
@@ -210,6 +227,9 @@ void jspeiLoadScopesFromVar(JsVar *arr) {
   jsvUnLock(execInfo.scopesVar);
   execInfo.scopesVar = 0;
   if (arr) execInfo.scopesVar = jsvCopy(arr, true);
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  jspeiScopesChanged();
+#endif
   // TODO: copy on write? would make function calls faster
 }
 // -----------------------------------------------
@@ -377,6 +397,7 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
   if (funcVar && lastTokenEnd>0) {
     // code var
     JsVar *funcCodeVar;
+    bool isTokenised = false;
     if (!forcePretokenise && jsvIsNativeString(lex->sourceVar)) {
       /* If we're parsing from a Native String (eg. E.memoryArea, E.setBootCode) then
       use another Native String to load function code straight from flash */
@@ -392,11 +413,18 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
     } else {
       if (jsfGetFlag(JSF_PRETOKENISE) || forcePretokenise) {
         funcCodeVar = jslNewTokenisedStringFromLexer(&funcBegin, (size_t)lastTokenEnd);
+        isTokenised = true;
       } else {
         funcCodeVar = jslNewStringFromLexer(&funcBegin, (size_t)lastTokenEnd);
       }
     }
-    jsvUnLock2(jsvAddNamedChild(funcVar, funcCodeVar, JSPARSE_FUNCTION_CODE_NAME), funcCodeVar);
+    jsvUnLock(jsvAddNamedChild(funcVar, funcCodeVar, JSPARSE_FUNCTION_CODE_NAME));
+#ifdef JSPARSE_MAX_TOKEN_CACHE_LENGTH
+    // already tokenised, so jspeFunctionCacheTokens needn't make a copy when it's called
+    if (isTokenised && funcCodeVar)
+      jsvObjectSetChild(funcVar, JSPARSE_FUNCTION_TOKENS_NAME, funcCodeVar);
+#endif
+    jsvUnLock(funcCodeVar);
     // scope var
     JsVar *funcScopeVar = jspeiGetScopesAsVar();
     if (funcScopeVar) {
@@ -480,6 +508,36 @@ NO_INLINE bool jspeParseFunctionCallBrackets() {
  *
  * functionName is used only for error reporting - and can be 0
  */
+#ifdef JSPARSE_MAX_TOKEN_CACHE_LENGTH
+/** Called the first time a function is executed - store a pretokenised copy of
+ * its code so that subsequent calls don't have to lex the source again. If the
+ * code can't be tokenised (too long, has line numbers for debugging, defines
+ * other functions, is executed from flash, or is pretokenised already) the code
+ * itself is stored so we don't try again. If we run out of memory,
+ * jsvFunctionTokensPurge drops the pretokenised copies. Returns the code that
+ * should be executed, or 0 */
+static JsVar *jspeFunctionCacheTokens(JsVar *function, JsVar *functionCode, bool hasLineNumber) {
+  if (!jsvIsString(functionCode)) return 0;
+  size_t length = jsvGetStringLength(functionCode);
+  JsVar *tokens = 0;
+  if (!hasLineNumber && length<=JSPARSE_MAX_TOKEN_CACHE_LENGTH &&
+      !jsvIsNativeString(functionCode) && !jsvIsFlashString(functionCode)) {
+    // if memory is low, don't tokenise this time - we can try again next call
+    if (!jsvMoreFreeVariablesThan((unsigned int)(JS_VARS_BEFORE_IDLE_GC + length/JSVAR_DATA_STRING_MAX_LEN)))
+      return 0;
+    tokens = jslNewTokenisedStringFromCode(functionCode);
+    // if it's no shorter (eg. the code was already minified) the copy's not worth keeping
+    if (tokens && jsvGetStringLength(tokens)>=length) {
+      jsvUnLock(tokens);
+      tokens = 0;
+    }
+  }
+  if (!tokens) tokens = jsvLockAgain(functionCode);
+  jsvObjectSetChild(function, JSPARSE_FUNCTION_TOKENS_NAME, tokens);
+  return tokens;
+}
+#endif
+
 NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *thisArg, bool isParsing, int argCount, JsVar **argPtr) {
   if (JSP_SHOULD_EXECUTE && !function) {
     if (functionName)
@@ -628,6 +686,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 
       JsVar *functionScope = 0;
       JsVar *functionCode = 0;
+      JsVar *functionTokens = 0;
       JsVar *functionInternalName = 0;
       uint16_t functionLineNumber = 0;
 
@@ -691,6 +750,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         if (jsvIsString(param)) {
           if (jsvIsStringEqual(param, JSPARSE_FUNCTION_SCOPE_NAME)) functionScope = jsvSkipName(param);
           else if (jsvIsStringEqual(param, JSPARSE_FUNCTION_CODE_NAME)) functionCode = jsvSkipName(param);
+          else if (jsvIsStringEqual(param, JSPARSE_FUNCTION_TOKENS_NAME)) functionTokens = jsvSkipName(param);
           else if (jsvIsStringEqual(param, JSPARSE_FUNCTION_NAME_NAME)) functionInternalName = jsvSkipName(param);
           else if (jsvIsStringEqual(param, JSPARSE_FUNCTION_THIS_NAME)) {
             jsvUnLock(thisVar);
@@ -718,6 +778,10 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         // save old scopes and reset scope list
         JsVar *oldScopeVar = execInfo.scopesVar;
         execInfo.scopesVar = 0;
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+        unsigned int oldScopesId = execInfo.scopesId;
+        jspeiScopesChanged();
+#endif
         // if we have a scope var, load it up. We may not have one if there were no scopes apart from root
         if (functionScope) {
           jspeiLoadScopesFromVar(functionScope);
@@ -756,9 +820,21 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 #endif
 
 
+#ifdef JSPARSE_MAX_TOKEN_CACHE_LENGTH
+            if (!functionTokens)
+              functionTokens = jspeFunctionCacheTokens(function, functionCode, functionLineNumber!=0);
+            if (functionTokens==functionCode) {
+              // no copy - don't hold an extra lock on the code for every level of recursion
+              jsvUnLock(functionTokens);
+              functionTokens = 0;
+            }
+#endif
+
             JsLex newLex;
             JsLex *oldLex = jslSetLex(&newLex);
-            jslInit(functionCode);
+            jslInit(functionTokens ? functionTokens : functionCode);
+            if (functionTokens)
+              newLex.originalVar = functionCode; // so errors are reported in the code the user wrote
             newLex.lineNumberOffset = functionLineNumber;
             JSP_SAVE_EXECUTE();
             // force execute without any previous state
@@ -837,8 +913,11 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         // Unlock scopes and restore old ones
         jsvUnLock(execInfo.scopesVar);
         execInfo.scopesVar = oldScopeVar;
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+        execInfo.scopesId = oldScopesId; // so lookups cached before the call are still valid
+#endif
       }
-      jsvUnLock(functionCode);
+      jsvUnLock2(functionCode, functionTokens);
       jsvUnLock(functionRoot);
     }
 
@@ -852,9 +931,55 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
   } else return 0;
 }
 
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+/// The name found by jspeiFindInScopes for a variable at a certain position in the code
+typedef struct {
+  JsVarRef code; ///< The code var that was being executed
+  size_t position; ///< Position of the variable in the code
+  unsigned int scopesId; ///< execInfo.scopesId when this was found
+  JsVarRef child; ///< The name that was found in one of the scopes
+  unsigned int changeCount; ///< jsvObjectChangeCount when this was found
+  unsigned int addCount; ///< jsvObjectAddCount when this was found
+} JspScopeCacheEntry;
+static JspScopeCacheEntry jspScopeCache[JSPARSE_SCOPE_CACHE_SIZE];
+#endif
+
+/** Like jspeiFindInScopes, but used for a variable in the code currently being executed,
+ * so we can remember which name we found and not search the scopes for it next time. */
+static JsVar *jspeiFindInScopesAtToken(const char *name) {
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  if (!lex) return jspeiFindInScopes(name); // called from outside the parser
+  size_t position = lex->tokenStart;
+  JsVarRef code = jsvGetRef(lex->sourceVar);
+  JspScopeCacheEntry *entry = &jspScopeCache[(position ^ code) & (JSPARSE_SCOPE_CACHE_SIZE-1)];
+  JsVar *child;
+  /* If the scopes are the same, nothing has been removed from them and nothing
+   * added that could hide the name, we'll find the same thing again */
+  if (entry->scopesId==execInfo.scopesId && entry->position==position && entry->code==code &&
+      entry->changeCount==jsvObjectChangeCount && entry->addCount==jsvObjectAddCount) {
+    // check it's right in case the code var was replaced
+    child = jsvLock(entry->child);
+    if (jsvIsStringEqual(child, name)) return child;
+    jsvUnLock(child);
+  }
+  child = jspeiFindInScopes(name);
+  if (child) {
+    entry->code = code;
+    entry->position = position;
+    entry->scopesId = execInfo.scopesId;
+    entry->child = jsvGetRef(child);
+    entry->changeCount = jsvObjectChangeCount;
+    entry->addCount = jsvObjectAddCount;
+  }
+  return child;
+#else
+  return jspeiFindInScopes(name);
+#endif
+}
+
 // Find a variable (or built-in function) based on the current scopes
 JsVar *jspGetNamedVariable(const char *tokenName) {
-  JsVar *a = JSP_SHOULD_EXECUTE ? jspeiFindInScopes(tokenName) : 0;
+  JsVar *a = JSP_SHOULD_EXECUTE ? jspeiFindInScopesAtToken(tokenName) : 0;
   if (JSP_SHOULD_EXECUTE && !a) {
     /* Special case! We haven't found the variable, so check out
      * and see if it's one of our builtins...  */
@@ -1016,6 +1141,50 @@ JsVar *jspCallNamedFunction(JsVar *object, char* name, int argCount, JsVar **arg
   return r;
 }
 
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+/// The name found by an `obj.name` lookup at a certain position in the code
+typedef struct {
+  JsVarRef code; ///< The code var that was being executed
+  size_t position; ///< Position of `name` in the code
+  JsVarRef object; ///< The object that was searched
+  JsVarRef child; ///< The name that was found in the object
+  unsigned int changeCount; ///< jsvObjectChangeCount when this was found
+} JspMemberCacheEntry;
+static JspMemberCacheEntry jspMemberCache[JSPARSE_MEMBER_CACHE_SIZE];
+#endif
+
+/** Like jspGetNamedField(object, name, true), but used for `object.name` in the code
+ * currently being executed, so we can remember where we found `name` and not search for
+ * it next time. */
+static JsVar *jspGetNamedFieldAtToken(JsVar *object, const char* name) {
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+  if (jsvIsObject(object)) {
+    size_t position = lex->tokenStart;
+    JsVarRef code = jsvGetRef(lex->sourceVar);
+    JsVarRef objectRef = jsvGetRef(object);
+    JspMemberCacheEntry *entry = &jspMemberCache[(position ^ code) & (JSPARSE_MEMBER_CACHE_SIZE-1)];
+    JsVar *child;
+    if (entry->object==objectRef && entry->position==position && entry->code==code &&
+        entry->changeCount==jsvObjectChangeCount) {
+      // The name is still in the object, but check it's right in case the code var was replaced
+      child = jsvLock(entry->child);
+      if (jsvIsStringEqual(child, name)) return child;
+      jsvUnLock(child);
+    }
+    // Only names in the object itself are cached - prototypes can be changed without us knowing
+    child = jsvFindChildFromString(object, name, false);
+    if (!child) return jspGetNamedFieldInParents(object, name, true);
+    entry->code = code;
+    entry->position = position;
+    entry->object = objectRef;
+    entry->child = jsvGetRef(child);
+    entry->changeCount = jsvObjectChangeCount;
+    return child;
+  }
+#endif
+  return jspGetNamedField(object, name, true);
+}
+
 NO_INLINE JsVar *jspeFactorMember(JsVar *a, JsVar **parentResult) {
   /* The parent if we're executing a method call */
   JsVar *parent = 0;
@@ -1031,7 +1200,7 @@ NO_INLINE JsVar *jspeFactorMember(JsVar *a, JsVar **parentResult) {
           JsVar *aVar = jsvSkipNameWithParent(a,true,parent);
           JsVar *child = 0;
           if (aVar)
-            child = jspGetNamedField(aVar, name, true);
+            child = jspGetNamedFieldAtToken(aVar, name);
           if (!child) {
             if (!jsvIsUndefined(aVar)) {
               // if no child found, create a pointer to where it could be
@@ -1925,8 +2094,8 @@ NO_INLINE JsVar *__jspeBinaryExpression(JsVar *a, unsigned int lastPrecedence) {
           jsvUnLock3(av, bv, a);
           a = jsvNewFromBool(inst);
         } else {  // --------------------------------------------- NORMAL
-          JsVar *res = jsvMathsOpSkipNames(a, b, op);
-          jsvUnLock(a); a = res;
+          a = jsvMathsOpSkipNamesAndUnLock(a, b, op);
+          b = 0; // unlocked above
         }
       }
       jsvUnLock(b);
@@ -2019,7 +2188,8 @@ NO_INLINE JsVar *__jspeAssignmentExpression(JsVar *lhs) {
         }
         if (op) {
           /* Fallback which does a proper add */
-          JsVar *res = jsvMathsOpSkipNames(lhs,rhs,op);
+          JsVar *res = jsvMathsOpSkipNamesAndUnLock(jsvLockAgain(lhs),rhs,op);
+          rhs = 0; // unlocked above
           jsvReplaceWith(lhs, res);
           jsvUnLock(res);
         }
@@ -2914,6 +3084,12 @@ JsVar *jspGetConstructor(JsVar *object) {
 // -----------------------------------------------------------------------------
 
 void jspSoftInit() {
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+  memset(jspMemberCache, 0, sizeof(jspMemberCache));
+#endif
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  memset(jspScopeCache, 0, sizeof(jspScopeCache));
+#endif
   execInfo.root = jsvFindOrCreateRoot();
   // Root now has a lock and a ref
   execInfo.hiddenRoot = jsvObjectGetChild(execInfo.root, JS_HIDDEN_CHAR_STR, JSV_OBJECT);
@@ -2921,6 +3097,12 @@ void jspSoftInit() {
 }
 
 void jspSoftKill() {
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+  jsvNativeFunctionCacheClear();
+#endif
+#ifdef JSV_NAME_ATOMS
+  jsvNameAtomsClear();
+#endif
   jsvUnLock(execInfo.scopesVar);
   execInfo.scopesVar = 0;
   jsvUnLock(execInfo.hiddenRoot);
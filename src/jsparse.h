@@ -136,6 +136,10 @@ typedef struct {
 
   /// JsVar array of scopes
   JsVar *scopesVar;
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  /// Changes whenever scopesVar is set to a different list of scopes
+  unsigned int scopesId;
+#endif
   /// Value of 'this' reserved word
   JsVar *thisVar;
 
@@ -793,21 +793,40 @@ void vcbprintf(
         bool quoted = fmtChar!='v';
         bool isJSONStyle = fmtChar=='Q';
         if (quoted) user_callback("\"",user_data);
-        JsVar *v = jsvAsString(va_arg(argp, JsVar*));
-        buf[1] = 0;
-        if (jsvIsString(v)) {
-          JsvStringIterator it;
-          jsvStringIteratorNew(&it, v, 0);
-          // OPT: this could be faster than it is (sending whole blocks at once)
-          while (jsvStringIteratorHasChar(&it)) {
-            buf[0] = jsvStringIteratorGetCharAndNext(&it);
-            if (quoted) {
-              user_callback(escapeCharacter(buf[0], isJSONStyle), user_data);
-            } else {
+        JsVar *v = va_arg(argp, JsVar*);
+        if (jsvIsFloat(v) || (jsvIsInt(v) && !jsvIsName(v) && !jsvIsPin(v))) {
+          // numbers never need escaping, and we can avoid allocating a string for them
+          char numBuf[JS_NUMBER_BUFFER_SIZE];
+          jsvGetString(v, numBuf, sizeof(numBuf));
+          user_callback(numBuf, user_data);
+        } else {
+          v = jsvAsString(v);
+          if (jsvIsString(v)) {
+            // Send characters in chunks rather than one at a time
+            size_t len = 0;
+            JsvStringIterator it;
+            jsvStringIteratorNew(&it, v, 0);
+            while (jsvStringIteratorHasChar(&it)) {
+              char ch = jsvStringIteratorGetCharAndNext(&it);
+              if (quoted) {
+                const char *e = escapeCharacter(ch, isJSONStyle);
+                while (*e) buf[len++] = *(e++);
+              } else {
+                buf[len++] = ch;
+              }
+              // escaped characters can be up to 6 chars, plus the trailing 0
+              if (len >= sizeof(buf)-7) {
+                buf[len] = 0;
+                user_callback(buf,user_data);
+                len = 0;
+              }
+            }
+            jsvStringIteratorFree(&it);
+            if (len) {
+              buf[len] = 0;
               user_callback(buf,user_data);
             }
           }
-          jsvStringIteratorFree(&it);
           jsvUnLock(v);
         }
         if (quoted) user_callback("\"",user_data);
@@ -236,9 +236,70 @@ typedef int64_t JsSysTime;
 
 #define JSLEX_MAX_TOKEN_LENGTH  64 ///< Maximum length we allow tokens (eg. variable names) to be
 #define JS_ERROR_TOKEN_BUF_SIZE 16 ///< see jslTokenAsString
+#ifndef SAVE_ON_FLASH
+/** When a function whose code is shorter than this is first called, a pretokenised
+ * copy of its code is stored alongside it so later calls don't have to lex the
+ * source text again. */
+#define JSPARSE_MAX_TOKEN_CACHE_LENGTH 1024
+/** How many `obj.name` lookups to remember (power of 2). Each entry is keyed
+ * on the position of `name` in the code being executed. */
+#define JSPARSE_MEMBER_CACHE_SIZE 32
+/** How many variable lookups (eg. `x`) to remember (power of 2). Each entry is
+ * keyed on the position of `x` in the code and is only valid for the same list
+ * of scopes, so a variable used in a loop is only searched for once. Needs
+ * JSPARSE_MEMBER_CACHE_SIZE (for jsvObjectChangeCount). Each function call
+ * makes new scopes, so lookups in a function's body are cached again per call. */
+#define JSPARSE_SCOPE_CACHE_SIZE 32
+/** When garbage collecting from the idle loop, how many vars to look at before
+ * going back around the idle loop to check for events */
+#define JSV_GC_INCREMENTAL_VARS 1024
+/** How many runs of contiguous free vars to remember, so flat strings can
+ * be allocated without searching the free list */
+#define JSV_FREE_RUNS 8
+/** How many built-in function objects (eg. for `Math.sin`) to keep around, so
+ * they don't have to be created again each time they're referenced (power of 2) */
+#define JSV_NATIVE_FUNCTION_CACHE_SIZE 16
+/** Add minimal perfect hash tables to each list of built-in symbols so that
+ * lookups need one hash and one string compare, rather than a binary search.
+ * Costs around 1.5 bytes of flash per symbol. */
+#define JSWRAPPER_SYMBOL_HASH
+#endif
 
 #define JS_NUMBER_BUFFER_SIZE 70 ///< Enough for 64 bit base 2 + minus + terminating 0
 
+#if !defined(SAVE_ON_FLASH) && !defined(JSVARREF_PACKED_BITS)
+/** Objects and arrays may keep an index of their children in a flat string
+ * referenced from their (otherwise unused) nextSibling */
+#define JSV_CHILD_INDEXES
+/** Objects with at least this many children get a hash index of their
+ * children's names, so jsvFindChildFromString doesn't have to search them all */
+#define JSV_HASH_INDEX_THRESHOLD 16
+/** Arrays with at least this many elements, that have every element from 0 to
+ * length-1, get an index of their elements when accessed so arr[i] is O(1) */
+#define JSV_ARRAY_INDEX_THRESHOLD 16
+/** Names too long to fit in one var share the rest of their characters with
+ * every other name that ends the same way (an 'atom'), rather than each
+ * having their own copy. Names with atoms can then be compared by reference */
+#define JSV_NAME_ATOMS
+#endif
+
+/* Size of the explicit stack used when marking variables during garbage
+ * collection. If it fills up, memory is rescanned to finish marking, so
+ * this only affects speed, not whether GC completes */
+#ifdef SAVE_ON_FLASH
+#define JSV_GC_MARK_STACK_SIZE 16
+#else
+#define JSV_GC_MARK_STACK_SIZE 64
+#endif
+
+/* How many vars jsvDefragment moves at once. Each batch needs two scans
+ * over memory, and the idle loop does one batch at a time */
+#ifdef SAVE_ON_FLASH
+#define JSV_DEFRAG_VARS 16
+#else
+#define JSV_DEFRAG_VARS 32
+#endif
+
 /* If we have less free variables than this, do a garbage collect on Idle.
  * Note that the check for free variables takes an amount of time proportional
  * to the size of JS_VARS_BEFORE_IDLE_GC */
@@ -265,6 +326,7 @@ typedef int64_t JsSysTime;
 #define JSPARSE_FUNCTION_THIS_NAME JS_HIDDEN_CHAR_STR"ths" // the 'this' variable - for bound functions
 #define JSPARSE_FUNCTION_NAME_NAME JS_HIDDEN_CHAR_STR"nam" // for named functions (a = function foo() { foo(); })
 #define JSPARSE_FUNCTION_LINENUMBER_NAME JS_HIDDEN_CHAR_STR"lin" // The line number offset of the function
+#define JSPARSE_FUNCTION_TOKENS_NAME JS_HIDDEN_CHAR_STR"tok" // pretokenised copy of the function's code (or the code itself if it can't be tokenised)
 #define JS_EVENT_PREFIX "#on"
 #define JS_TIMEZONE_VAR "tz"
 #define JS_GRAPHICS_VAR "gfx"
@@ -58,8 +58,74 @@ typedef enum {
 } MemBusyType;
 
 volatile bool touchedFreeList = false;
-volatile JsVarRef jsVarFirstEmpty; ///< reference of first unused variable (variables are in a linked list)
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+unsigned int jsvObjectChangeCount = 0;
+#endif
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+unsigned int jsvObjectAddCount = 0;
+#endif
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+/// Built-in functions returned by jsvNewNativeFunctionShared. Each one has a ref held for it, and the GC treats them as roots
+static JsVarRef jsvNativeFunctionCache[JSV_NATIVE_FUNCTION_CACHE_SIZE];
+static void jsvNativeFunctionCacheRelease(JsVarRef *entry);
+#endif
+#ifdef JSV_NAME_ATOMS
+/// Hash table of all atoms (a flat string of JsVarRefs, element 0 is the count), or 0. See jsvNameAtomGet
+static JsVar *nameAtoms = 0;
+/// False if there may be atoms that aren't in nameAtoms, so two different atoms could contain the same characters
+static bool nameAtomsComplete = true;
+static unsigned int jsvNameAtomsPurge();
+static void jsvNameAtomsRebuild();
+#endif
+#ifdef JSPARSE_MAX_TOKEN_CACHE_LENGTH
+static unsigned int jsvFunctionTokensPurge();
+#endif
+#ifdef JSV_GC_INCREMENTAL_VARS
+typedef enum {
+  GCI_IDLE,  ///< Not collecting
+  GCI_FLAG,  ///< Adding GC flags to all used vars
+  GCI_MARK,  ///< Removing GC flags from anything reachable from a locked var
+  GCI_UNREF, ///< Unreffing anything that is linked from a var that will be freed, but won't be freed itself
+  GCI_SWEEP, ///< Freeing everything that still has a GC flag
+} GCIncrementalState;
+static GCIncrementalState gcIncrementalState = GCI_IDLE;
+static JsVarRef gcIncrementalPos; ///< The next var for jsvGarbageCollectIncremental to look at
+static unsigned int gcIncrementalChangeCount; ///< jsvVarChangeCount at the end of the last jsvGarbageCollectIncremental
+static unsigned int jsvVarChangeCount = 0; ///< Incremented whenever a var is reffed or unreffed
+static JsSysTime gcMaxPause = 0; ///< The longest time the GC has taken since jsvGetGarbageCollectMaxPause
+static bool defragRequested = false; ///< Should jsvDefragmentIncremental move vars?
+#endif
+/* Where jsvDefragmentStep got to, so each step doesn't have to search all of memory.
+ * Every var below defragLowPos was used, and anything left above defragHighPos (0 = the
+ * top of memory) couldn't be moved. A flat string could be allocated over defragLowPos,
+ * which would then be part way through it - so it's reset whenever one is. */
+static JsVarRef defragLowPos = 1, defragHighPos = 0;
+/** reference of first unused variable. Unused variables are in a doubly linked list using
+ * nextSibling and prevSibling, so any of them can be removed from it */
+volatile JsVarRef jsVarFirstEmpty;
+#ifdef JSV_FREE_RUNS
+typedef struct {
+  JsVarRef start;
+  JsVarRef length; ///< 0 if unused
+} JsvFreeRun;
+/** Runs of contiguous unused vars that can be used for flat strings. These may
+ * be out of date (vars in them may since have been allocated), so are checked
+ * before use. */
+static JsvFreeRun jsvFreeRuns[JSV_FREE_RUNS];
+#endif
 volatile MemBusyType isMemoryBusy; ///< Are we doing garbage collection or similar, so can't access memory?
+/** Where the end of the last string we appended to was, so that building up a
+ * string bit by bit doesn't have to walk along the whole string to find the end
+ * each time. Forgotten if either var is freed. */
+static JsVarRef jsvAppendCacheString; ///< the string (0 if nothing cached)
+static JsVarRef jsvAppendCacheTail; ///< its last StringExt
+static size_t jsvAppendCacheIndex; ///< the index in the string of the first character in jsvAppendCacheTail
+
+/// If this var was in the append cache, forget it
+static ALWAYS_INLINE void jsvAppendCacheFree(JsVarRef ref) {
+  if (ref==jsvAppendCacheString || ref==jsvAppendCacheTail)
+    jsvAppendCacheString = 0;
+}
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
@@ -194,27 +260,82 @@ void jsvSetMaxVarsUsed(unsigned int size) {
 }
 
 // maps the empty variables in...
+/// Add an unused var to the end of the free list that is being built, where lastEmpty is the current end
+static ALWAYS_INLINE void jsvFreeListAppend(JsVarRef *lastEmpty, JsVarRef ref) {
+  jsvAppendCacheFree(ref);
+  if (*lastEmpty) jsvSetNextSibling(jsvGetAddressOf(*lastEmpty), ref);
+  else jsVarFirstEmpty = ref;
+  jsvSetPrevSibling(jsvGetAddressOf(ref), *lastEmpty);
+  *lastEmpty = ref;
+}
+
+/// Finish off a free list built with jsvFreeListAppend
+static ALWAYS_INLINE void jsvFreeListEnd(JsVarRef lastEmpty) {
+  if (lastEmpty) jsvSetNextSibling(jsvGetAddressOf(lastEmpty), 0);
+  else jsVarFirstEmpty = 0;
+}
+
+/// Remove an unused var from anywhere in the free list
+static void jsvFreeListRemove(JsVar *var) {
+  JsVarRef prev = jsvGetPrevSibling(var);
+  JsVarRef next = jsvGetNextSibling(var);
+  if (prev) {
+    assert(jsvGetNextSibling(jsvGetAddressOf(prev))==jsvGetRef(var));
+    jsvSetNextSibling(jsvGetAddressOf(prev), next);
+  } else {
+    assert(jsVarFirstEmpty==jsvGetRef(var));
+    jsVarFirstEmpty = next;
+  }
+  if (next) jsvSetPrevSibling(jsvGetAddressOf(next), prev);
+}
+
+#ifdef JSV_FREE_RUNS
+/// Remember a run of contiguous free vars, replacing the smallest we know about if needed
+static void jsvFreeRunsAdd(JsVarRef start, JsVarRef length) {
+  if (length<2) return; // flat strings need at least 2 blocks
+  unsigned int smallest = 0;
+  for (unsigned int i=0;i<JSV_FREE_RUNS;i++) {
+    if (jsvFreeRuns[i].start==start || !jsvFreeRuns[i].length) {
+      smallest = i; // same run, or unused
+      break;
+    }
+    if (jsvFreeRuns[i].length < jsvFreeRuns[smallest].length)
+      smallest = i;
+  }
+  if (jsvFreeRuns[smallest].length && jsvFreeRuns[smallest].start!=start &&
+      jsvFreeRuns[smallest].length >= length)
+    return; // all the ones we have are bigger
+  jsvFreeRuns[smallest].start = start;
+  jsvFreeRuns[smallest].length = length;
+}
+
+/// Forget any runs of free vars we know about
+static void jsvFreeRunsClear() {
+  memset(jsvFreeRuns, 0, sizeof(jsvFreeRuns));
+}
+#endif
+
 void jsvCreateEmptyVarList() {
   assert(!isMemoryBusy);
   isMemoryBusy = MEMBUSY_SYSTEM;
   jsVarFirstEmpty = 0;
-  JsVar firstVar; // temporary var to simplify code in the loop below
-  jsvSetNextSibling(&firstVar, 0);
-  JsVar *lastEmpty = &firstVar;
+  jsvAppendCacheString = 0; // vars may have moved or been loaded
+  JsVarRef lastEmpty = 0;
 
   JsVarRef i;
   for (i=1;i<=jsVarsSize;i++) {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) {
-      jsvSetNextSibling(lastEmpty, i);
-      lastEmpty = var;
+      jsvFreeListAppend(&lastEmpty, i);
     } else if (jsvIsFlatString(var)) {
       // skip over used blocks for flat strings
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
     }
   }
-  jsvSetNextSibling(lastEmpty, 0);
-  jsVarFirstEmpty = jsvGetNextSibling(&firstVar);
+  jsvFreeListEnd(lastEmpty);
+#ifdef JSV_FREE_RUNS
+  jsvFreeRunsClear();
+#endif
   isMemoryBusy = MEM_NOT_BUSY;
 }
 
@@ -225,6 +346,9 @@ void jsvClearEmptyVarList() {
   assert(!isMemoryBusy);
   isMemoryBusy = MEMBUSY_SYSTEM;
   jsVarFirstEmpty = 0;
+#ifdef JSV_FREE_RUNS
+  jsvFreeRunsClear();
+#endif
   JsVarRef i;
   for (i=1;i<=jsVarsSize;i++) {
     JsVar *var = jsvGetAddressOf(i);
@@ -241,6 +365,15 @@ void jsvClearEmptyVarList() {
 
 void jsvSoftInit() {
   jsvCreateEmptyVarList();
+#ifdef JSV_GC_INCREMENTAL_VARS
+  gcIncrementalState = GCI_IDLE; // memory may have been loaded from flash
+  defragRequested = false;
+#endif
+  defragLowPos = 1;
+  defragHighPos = 0;
+#ifdef JSV_NAME_ATOMS
+  jsvNameAtomsRebuild();
+#endif
 }
 
 void jsvSoftKill() {
@@ -257,6 +390,7 @@ static JsVarRef jsvInitJsVars(JsVarRef start, unsigned int count) {
     v->flags = JSV_UNUSED;
     // v->locks = 0; // locks is 0 anyway because it is stored in flags
     jsvSetNextSibling(v, (JsVarRef)(i+1)); // link to next
+    jsvSetPrevSibling(v, (JsVarRef)(i==start ? 0 : i-1));
   }
   jsvSetNextSibling(jsvGetAddressOf((JsVarRef)(start+count-1)), (JsVarRef)0); // set the final one to 0
   return start;
@@ -401,6 +535,19 @@ bool jsvHasStringExt(const JsVar *v) {
   return jsvIsString(v) || jsvIsStringExt(v);
 }
 
+#ifdef JSV_NAME_ATOMS
+/// If this is a name whose characters continue in an atom, return the atom's ref (or 0)
+static ALWAYS_INLINE JsVarRef jsvGetNameAtom(const JsVar *v) {
+  JsVarFlags f = v->flags&JSV_VARTYPEMASK;
+  if (f<JSV_NAME_STRING_INT_0 || f>JSV_NAME_STRING_MAX) return 0;
+  JsVarRef tail = jsvGetLastChild(v);
+  if (!tail) return 0;
+  // A String rather than a StringExt (check for that, as the GC may have freed a StringExt already)
+  f = jsvGetAddressOf(tail)->flags&JSV_VARTYPEMASK;
+  return (f>=_JSV_STRING_START && f<=_JSV_STRING_END) ? tail : 0;
+}
+#endif
+
 bool jsvHasChildren(const JsVar *v) {
   return jsvIsFunction(v) || jsvIsObject(v) || jsvIsArray(v) || jsvIsRoot(v) || jsvIsGetterOrSetter(v);
 }
@@ -502,6 +649,7 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
   if (jsVarFirstEmpty!=0) {
     v = jsvGetAddressOf(jsVarFirstEmpty); // jsvResetVariable will lock
     jsVarFirstEmpty = jsvGetNextSibling(v); // move our reference to the next in the free list
+    if (jsVarFirstEmpty) jsvSetPrevSibling(jsvGetAddressOf(jsVarFirstEmpty), 0);
     touchedFreeList = true;
   }
   jshInterruptOn();
@@ -528,6 +676,16 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
   if (jshIsInInterrupt()) {
     return 0;
   }
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+  jsvNativeFunctionCacheClear(); // these are easy to recreate
+  if (jsVarFirstEmpty) return jsvNewWithFlags(flags); // if that freed something, continue
+#endif
+#ifdef JSV_NAME_ATOMS
+  if (jsvNameAtomsPurge()) return jsvNewWithFlags(flags); // nothing was using these
+#endif
+#ifdef JSPARSE_MAX_TOKEN_CACHE_LENGTH
+  if (jsvFunctionTokensPurge()) return jsvNewWithFlags(flags); // functions still have their source code
+#endif
   /* we don't have memory - second last hope - run garbage collector */
   if (jsvGarbageCollect()) {
     return jsvNewWithFlags(flags); // if it freed something, continue
@@ -549,18 +707,37 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
 #endif
 }
 
-static NO_INLINE void jsvFreePtrInternal(JsVar *var) {
-  assert(jsvGetLocks(var)==0);
+/// Add this block to the free list
+static void jsvAddToFreeList(JsVar *var) {
   var->flags = JSV_UNUSED;
   // add this to our free list
   jshInterruptOff(); // to allow this to be used from an IRQ
+  JsVarRef ref = jsvGetRef(var);
+  jsvAppendCacheFree(ref);
   jsvSetNextSibling(var, jsVarFirstEmpty);
-  jsVarFirstEmpty = jsvGetRef(var);
+  jsvSetPrevSibling(var, 0);
+  if (jsVarFirstEmpty) jsvSetPrevSibling(jsvGetAddressOf(jsVarFirstEmpty), ref);
+  jsVarFirstEmpty = ref;
   touchedFreeList = true;
   jshInterruptOn();
 }
 
+static NO_INLINE void jsvFreePtrInternal(JsVar *var) {
+  assert(jsvGetLocks(var)==0);
+  jsvAddToFreeList(var);
+}
+
+#ifdef JSV_CHILD_INDEXES
+static void jsvChildIndexFree(JsVar *parent);
+#endif
+
 ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
+#ifdef JSV_CHILD_INDEXES
+  jsvChildIndexFree(var);
+#endif
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+  if (jsvIsObject(var)) jsvObjectChangeCount++;
+#endif
   /* To be here, we're not supposed to be part of anything else. If
    * we were, we'd have been freed by jsvGarbageCollect */
   assert((!jsvGetNextSibling(var) && !jsvGetPrevSibling(var)) || // check that next/prevSibling are not set
@@ -589,6 +766,12 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
   if (jsvHasStringExt(var)) {
     // Free the string without recursing
     JsVarRef stringDataRef = jsvGetLastChild(var);
+#ifdef JSV_NAME_ATOMS
+    if (jsvGetNameAtom(var)) { // shared with other names, so just unref it
+      jsvUnRefRef(stringDataRef);
+      stringDataRef = 0;
+    }
+#endif
 #ifdef CLEAR_MEMORY_ON_FREE
     jsvSetLastChild(var, 0);
 #endif // CLEAR_MEMORY_ON_FREE
@@ -615,14 +798,20 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
         insertBefore = jsvGetNextSibling(jsvGetAddressOf(insertBefore));
       }
       // free in reverse, so the free list ends up in kind of the right order
+#ifdef JSV_FREE_RUNS
+      // the header block gets freed at the end of this function
+      jsvFreeRunsAdd((JsVarRef)(i-count), (JsVarRef)(count+1));
+#endif
       while (count--) {
-        JsVar *p = jsvGetAddressOf(i--);
+        JsVar *p = jsvGetAddressOf(i);
         p->flags = JSV_UNUSED; // set locks to 0 so the assert in jsvFreePtrInternal doesn't get fed up
         // add this to our free list
         jsvSetNextSibling(p, insertBefore);
-        insertBefore = jsvGetRef(p);
+        if (insertBefore) jsvSetPrevSibling(jsvGetAddressOf(insertBefore), i);
+        insertBefore = i--;
       }
       // patch up jsVarFirstEmpty/rejoin the list
+      jsvSetPrevSibling(jsvGetAddressOf(insertBefore), insertAfter);
       if (insertAfter)
         jsvSetNextSibling(jsvGetAddressOf(insertAfter), insertBefore);
       else
@@ -782,6 +971,9 @@ JsVar *jsvRef(JsVar *var) {
   assert(var && jsvHasRef(var));
   jsvSetRefs(var, (JsVarRefCounter)(jsvGetRefs(var)+1));
   assert(jsvGetRefs(var));
+#ifdef JSV_GC_INCREMENTAL_VARS
+  jsvVarChangeCount++;
+#endif
   return var;
 }
 
@@ -789,6 +981,9 @@ JsVar *jsvRef(JsVar *var) {
 void jsvUnRef(JsVar *var) {
   assert(var && jsvGetRefs(var)>0 && jsvHasRef(var));
   jsvSetRefs(var, (JsVarRefCounter)(jsvGetRefs(var)-1));
+#ifdef JSV_GC_INCREMENTAL_VARS
+  jsvVarChangeCount++;
+#endif
 }
 
 /// Helper fn, Reference - set this variable as used by something
@@ -813,8 +1008,47 @@ JsVarRef jsvUnRefRef(JsVarRef ref) {
   return 0;
 }
 
-JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
-  bool firstRun = true;
+#ifdef JSV_FREE_RUNS
+/// Is this var unused, and in the free list?
+static bool jsvIsInFreeList(JsVarRef ref) {
+  JsVar *v = jsvGetAddressOf(ref);
+  if (v->flags != JSV_UNUSED) return false;
+  JsVarRef prev = jsvGetPrevSibling(v);
+  if (!prev) return jsVarFirstEmpty==ref;
+  return prev<=jsVarsSize && jsvGetNextSibling(jsvGetAddressOf(prev))==ref;
+}
+
+/** Try and take 'blocks' contiguous vars out of the free list using the runs
+ * in jsvFreeRuns. Returns the ref of the first one, or 0. Call with interrupts off. */
+static JsVarRef jsvFreeRunsAllocate(size_t blocks) {
+  while (true) {
+    // find the smallest run that is big enough
+    JsvFreeRun *run = 0;
+    for (unsigned int i=0;i<JSV_FREE_RUNS;i++)
+      if (jsvFreeRuns[i].length>=blocks && (!run || jsvFreeRuns[i].length<run->length))
+        run = &jsvFreeRuns[i];
+    if (!run) return 0;
+    // check nothing in the run has been allocated since we found it
+    JsVarRef start = run->start;
+    JsVarRef r;
+    for (r=start;r<start+blocks;r++)
+      if (!jsvIsInFreeList(r)) break;
+    if (r<start+blocks) {
+      run->length = 0; // out of date - forget it and try again
+      continue;
+    }
+    for (r=start;r<start+blocks;r++)
+      jsvFreeListRemove(jsvGetAddressOf(r));
+    run->start = (JsVarRef)(run->start+blocks);
+    run->length = (JsVarRef)(run->length-blocks);
+    return start;
+  }
+}
+#endif
+
+/// Create a flat string - if allowGC, GC once if there isn't enough contiguous free memory
+static JsVar *jsvNewFlatStringOfLengthInternal(unsigned int byteLength, bool allowGC) {
+  bool firstRun = allowGC;
   // Work out how many blocks we need. One for the header, plus some for the characters
   size_t requiredBlocks = 1 + ((byteLength+sizeof(JsVar)-1) / sizeof(JsVar));
   JsVar *flatString = 0;
@@ -823,6 +1057,21 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
     return 0;
   }
   while (true) {
+#ifdef JSV_FREE_RUNS
+    // First, see if we know where there's enough space
+    jshInterruptOff();
+    JsVarRef runStart = jsvFreeRunsAllocate(requiredBlocks);
+    if (runStart) {
+      flatString = jsvGetAddressOf(runStart);
+      // Set up the header block (including one lock)
+      jsvResetVariable(flatString, JSV_FLAT_STRING);
+      flatString->varData.integer = (JsVarInt)byteLength;
+    }
+    jshInterruptOn();
+    if (flatString) break;
+    // Otherwise we'll search, and remember the runs we find as we go
+    jsvFreeRunsClear();
+#endif
     /* Now try and find a contiguous set of 'requiredBlocks' blocks by
     searching the free list. This can be done as long as nobody's
     messed with the free list in the mean time (which we check for with
@@ -855,6 +1104,8 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
               } else {
                 jsVarFirstEmpty = nextFree;
               }
+              if (nextFree)
+                jsvSetPrevSibling(jsvGetAddressOf(nextFree),beforeStartBlock);
               flatString = jsvGetAddressOf(startBlock);
               // Set up the header block (including one lock)
               jsvResetVariable(flatString, JSV_FLAT_STRING);
@@ -866,6 +1117,9 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
           }
         } else {
           // this block is not immediately after the last - restart run
+#ifdef JSV_FREE_RUNS
+          jsvFreeRunsAdd(startBlock, (JsVarRef)blockCount);
+#endif
           blockCount = 1;
           beforeStartBlock = curr;
           startBlock = next;
@@ -887,8 +1141,14 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
      * we'll try - but only ONCE */
     firstRun = false;
     jsvGarbageCollect();
+#ifdef JSV_GC_INCREMENTAL_VARS
+    /* If it still fails, vars can't be moved right now as references to
+     * them may be held, but we can defragment when we're next idle */
+    jsvDefragmentRequest();
+#endif
   };
   if (!flatString) return 0;
+  defragLowPos = 1; // it may have been allocated over it
   /* We now have the string! All that's left is to clear it */
   // clear data
   memset((char*)&flatString[1], 0, sizeof(JsVar)*(requiredBlocks-1));
@@ -900,6 +1160,432 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
   return flatString;
 }
 
+JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
+  return jsvNewFlatStringOfLengthInternal(byteLength, true);
+}
+
+#ifdef JSV_CHILD_INDEXES
+/// Does this object/array have an index of its children?
+static ALWAYS_INLINE bool jsvHasChildIndex(const JsVar *v) {
+  JsVarFlags f = v->flags&JSV_VARTYPEMASK;
+  return (f==JSV_OBJECT || f==JSV_ROOT || f==JSV_ARRAY) && jsvGetNextSibling(v);
+}
+
+/// Get the contents of the child index of this object/array, and the number of JsVarRefs in it
+static ALWAYS_INLINE JsVarRef *jsvGetChildIndex(const JsVar *v, unsigned int *length) {
+  JsVar *indexVar = jsvGetAddressOf(jsvGetNextSibling(v));
+  *length = (unsigned int)(jsvGetCharactersInVar(indexVar)/sizeof(JsVarRef));
+  return (JsVarRef*)jsvGetFlatStringPointer(indexVar);
+}
+
+/// Remove this object/array's child index (if it has one)
+static void jsvChildIndexFree(JsVar *parent) {
+  if ((parent->flags&JSV_VARTYPEMASK)==JSV_ARRAY)
+    jsvSetPrevSibling(parent, 0); // the array's changing, so we can try building an index again
+  if (!jsvHasChildIndex(parent)) return;
+  JsVarRef ref = jsvGetNextSibling(parent);
+  jsvSetNextSibling(parent, 0);
+  jsvUnRefRef(ref);
+}
+
+/// Allocate a child index with the given number of (zeroed) JsVarRefs, or return 0
+static JsVar *jsvNewChildIndex(unsigned int length) {
+  // We may be called from the middle of something that isn't expecting a GC, so don't try one
+  if (isMemoryBusy || jshIsInInterrupt()) return 0;
+  return jsvNewFlatStringOfLengthInternal((unsigned int)(length*sizeof(JsVarRef)), false);
+}
+
+/* Objects with lots of children get a hash index of their children's names.
+ * Element 0 is the number of names in the index, and the rest is a
+ * linear-probed hash table of the refs of all children with String names
+ * (int names can't be found by jsvFindChildFromString). */
+
+/// Does this object have a hash index?
+static ALWAYS_INLINE bool jsvHasHashIndex(const JsVar *v) {
+  JsVarFlags f = v->flags&JSV_VARTYPEMASK;
+  return (f==JSV_OBJECT || f==JSV_ROOT) && jsvGetNextSibling(v);
+}
+
+static ALWAYS_INLINE unsigned int jsvHashChar(unsigned int hash, char ch) {
+  return (hash ^ (unsigned char)ch) * 16777619U; // FNV-1a
+}
+
+static unsigned int jsvHashString(const char *str) {
+  unsigned int hash = 2166136261U;
+  while (*str) hash = jsvHashChar(hash, *(str++));
+  return hash;
+}
+
+static unsigned int jsvHashStringVarFrom(JsVar *str, size_t startIdx) {
+  unsigned int hash = 2166136261U;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, startIdx);
+  while (jsvStringIteratorHasChar(&it))
+    hash = jsvHashChar(hash, jsvStringIteratorGetCharAndNext(&it));
+  jsvStringIteratorFree(&it);
+  return hash;
+}
+
+static unsigned int jsvHashStringVar(JsVar *str) {
+  return jsvHashStringVarFrom(str, 0);
+}
+
+/// Get a pointer to the hash index of this object (or 0). mask is set to the number of hash table slots-1
+static JsVarRef *jsvGetHashIndex(JsVar *parent, unsigned int *mask) {
+  if (!jsvHasHashIndex(parent)) return 0;
+  JsVarRef *index = jsvGetChildIndex(parent, mask);
+  *mask -= 2;
+  return index;
+}
+
+static void jsvHashIndexInsert(JsVarRef *index, unsigned int mask, unsigned int hash, JsVarRef ref) {
+  unsigned int i = hash & mask;
+  while (index[1+i]) i = (i+1) & mask;
+  index[1+i] = ref;
+  index[0]++;
+}
+
+/// Remove the entry in slot i of a hash index
+static void jsvHashIndexDelete(JsVarRef *index, unsigned int mask, unsigned int i) {
+  index[0]--;
+  /* Remove the entry, then move back any following entries that had
+   * been pushed past this slot, so there are no gaps in their probe sequence */
+  unsigned int j = i;
+  while (true) {
+    index[1+i] = 0;
+    unsigned int k;
+    do {
+      j = (j+1) & mask;
+      if (!index[1+j]) return;
+      k = jsvHashStringVar(jsvGetAddressOf(index[1+j])) & mask;
+      // entry at j must stay if its home slot k is cyclically in (i,j]
+    } while ((i<=j) ? (i<k && k<=j) : (i<k || k<=j));
+    index[1+i] = index[1+j];
+    i = j;
+  }
+}
+
+/// (Re)build the hash index for this object. If we can't get the memory, we just don't have one.
+static void jsvHashIndexBuild(JsVar *parent) {
+  jsvChildIndexFree(parent);
+  unsigned int count = 0;
+  JsVarRef childref = jsvGetFirstChild(parent);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsString(child)) count++;
+    childref = jsvGetNextSibling(child);
+  }
+  // keep the table at most half full, with room to grow
+  unsigned int size = 32;
+  while (size < count*4) size <<= 1;
+  JsVar *indexVar = jsvNewChildIndex(size+1);
+  if (!indexVar) return;
+  JsVarRef *index = (JsVarRef*)jsvGetFlatStringPointer(indexVar); // already zeroed
+  childref = jsvGetFirstChild(parent);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsString(child))
+      jsvHashIndexInsert(index, size-1, jsvHashStringVar(child), childref);
+    childref = jsvGetNextSibling(child);
+  }
+  jsvSetNextSibling(parent, jsvGetRef(jsvRef(indexVar)));
+  jsvUnLock(indexVar);
+}
+
+/// Called when a name has just been added to this object
+static void jsvHashIndexAdd(JsVar *parent, JsVar *namedChild) {
+  unsigned int mask;
+  JsVarRef *index = jsvGetHashIndex(parent, &mask);
+  if (index) {
+    if (!jsvIsString(namedChild)) return;
+    if ((index[0]+1)*2 > mask+1) // too full - make a bigger one (which includes namedChild)
+      jsvHashIndexBuild(parent);
+    else
+      jsvHashIndexInsert(index, mask, jsvHashStringVar(namedChild), jsvGetRef(namedChild));
+  } else if (jsvIsObject(parent)) {
+    // Once we have enough children, make an index
+    JsVarRef childref = jsvGetLastChild(parent);
+    int count = 0;
+    while (childref && count<JSV_HASH_INDEX_THRESHOLD) {
+      count++;
+      childref = jsvGetPrevSibling(jsvGetAddressOf(childref));
+    }
+    if (count>=JSV_HASH_INDEX_THRESHOLD)
+      jsvHashIndexBuild(parent);
+  }
+}
+
+/// Called when a name is about to be removed from this object
+static void jsvHashIndexRemove(JsVar *parent, JsVar *child) {
+  unsigned int mask;
+  JsVarRef *index = jsvGetHashIndex(parent, &mask);
+  if (!index || !jsvIsString(child)) return;
+  JsVarRef ref = jsvGetRef(child);
+  unsigned int i = jsvHashStringVar(child) & mask;
+  while (index[1+i] && index[1+i]!=ref) i = (i+1) & mask;
+  if (!index[1+i]) return; // not in the index
+  jsvHashIndexDelete(index, mask, i);
+}
+
+/* Arrays whose int keys are exactly 0..length-1 can have an index of their
+ * elements. Element 0 is the number of elements, and element 1+i is the ref of
+ * the name for arr[i] (String keys aren't indexed). Keys can get renumbered in
+ * place (eg. Array.reverse/splice), so lookups check the key of what they find,
+ * and drop the index if it's wrong. */
+
+/// Does this array have an index?
+static ALWAYS_INLINE bool jsvHasArrayIndex(const JsVar *v) {
+  return (v->flags&JSV_VARTYPEMASK)==JSV_ARRAY && jsvGetNextSibling(v);
+}
+
+/** If we couldn't build an index, the array's prevSibling (unused otherwise) is
+ * set so we don't try again every time it's read. It's cleared when the array
+ * changes (see jsvChildIndexFree) */
+static ALWAYS_INLINE bool jsvArrayIndexFailed(const JsVar *v) {
+  return (v->flags&JSV_VARTYPEMASK)==JSV_ARRAY && jsvGetPrevSibling(v);
+}
+
+/// (Re)build the index for this array if it has no missing elements. Return true on success
+static bool jsvArrayIndexBuild(JsVar *arr) {
+  jsvChildIndexFree(arr);
+  JsVarInt length = jsvGetArrayLength(arr);
+  if (length<JSV_ARRAY_INDEX_THRESHOLD) return false;
+  jsvSetPrevSibling(arr, 1); // in case we fail
+  JsVarInt count = 0;
+  JsVarRef childref = jsvGetFirstChild(arr);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsInt(child)) {
+      if (child->varData.integer != count) return false; // sparse
+      count++;
+    }
+    childref = jsvGetNextSibling(child);
+  }
+  if (count != length) return false;
+  // leave some space for pushes
+  unsigned int size = (unsigned int)count + (unsigned int)count/2;
+  JsVar *indexVar = jsvNewChildIndex(size+1);
+  if (!indexVar) return false;
+  jsvSetPrevSibling(arr, 0);
+  JsVarRef *index = (JsVarRef*)jsvGetFlatStringPointer(indexVar);
+  index[0] = (JsVarRef)count;
+  count = 0;
+  childref = jsvGetFirstChild(arr);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsInt(child)) index[1+(count++)] = childref;
+    childref = jsvGetNextSibling(child);
+  }
+  jsvSetNextSibling(arr, jsvGetRef(jsvRef(indexVar)));
+  jsvUnLock(indexVar);
+  return true;
+}
+
+/** Look up arr[idx] using the array's index (building one if we can). Returns false
+ * if there's no usable index and the array has to be searched, or true with
+ * the name (locked) or 0 in *result. */
+static bool jsvArrayIndexFind(JsVar *arr, JsVarInt idx, JsVar **result) {
+  if ((arr->flags&JSV_VARTYPEMASK)!=JSV_ARRAY) return false;
+  if (!jsvGetNextSibling(arr) && (jsvArrayIndexFailed(arr) || !jsvArrayIndexBuild(arr))) return false;
+  unsigned int length;
+  JsVarRef *index = jsvGetChildIndex(arr, &length);
+  JsVarInt count = (JsVarInt)index[0];
+  if (count == jsvGetArrayLength(arr)) {
+    if (idx<0 || idx>=count) {
+      *result = 0;
+      return true;
+    }
+    JsVar *child = jsvGetAddressOf(index[1+idx]);
+    if (jsvIsInt(child) && child->varData.integer==idx) {
+      *result = jsvLockAgain(child);
+      return true;
+    }
+  }
+  // keys must have been renumbered
+  jsvChildIndexFree(arr);
+  return false;
+}
+
+/// Called when a name has just been added to this array
+static void jsvArrayIndexAdd(JsVar *arr, JsVar *namedChild) {
+  if (!jsvIsInt(namedChild)) return;
+  unsigned int length;
+  JsVarRef *index = jsvGetChildIndex(arr, &length);
+  if (namedChild->varData.integer != (JsVarInt)index[0]) {
+    jsvChildIndexFree(arr); // not added to the end - now sparse
+  } else if (index[0]+1 < length) {
+    index[1+index[0]] = jsvGetRef(namedChild);
+    index[0]++;
+  } else // full - make a bigger one (which includes namedChild)
+    jsvArrayIndexBuild(arr);
+}
+
+/// Called when a name is about to be removed from this array
+static void jsvArrayIndexRemove(JsVar *arr, JsVar *child) {
+  if (!jsvIsInt(child)) return;
+  unsigned int length;
+  JsVarRef *index = jsvGetChildIndex(arr, &length);
+  if (index[0] && index[index[0]]==jsvGetRef(child))
+    index[0]--; // removed from the end
+  else
+    jsvChildIndexFree(arr);
+}
+#endif
+
+#ifdef JSV_NAME_ATOMS
+/* Names longer than JSVAR_DATA_STRING_NAME_LEN characters would need StringExts
+ * of their own for the rest of their characters. Instead, they reference an
+ * 'atom' from lastChild - a String containing the rest of the characters,
+ * shared by every name that ends the same way. Each name reffs its atom, and
+ * nameAtoms (a linear-probed hash table like an object's hash index) holds a
+ * lock on each atom so it can be found again. Atoms that no names use any more
+ * are dropped from nameAtoms when memory is low. While every atom is in
+ * nameAtoms, atoms are unique - so names with different atoms are different. */
+
+/// Get the hash table of atoms (or 0). mask is set to the number of hash table slots-1
+static JsVarRef *jsvNameAtomsGet(unsigned int *mask) {
+  if (!nameAtoms) return 0;
+  *mask = (unsigned int)(jsvGetCharactersInVar(nameAtoms)/sizeof(JsVarRef)) - 2;
+  return (JsVarRef*)jsvGetFlatStringPointer(nameAtoms);
+}
+
+/// Find the atom containing the characters of str from startIdx onwards, or return 0
+static JsVarRef jsvNameAtomFindVar(JsVar *str, size_t startIdx) {
+  unsigned int mask;
+  JsVarRef *table = jsvNameAtomsGet(&mask);
+  if (!table) return 0;
+  unsigned int i = jsvHashStringVarFrom(str, startIdx) & mask;
+  while (table[1+i]) {
+    if (jsvCompareString(jsvGetAddressOf(table[1+i]), str, 0, startIdx, false)==0)
+      return table[1+i];
+    i = (i+1) & mask;
+  }
+  return 0;
+}
+
+/// Return the atom that a name containing str would have, or 0 if there isn't one
+static JsVarRef jsvNameAtomFindString(const char *str) {
+  unsigned int mask;
+  JsVarRef *table = jsvNameAtomsGet(&mask);
+  if (!table) return 0;
+  for (size_t l=0;l<JSVAR_DATA_STRING_NAME_LEN;l++)
+    if (!str[l]) return 0; // short enough to fit in the name
+  str += JSVAR_DATA_STRING_NAME_LEN;
+  if (!*str) return 0;
+  unsigned int i = jsvHashString(str) & mask;
+  while (table[1+i]) {
+    if (jsvIsStringEqual(jsvGetAddressOf(table[1+i]), str))
+      return table[1+i];
+    i = (i+1) & mask;
+  }
+  return 0;
+}
+
+/** Remove any atoms that aren't used by a name (or anything else) any more,
+ * freeing them. Returns the number removed */
+static unsigned int jsvNameAtomsPurge() {
+  unsigned int mask;
+  JsVarRef *table = jsvNameAtomsGet(&mask);
+  if (!table) return 0;
+  unsigned int removed = 0;
+  unsigned int i = 0;
+  while (i<=mask) {
+    JsVar *atom = table[1+i] ? jsvGetAddressOf(table[1+i]) : 0;
+    if (atom && !jsvGetRefs(atom) && jsvGetLocks(atom)==1) {
+      jsvHashIndexDelete(table, mask, i); // this may move a later atom into slot i, so check i again
+      jsvUnLock(atom); // frees it
+      removed++;
+    } else i++;
+  }
+  return removed;
+}
+
+/// Make sure there's space in nameAtoms to add an atom. Returns false if there isn't
+static bool jsvNameAtomsMakeRoom() {
+  unsigned int mask;
+  JsVarRef *table = jsvNameAtomsGet(&mask);
+  // keep the table at most half full
+  if (table && (table[0]+1)*2 <= mask+1) return true;
+  if (table && jsvNameAtomsPurge() && (table[0]+1)*2 <= mask+1) return true;
+  // We may be called from the middle of something that isn't expecting a GC, so don't try one
+  if (isMemoryBusy || jshIsInInterrupt()) return false;
+  unsigned int size = table ? (mask+1)*2 : 32;
+  JsVar *newTable = jsvNewFlatStringOfLengthInternal((unsigned int)((size+1)*sizeof(JsVarRef)), false);
+  if (!newTable) return false;
+  JsVarRef *newIndex = (JsVarRef*)jsvGetFlatStringPointer(newTable); // already zeroed
+  table = jsvNameAtomsGet(&mask);
+  if (table) {
+    for (unsigned int i=0;i<=mask;i++)
+      if (table[1+i])
+        jsvHashIndexInsert(newIndex, size-1, jsvHashStringVar(jsvGetAddressOf(table[1+i])), table[1+i]);
+    jsvUnLock(nameAtoms);
+  }
+  nameAtoms = newTable; // keep the lock
+  return true;
+}
+
+/// Add an atom to nameAtoms, which must have room for it. nameAtoms takes the lock
+static void jsvNameAtomsAdd(JsVar *atom) {
+  unsigned int mask;
+  JsVarRef *table = jsvNameAtomsGet(&mask);
+  jsvHashIndexInsert(table, mask, jsvHashStringVar(atom), jsvGetRef(atom));
+}
+
+/** Return the atom (locked, but not reffed) for the characters of str from
+ * startIdx onwards, creating it if there isn't one. Returns 0 if there's no
+ * atom and we can't make one, in which case the name needs its own StringExts */
+static JsVar *jsvNameAtomGet(JsVar *str, size_t startIdx) {
+  if (!nameAtomsComplete) return 0; // we might make a copy of an atom we don't know about
+  JsVarRef ref = jsvNameAtomFindVar(str, startIdx);
+  if (ref) return jsvLock(ref);
+  if (!jsvNameAtomsMakeRoom()) return 0;
+  JsVar *atom = jsvNewFromStringVar(str, startIdx, JSVAPPENDSTRINGVAR_MAXLENGTH);
+  if (!atom) return 0;
+  jsvNameAtomsAdd(atom);
+  return jsvLockAgain(atom);
+}
+
+/** Unlock every atom and remove nameAtoms. Atoms that names still use are
+ * left as they are, but as they're no longer in nameAtoms they can't be
+ * assumed to be unique (until jsvNameAtomsRebuild). */
+void jsvNameAtomsClear() {
+  unsigned int mask;
+  JsVarRef *table = jsvNameAtomsGet(&mask);
+  if (!table) return;
+  for (unsigned int i=0;i<=mask;i++) {
+    if (!table[1+i]) continue;
+    JsVar *atom = jsvGetAddressOf(table[1+i]);
+    if (jsvGetRefs(atom)) nameAtomsComplete = false;
+    jsvUnLock(atom);
+  }
+  jsvUnLock(nameAtoms);
+  nameAtoms = 0;
+}
+
+/// Put every atom used by a name back into nameAtoms - eg. after memory has been loaded from flash
+static void jsvNameAtomsRebuild() {
+  nameAtoms = 0; // any old table went with the old contents of memory
+  nameAtomsComplete = true;
+  for (JsVarRef i=1;i<=jsVarsSize;i++) {
+    JsVar *v = jsvGetAddressOf(i);
+    if (jsvIsFlatString(v)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip the string's data
+      continue;
+    }
+    JsVarRef ref = jsvGetNameAtom(v);
+    if (!ref) continue;
+    JsVar *atom = jsvGetAddressOf(ref);
+    JsVarRef found = jsvNameAtomFindVar(atom, 0);
+    if (found==ref) continue; // already added for another name
+    if (found || !jsvNameAtomsMakeRoom()) {
+      nameAtomsComplete = false; // a copy of an atom, or one we couldn't add
+      continue;
+    }
+    jsvNameAtomsAdd(jsvLockAgain(atom));
+  }
+}
+#endif
+
 JsVar *jsvNewFromString(const char *str) {
   // Create a var
   JsVar *first = jsvNewWithFlags(JSV_STRING_0);
@@ -1041,6 +1727,52 @@ JsVar *jsvNewNativeFunction(void (*ptr)(void), unsigned short argTypes) {
   return func;
 }
 
+JsVar *jsvNewNativeFunctionShared(void (*ptr)(void), unsigned short argTypes) {
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+  JsVarRef *entry = &jsvNativeFunctionCache[(((size_t)ptr>>2) ^ argTypes) & (JSV_NATIVE_FUNCTION_CACHE_SIZE-1)];
+  if (*entry) {
+    JsVar *func = jsvGetAddressOf(*entry);
+    // Only reuse it if it's still exactly what jsvNewNativeFunction would give us
+    if (jsvIsNativeFunction(func) && func->varData.native.ptr==ptr &&
+        func->varData.native.argTypes==argTypes && !jsvGetFirstChild(func)) {
+      /* Only hand it out if nothing else has it, so two references are never
+       * the same var (and changing one can't affect the other). If it's just
+       * locked (eg. it's being called) make a new one but keep this one cached */
+      if (jsvGetRefs(func)==1) {
+        if (!jsvGetLocks(func))
+          return jsvLock(*entry);
+        return jsvNewNativeFunction(ptr, argTypes);
+      }
+    }
+    // it's been stored somewhere (or changed), so it's not ours any more
+    jsvNativeFunctionCacheRelease(entry);
+  }
+  JsVar *func = jsvNewNativeFunction(ptr, argTypes);
+  if (func) *entry = jsvGetRef(jsvRef(func));
+  return func;
+#else
+  return jsvNewNativeFunction(ptr, argTypes);
+#endif
+}
+
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+/// Remove a function from the cache, freeing it if nothing else uses it
+static void jsvNativeFunctionCacheRelease(JsVarRef *entry) {
+  JsVar *func = jsvGetAddressOf(*entry);
+  *entry = 0;
+  jsvUnRef(func);
+  if (jsvGetLocks(func)==0 && jsvGetRefs(func)==0)
+    jsvFreePtr(func);
+}
+
+void jsvNativeFunctionCacheClear() {
+  unsigned int i;
+  for (i=0;i<JSV_NATIVE_FUNCTION_CACHE_SIZE;i++)
+    if (jsvNativeFunctionCache[i])
+      jsvNativeFunctionCacheRelease(&jsvNativeFunctionCache[i]);
+}
+#endif
+
 JsVar *jsvNewNativeString(char *ptr, size_t len) {
   if (len>JSV_NATIVE_STR_MAX_LENGTH) len=JSV_NATIVE_STR_MAX_LENGTH; // crop string to what we can store in nativeStr.len
   JsVar *str = jsvNewWithFlags(JSV_NATIVE_STRING);
@@ -1092,30 +1824,38 @@ JsVar *jsvMakeIntoVariableName(JsVar *var, JsVar *valueOrZero) {
   } else if (varType>=_JSV_STRING_START && varType<=_JSV_STRING_END) {
     if (jsvGetCharactersInVar(var) > JSVAR_DATA_STRING_NAME_LEN) {
       /* Argh. String is too large to fit in a JSV_NAME! We must chomp make
-       * new STRINGEXTs to put the data in
+       * new STRINGEXTs to put the data in - or share an atom with other names
        */
-      JsvStringIterator it;
-      jsvStringIteratorNew(&it, var, JSVAR_DATA_STRING_NAME_LEN);
-      JsVar *startExt = jsvNewWithFlags(JSV_STRING_EXT_0);
-      JsVar *ext = jsvLockAgainSafe(startExt);
-      size_t nChars = 0;
-      while (ext && jsvStringIteratorHasChar(&it)) {
-        if (nChars >= JSVAR_DATA_STRING_MAX_LEN) {
-          jsvSetCharactersInVar(ext, nChars);
-          JsVar *ext2 = jsvNewWithFlags(JSV_STRING_EXT_0);
-          if (ext2) {
-            jsvSetLastChild(ext, jsvGetRef(ext2));
+      JsVar *startExt = 0;
+#ifdef JSV_NAME_ATOMS
+      startExt = jsvNameAtomGet(var, JSVAR_DATA_STRING_NAME_LEN);
+      if (startExt) jsvRef(startExt);
+      else
+#endif
+      {
+        JsvStringIterator it;
+        jsvStringIteratorNew(&it, var, JSVAR_DATA_STRING_NAME_LEN);
+        startExt = jsvNewWithFlags(JSV_STRING_EXT_0);
+        JsVar *ext = jsvLockAgainSafe(startExt);
+        size_t nChars = 0;
+        while (ext && jsvStringIteratorHasChar(&it)) {
+          if (nChars >= JSVAR_DATA_STRING_MAX_LEN) {
+            jsvSetCharactersInVar(ext, nChars);
+            JsVar *ext2 = jsvNewWithFlags(JSV_STRING_EXT_0);
+            if (ext2) {
+              jsvSetLastChild(ext, jsvGetRef(ext2));
+            }
+            jsvUnLock(ext);
+            ext = ext2;
+            nChars = 0;
           }
+          ext->varData.str[nChars++] = jsvStringIteratorGetCharAndNext(&it);
+        }
+        jsvStringIteratorFree(&it);
+        if (ext) {
+          jsvSetCharactersInVar(ext, nChars);
           jsvUnLock(ext);
-          ext = ext2;
-          nChars = 0;
         }
-        ext->varData.str[nChars++] = jsvStringIteratorGetCharAndNext(&it);
-      }
-      jsvStringIteratorFree(&it);
-      if (ext) {
-        jsvSetCharactersInVar(ext, nChars);
-        jsvUnLock(ext);
       }
       jsvSetCharactersInVar(var, JSVAR_DATA_STRING_NAME_LEN);
       // Free any old stringexts
@@ -1184,6 +1924,23 @@ void *jsvGetNativeFunctionPtr(const JsVar *function) {
 }
 
 
+/** If all of a string or name's characters are stored together (it fits in one
+ * var, or is a flat string), return a pointer to them and set len. Otherwise return 0.
+ * Most names are short, so this lets us compare them without a string iterator. */
+static ALWAYS_INLINE const char *jsvGetContiguousStringData(JsVar *v, size_t *len) {
+  unsigned int f = v->flags&JSV_VARTYPEMASK;
+  if (f>=JSV_NAME_STRING_INT_0 && f<=JSV_STRING_MAX) {
+    if (jsvGetLastChild(v)) return 0; // has StringExts
+    *len = jsvGetCharactersInVar(v);
+    return v->varData.str;
+  }
+  if (f==JSV_FLAT_STRING) {
+    *len = jsvGetCharactersInVar(v);
+    return jsvGetFlatStringPointer(v);
+  }
+  return 0;
+}
+
 bool jsvIsBasicVarEqual(JsVar *a, JsVar *b) {
   // quick checks
   if (a==b) return true;
@@ -1208,6 +1965,23 @@ bool jsvIsBasicVarEqual(JsVar *a, JsVar *b) {
       }
     }
   } else if (jsvIsString(a) && jsvIsString(b)) {
+#ifdef JSV_NAME_ATOMS
+    JsVarRef atomA = jsvGetNameAtom(a), atomB = jsvGetNameAtom(b);
+    if (atomA && atomB && (atomA==atomB || nameAtomsComplete)) // atoms are unique, so just check the start
+      return atomA==atomB && memcmp(a->varData.str, b->varData.str, JSVAR_DATA_STRING_NAME_LEN)==0;
+#endif
+    size_t lena, lenb;
+    const char *da = jsvGetContiguousStringData(a, &lena);
+    const char *db = jsvGetContiguousStringData(b, &lenb);
+    if (da && db) {
+      // same as below, but without the iterators
+      for (size_t i=0;;i++) {
+        char ca = i<lena ? da[i] : 0;
+        char cb = i<lenb ? db[i] : 0;
+        if (ca != cb) return false;
+        if (!ca) return true; // equal, but end of string
+      }
+    }
     JsvStringIterator ita, itb;
     jsvStringIteratorNew(&ita, a, 0);
     jsvStringIteratorNew(&itb, b, 0);
@@ -1635,52 +2409,55 @@ size_t jsvGetIndexFromLineAndCol(JsVar *v, size_t line, size_t col) {
   return n;
 }
 
+/// Start appending to a string. Like jsvStringIteratorNew+jsvStringIteratorGotoEnd, but fast if we appended to this string last time
+static void jsvAppendStart(JsvStringIterator *it, JsVar *var) {
+  if (jsvAppendCacheString && jsvAppendCacheString==jsvGetRef(var)) {
+    it->var = jsvLock(jsvAppendCacheTail);
+    it->varIndex = jsvAppendCacheIndex;
+    it->charsInVar = jsvGetCharactersInVar(it->var);
+  } else
+    jsvStringIteratorNew(it, var, 0);
+  jsvStringIteratorGotoEnd(it); // in case something else appended since
+}
+
+/// Finish appending to a string, remembering where the end is for next time
+static void jsvAppendEnd(JsvStringIterator *it, JsVar *var) {
+  if (it->var && it->var!=var && jsvIsBasicString(var)) {
+    jsvAppendCacheString = jsvGetRef(var);
+    jsvAppendCacheTail = jsvGetRef(it->var);
+    jsvAppendCacheIndex = it->varIndex;
+  }
+  jsvStringIteratorFree(it);
+}
+
 void jsvAppendString(JsVar *var, const char *str) {
-  assert(jsvIsString(var));
-  JsvStringIterator dst;
-  jsvStringIteratorNew(&dst, var, 0);
-  jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-   * and is less likely to break :) */
-  while (*str)
-    jsvStringIteratorAppend(&dst, *(str++));
-  jsvStringIteratorFree(&dst);
+  jsvAppendStringBuf(var, str, strlen(str));
 }
 
 // Append the given string to this one - but does not use null-terminated strings
 void jsvAppendStringBuf(JsVar *var, const char *str, size_t length) {
   assert(jsvIsString(var));
   JsvStringIterator dst;
-  jsvStringIteratorNew(&dst, var, 0);
-  jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-   * and is less likely to break :) */
-  while (length) {
-    jsvStringIteratorAppend(&dst, *(str++));
-    length--;
-  }
-  jsvStringIteratorFree(&dst);
+  jsvAppendStart(&dst, var);
+  jsvStringIteratorAppendBuf(&dst, str, length);
+  jsvAppendEnd(&dst, var);
 }
 
 /// Special version of append designed for use with vcbprintf_callback (See jsvAppendPrintf)
 void jsvStringIteratorPrintfCallback(const char *str, void *user_data) {
-  while (*str)
-    jsvStringIteratorAppend((JsvStringIterator *)user_data, *(str++));
+  jsvStringIteratorAppendBuf((JsvStringIterator *)user_data, str, strlen(str));
 }
 
 void jsvAppendPrintf(JsVar *var, const char *fmt, ...) {
   JsvStringIterator it;
-  jsvStringIteratorNew(&it, var, 0);
-  jsvStringIteratorGotoEnd(&it);
+  jsvAppendStart(&it, var);
 
   va_list argp;
   va_start(argp, fmt);
   vcbprintf((vcbprintf_callback)jsvStringIteratorPrintfCallback,&it, fmt, argp);
   va_end(argp);
 
-  jsvStringIteratorFree(&it);
+  jsvAppendEnd(&it, var);
 }
 
 JsVar *jsvVarPrintf( const char *fmt, ...) {
@@ -1704,19 +2481,26 @@ void jsvAppendStringVar(JsVar *var, const JsVar *str, size_t stridx, size_t maxL
   assert(jsvIsString(var));
 
   JsvStringIterator dst;
-  jsvStringIteratorNew(&dst, var, 0);
-  jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-     * and is less likely to break :) */
+  jsvAppendStart(&dst, var);
   JsvStringIterator it;
   jsvStringIteratorNewConst(&it, str, stridx);
-  while (jsvStringIteratorHasChar(&it) && (maxLength-->0)) {
-    char ch = jsvStringIteratorGetCharAndNext(&it);
-    jsvStringIteratorAppend(&dst, ch);
+  // Native/flash strings may need special code to read them, but otherwise we can copy a block at a time
+  bool canCopyBlocks = !jsvIsNativeString(str) && !jsvIsFlashString(str);
+  while (jsvStringIteratorHasChar(&it) && maxLength>0) {
+    if (canCopyBlocks) {
+      size_t len = it.charsInVar - it.charIdx;
+      if (len > maxLength) len = maxLength;
+      jsvStringIteratorAppendBuf(&dst, &it.ptr[it.charIdx], len);
+      maxLength -= len;
+      it.charIdx += len-1; // jsvStringIteratorNext moves on the last one
+      jsvStringIteratorNext(&it);
+    } else {
+      jsvStringIteratorAppend(&dst, jsvStringIteratorGetCharAndNext(&it));
+      maxLength--;
+    }
   }
   jsvStringIteratorFree(&it);
-  jsvStringIteratorFree(&dst);
+  jsvAppendEnd(&dst, var);
 }
 
 /** Create a new variable from a substring. argument must be a string. stridx = start char or str, maxLength = max number of characters (can be JSVAPPENDSTRINGVAR_MAXLENGTH) */
@@ -2268,6 +3052,26 @@ bool jsvIsStringEqualOrStartsWithOffset(JsVar *var, const char *str, bool isStar
     return 0; // not a string so not equal!
   }
 
+  size_t len;
+  const char *data = jsvGetContiguousStringData(var, &len);
+  if (data) {
+    // same as below, but without the iterator
+    size_t i = startIdx;
+    if (ignoreCase) {
+      while (i<len && *str && jsvStringCharToLower(data[i]) == jsvStringCharToLower(*str)) {
+        str++;
+        i++;
+      }
+    } else {
+      while (i<len && *str && data[i] == *str) {
+        str++;
+        i++;
+      }
+    }
+    return (isStartsWith && !*str) ||
+           (i<len ? data[i] : 0)==*str; // should both be 0 if equal
+  }
+
   JsvStringIterator it;
   jsvStringIteratorNew(&it, var, startIdx);
   if (ignoreCase) {
@@ -2417,6 +3221,11 @@ JsVar *jsvCopyNameOnly(JsVar *src, bool linkChildren, bool keepAsName) {
       // If it had extra string data it should have been handled above
       assert(keepAsName || !jsvGetLastChild(src));
       // copy extra bits of string if there were any
+#ifdef JSV_NAME_ATOMS
+      if (jsvGetNameAtom(src)) {
+        jsvSetLastChild(dst, jsvRefRef(jsvGetLastChild(src))); // the atom is shared
+      } else
+#endif
       if (jsvGetLastChild(src)) {
         JsVar *child = jsvLock(jsvGetLastChild(src));
         JsVar *childCopy = jsvCopy(child, true);
@@ -2484,6 +3293,11 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
     }
   }
 
+#ifdef JSV_NAME_ATOMS
+  if (jsvGetNameAtom(src)) {
+    jsvSetLastChild(dst, jsvRefRef(jsvGetLastChild(src))); // the atom is shared
+  } else
+#endif
   if (jsvHasStringExt(src)) {
     // copy extra bits of string if there were any
     src = jsvLockAgain(src);
@@ -2536,6 +3350,10 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
 void jsvAddName(JsVar *parent, JsVar *namedChild) {
   namedChild = jsvRef(namedChild); // ref here VERY important as adding to structure!
   assert(jsvIsName(namedChild));
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+  // New objects (eg. object literals) can't be scopes yet, so don't count them
+  if (!jsvIsArray(parent) && jsvGetRefs(parent)) jsvObjectAddCount++;
+#endif
 
   // update array length
   if (jsvIsArray(parent) && jsvIsInt(namedChild)) {
@@ -2585,6 +3403,11 @@ void jsvAddName(JsVar *parent, JsVar *namedChild) {
     jsvSetFirstChild(parent, r);
     jsvSetLastChild(parent, r);
   }
+#ifdef JSV_CHILD_INDEXES
+  if (jsvHasArrayIndex(parent)) jsvArrayIndexAdd(parent, namedChild);
+  else if (jsvArrayIndexFailed(parent)) jsvChildIndexFree(parent);
+  else jsvHashIndexAdd(parent, namedChild);
+#endif
 }
 
 JsVar *jsvAddNamedChild(JsVar *parent, JsVar *child, const char *name) {
@@ -2643,6 +3466,19 @@ JsVar *jsvSetValueOfName(JsVar *name, JsVar *src) {
   return name;
 }
 
+/** Is child (whose first 4 characters match) called name? atom is the atom
+ * that a name containing name would have (if long names have atoms) */
+static ALWAYS_INLINE bool jsvIsChildNamed(JsVar *child, const char *name, JsVarRef atom) {
+#ifdef JSV_NAME_ATOMS
+  JsVarRef childAtom = jsvGetNameAtom(child);
+  if (childAtom && nameAtomsComplete) // atoms are unique, so just check the start
+    return childAtom==atom && memcmp(child->varData.str, name, JSVAR_DATA_STRING_NAME_LEN)==0;
+#else
+  NOT_USED(atom);
+#endif
+  return jsvIsStringEqual(child, name);
+}
+
 JsVar *jsvFindChildFromString(JsVar *parent, const char *name, bool addIfNotFound) {
   /* Pull out first 4 bytes, and ensure that everything
    * is 0 padded so that we can do a nice speedy check. */
@@ -2667,14 +3503,35 @@ JsVar *jsvFindChildFromString(JsVar *parent, const char *name, bool addIfNotFoun
     fastCheck[3] = 0;
   }
 
+#ifdef JSV_NAME_ATOMS
+  JsVarRef atom = jsvNameAtomFindString(name);
+#else
+  JsVarRef atom = 0;
+#endif
+
   assert(jsvHasChildren(parent));
   JsVarRef childref = jsvGetFirstChild(parent);
+#ifdef JSV_CHILD_INDEXES
+  unsigned int mask;
+  JsVarRef *index = jsvGetHashIndex(parent, &mask);
+  if (index) {
+    unsigned int i = jsvHashString(name) & mask;
+    while (index[1+i]) {
+      JsVar *child = jsvGetAddressOf(index[1+i]);
+      if (*(int*)fastCheck==*(int*)child->varData.str &&
+          jsvIsChildNamed(child, name, atom))
+        return jsvLockAgain(child);
+      i = (i+1) & mask;
+    }
+    childref = 0; // not in the index, so not in the object
+  }
+#endif
   while (childref) {
     // Don't Lock here, just use GetAddressOf - to try and speed up the finding
     // TODO: We can do this now, but when/if we move to cacheing vars, it'll break
     JsVar *child = jsvGetAddressOf(childref);
     if (*(int*)fastCheck==*(int*)child->varData.str && // speedy check of first 4 bytes
-        jsvIsStringEqual(child, name)) {
+        jsvIsChildNamed(child, name, atom)) {
       // found it! unlock parent but leave child locked
       return jsvLockAgain(child);
     }
@@ -2741,6 +3598,24 @@ JsVar *jsvAsName(JsVar *var) {
 JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound) {
   JsVar *child;
   JsVarRef childref = jsvGetFirstChild(parent);
+#ifdef JSV_CHILD_INDEXES
+  if (jsvIsInt(childName) && jsvArrayIndexFind(parent, childName->varData.integer, &child)) {
+    if (child || !addIfNotFound) return child;
+    childref = 0; // not in the index, so not in the array
+  }
+  unsigned int mask;
+  JsVarRef *index = jsvGetHashIndex(parent, &mask);
+  if (index && jsvIsString(childName)) {
+    unsigned int i = jsvHashStringVar(childName) & mask;
+    while (index[1+i]) {
+      child = jsvGetAddressOf(index[1+i]);
+      if (jsvIsBasicVarEqual(child, childName))
+        return jsvLockAgain(child);
+      i = (i+1) & mask;
+    }
+    childref = 0; // not in the index, so not in the object
+  }
+#endif
 
   while (childref) {
     child = jsvLock(childref);
@@ -2765,6 +3640,14 @@ void jsvRemoveChild(JsVar *parent, JsVar *child) {
   assert(jsvIsName(child));
   JsVarRef childref = jsvGetRef(child);
   bool wasChild = false;
+#ifdef JSV_CHILD_INDEXES
+  if (jsvHasArrayIndex(parent)) jsvArrayIndexRemove(parent, child);
+  else if (jsvArrayIndexFailed(parent)) jsvChildIndexFree(parent);
+  else jsvHashIndexRemove(parent, child);
+#endif
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+  if (jsvIsObject(parent) || jsvIsFunction(parent)) jsvObjectChangeCount++;
+#endif
   // unlink from parent
   if (jsvGetFirstChild(parent) == childref) {
     jsvSetFirstChild(parent, jsvGetNextSibling(child));
@@ -2808,6 +3691,9 @@ void jsvRemoveChild(JsVar *parent, JsVar *child) {
 
 void jsvRemoveAllChildren(JsVar *parent) {
   assert(jsvHasChildren(parent));
+#ifdef JSV_CHILD_INDEXES
+  jsvChildIndexFree(parent);
+#endif
   while (jsvGetFirstChild(parent)) {
     JsVar *v = jsvLock(jsvGetFirstChild(parent));
     jsvRemoveChild(parent, v);
@@ -2949,6 +3835,9 @@ JsVarInt jsvSetArrayLength(JsVar *arr, JsVarInt length, bool truncate) {
   if (truncate && length < arr->varData.integer) {
     // @TODO implement truncation here
   }
+#ifdef JSV_CHILD_INDEXES
+  if (jsvArrayIndexFailed(arr)) jsvChildIndexFree(arr); // it may not be sparse now
+#endif
   arr->varData.integer = length;
   return length;
 }
@@ -2982,6 +3871,10 @@ static size_t _jsvCountJsVarsUsedRecursive(JsVar *v, bool resetRecursionFlag) {
   }
 
   size_t count = 1;
+#ifdef JSV_CHILD_INDEXES
+  if (jsvHasChildIndex(v)) // flat string, so not recursively counted
+    count += 1 + jsvGetFlatStringBlocks(jsvGetAddressOf(jsvGetNextSibling(v)));
+#endif
   if (jsvHasSingleChild(v) || jsvHasChildren(v)) {
     JsVarRef childref = jsvGetFirstChild(v);
     while (childref) {
@@ -2995,6 +3888,14 @@ static size_t _jsvCountJsVarsUsedRecursive(JsVar *v, bool resetRecursionFlag) {
     count += jsvGetFlatStringBlocks(v);
   if (jsvHasCharacterData(v)) {
     JsVarRef childref = jsvGetLastChild(v);
+#ifdef JSV_NAME_ATOMS
+    if (jsvGetNameAtom(v)) { // shared, so only count it once
+      JsVar *atom = jsvLock(childref);
+      count += _jsvCountJsVarsUsedRecursive(atom, resetRecursionFlag);
+      jsvUnLock(atom);
+      childref = 0;
+    }
+#endif
     while (childref) {
       JsVar *child = jsvLock(childref);
       count++;
@@ -3019,6 +3920,10 @@ size_t jsvCountJsVarsUsed(JsVar *v) {
 }
 
 JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
+#ifdef JSV_CHILD_INDEXES
+  JsVar *indexed;
+  if (jsvArrayIndexFind((JsVar*)arr, index, &indexed)) return indexed;
+#endif
   JsVarRef childref = jsvGetLastChild(arr);
   JsVarInt lastArrayIndex = 0;
   // Look at last non-string element!
@@ -3246,6 +4151,9 @@ JsVar *jsvArrayPop(JsVar *arr) {
 /// Removes the first element of an array, and returns that element (or 0 if empty). DOES NOT RENUMBER.
 JsVar *jsvArrayPopFirst(JsVar *arr) {
   assert(jsvIsArray(arr));
+#ifdef JSV_CHILD_INDEXES
+  jsvChildIndexFree(arr); // everything after the first element is going to be renumbered
+#endif
   if (jsvGetFirstChild(arr)) {
     JsVar *child = jsvLock(jsvGetFirstChild(arr));
     if (jsvGetFirstChild(arr) == jsvGetLastChild(arr))
@@ -3315,6 +4223,9 @@ JsVar *jsvArrayJoin(JsVar *arr, JsVar *filler) {
 /// Insert a new element before beforeIndex, DOES NOT UPDATE INDICES
 void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element) {
   if (beforeIndex) {
+#ifdef JSV_CHILD_INDEXES
+    jsvChildIndexFree(arr); // everything after here is going to be renumbered
+#endif
     JsVar *idxVar = jsvMakeIntoVariableName(jsvNewFromInteger(0), element);
     if (!idxVar) return; // out of memory
 
@@ -3337,6 +4248,114 @@ void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element) {
     jsvArrayPush(arr, element);
 }
 
+void jsvArraySortInPlace(JsVar *arr, JsvArrayCompareFn compare, void *userData) {
+  assert(jsvIsArray(arr));
+#ifdef JSV_CHILD_INDEXES
+  jsvChildIndexFree(arr); // the elements are going to be renumbered
+#endif
+#ifdef JSV_GC_INCREMENTAL_VARS
+  jsvVarChangeCount++; // children are moving about
+#endif
+  /* Take the elements out of the array while we sort them (in a list linked
+   * with nextSibling) so the compare function can't change the list under us.
+   * They're locked so they can't be freed or moved by a defrag in the meantime.
+   * Anything else (eg. arr.foo) is left where it is. */
+  JsVarRef list = 0, tail = 0;
+  JsVarRef ref = jsvGetFirstChild(arr);
+  while (ref) {
+    JsVar *child = jsvGetAddressOf(ref);
+    JsVarRef next = jsvGetNextSibling(child);
+    if (jsvIsInt(child) && child->varData.integer>=0) {
+      JsVarRef prev = jsvGetPrevSibling(child);
+      if (prev) jsvSetNextSibling(jsvGetAddressOf(prev), next);
+      else jsvSetFirstChild(arr, next);
+      if (next) jsvSetPrevSibling(jsvGetAddressOf(next), prev);
+      else jsvSetLastChild(arr, prev);
+      jsvLock(ref);
+      jsvSetNextSibling(child, 0);
+      if (tail) jsvSetNextSibling(jsvGetAddressOf(tail), ref);
+      else list = ref;
+      tail = ref;
+    }
+    ref = next;
+  }
+  // Bottom-up merge sort: merge pairs of runs of 'width' elements until there's only one run
+  JsVarInt width = 1;
+  bool stop = false;
+  while (list) {
+    JsVarRef a = list;
+    list = tail = 0;
+    int merges = 0;
+    while (a) {
+      merges++;
+      JsVarRef b = a;
+      JsVarInt aLen = 0, bLen = width;
+      while (b && aLen<width) {
+        aLen++;
+        b = jsvGetNextSibling(jsvGetAddressOf(b));
+      }
+      while (aLen || (bLen && b)) {
+        bool fromA;
+        if (!aLen) fromA = false;
+        else if (!bLen || !b || stop) fromA = true;
+        else {
+          JsVar *va = jsvSkipName(jsvGetAddressOf(a));
+          JsVar *vb = jsvSkipName(jsvGetAddressOf(b));
+          // take from a if equal, so the sort is stable
+          fromA = compare(va, vb, userData)<=0;
+          jsvUnLock2(va, vb);
+          stop = jspIsInterrupted() || jspHasError();
+        }
+        JsVarRef e;
+        if (fromA) {
+          e = a;
+          a = jsvGetNextSibling(jsvGetAddressOf(a));
+          aLen--;
+        } else {
+          e = b;
+          b = jsvGetNextSibling(jsvGetAddressOf(b));
+          bLen--;
+        }
+        if (tail) jsvSetNextSibling(jsvGetAddressOf(tail), e);
+        else list = e;
+        tail = e;
+      }
+      a = b;
+    }
+    jsvSetNextSibling(jsvGetAddressOf(tail), 0);
+    if (merges<=1 || stop) break;
+    width *= 2;
+  }
+  // Drop any elements the compare function added, then put ours back (before anything else)
+  ref = jsvGetFirstChild(arr);
+  while (ref) {
+    JsVar *child = jsvLock(ref);
+    ref = jsvGetNextSibling(child);
+    if (jsvIsInt(child) && child->varData.integer>=0)
+      jsvRemoveChild(arr, child);
+    jsvUnLock(child);
+  }
+  JsVarInt count = 0;
+  JsVarRef prev = 0;
+  ref = list;
+  while (ref) {
+    JsVar *child = jsvGetAddressOf(ref);
+    jsvSetInteger(child, count++);
+    jsvSetPrevSibling(child, prev);
+    prev = ref;
+    ref = jsvGetNextSibling(child);
+    jsvUnLock(child); // the array still references it
+  }
+  if (list) {
+    JsVarRef first = jsvGetFirstChild(arr);
+    jsvSetNextSibling(jsvGetAddressOf(tail), first);
+    if (first) jsvSetPrevSibling(jsvGetAddressOf(first), tail);
+    else jsvSetLastChild(arr, tail);
+    jsvSetFirstChild(arr, list);
+  }
+  if (jsvGetArrayLength(arr) < count) jsvSetArrayLength(arr, count, false);
+}
+
 /** Same as jsvMathsOpPtr, but if a or b are a name, skip them
  * and go to what they point to. Also handle the case where
  * they may be objects with valueOf functions. */
@@ -3351,6 +4370,118 @@ JsVar *jsvMathsOpSkipNames(JsVar *a, JsVar *b, int op) {
   return res;
 }
 
+/// Is this a number that nothing else can see, so can be overwritten with the result of a maths op?
+static bool jsvIsTemporaryNumber(JsVar *v) {
+  JsVarFlags f = v->flags & (JSV_VARTYPEMASK|JSV_NATIVE);
+  return (f==JSV_INTEGER || f==JSV_FLOAT) && jsvGetLocks(v)==1 && jsvGetRefs(v)==0;
+}
+
+/// Return a number from jsvMathsOpSkipNamesAndUnLock - in a or b if we can, or a new var if not
+static JsVar *jsvMathsOpNumberAndUnLock(JsVar *a, JsVar *b, JsVarFlags type, JsVarInt i, JsVarFloat f) {
+  JsVar *r = 0;
+  if (jsvIsTemporaryNumber(a)) {
+    r = a;
+    a = 0;
+  } else if (jsvIsTemporaryNumber(b)) {
+    r = b;
+    b = 0;
+  }
+  jsvUnLock2(a, b);
+  if (r) r->flags = (JsVarFlags)((r->flags & ~JSV_VARTYPEMASK) | type);
+  else r = jsvNewWithFlags(type);
+  if (!r) return 0; // out of memory
+  if (type==JSV_FLOAT) {
+    r->varData.floating = f;
+  } else {
+    r->varData.floating = 0; // clear the parts of a float that an int doesn't use
+    r->varData.integer = i;
+  }
+  return r;
+}
+
+/** If v is a number, or a name whose value is a number, get the number without
+ * allocating anything (as jsvSkipName would for names with int values). Returns
+ * JSV_INTEGER or JSV_FLOAT, or JSV_UNUSED if it's not a number */
+static JsVarFlags jsvGetNumberForMaths(JsVar *v, JsVarInt *i, JsVarFloat *f) {
+  if (!v) return JSV_UNUSED;
+  if (jsvIsNameInt(v)) {
+    *i = (JsVarInt)jsvGetFirstChildSigned(v);
+    return JSV_INTEGER;
+  }
+  if (jsvIsName(v)) {
+    if (jsvIsNameWithValue(v) || jsvIsArrayBufferName(v) || !jsvGetFirstChild(v))
+      return JSV_UNUSED;
+    v = jsvGetAddressOf(jsvGetFirstChild(v)); // we only read it, so no need to lock
+  }
+  JsVarFlags t = v->flags&JSV_VARTYPEMASK;
+  if (t==JSV_INTEGER) *i = v->varData.integer;
+  else if (t==JSV_FLOAT) *f = v->varData.floating;
+  else return JSV_UNUSED; // getters/setters, names of names, etc
+  return t;
+}
+
+JsVar *jsvMathsOpSkipNamesAndUnLock(JsVar *a, JsVar *b, int op) {
+  JsVarInt ia = 0, ib = 0;
+  JsVarFloat fa = 0, fb = 0;
+  JsVarFlags ta = jsvGetNumberForMaths(a, &ia, &fa);
+  JsVarFlags tb = jsvGetNumberForMaths(b, &ib, &fb);
+  if (ta==JSV_INTEGER && tb==JSV_INTEGER) {
+    // Same as jsvMathsOp, but without allocating
+    JsVarInt da = ia;
+    JsVarInt db = ib;
+    long long r;
+    switch (op) {
+    case '+': r = (long long)da + (long long)db; break;
+    case '-': r = (long long)da - (long long)db; break;
+    case '*': r = (long long)da * (long long)db; break;
+    case '/': return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, (JsVarFloat)da/(JsVarFloat)db);
+    case '&': r = da&db; break;
+    case '|': r = da|db; break;
+    case '^': r = da^db; break;
+    case '%': if (db<0) db=-db; // fix SIGFPE
+              if (!db) return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, NAN);
+              r = da%db; break;
+    case LEX_LSHIFT: r = da << db; break;
+    case LEX_RSHIFT: r = da >> db; break;
+    case LEX_RSHIFTUNSIGNED: r = ((JsVarIntUnsigned)da) >> db; break;
+    case LEX_TYPEEQUAL:
+    case LEX_EQUAL:     return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da==db, 0);
+    case LEX_NTYPEEQUAL:
+    case LEX_NEQUAL:    return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da!=db, 0);
+    case '<':           return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da<db, 0);
+    case LEX_LEQUAL:    return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da<=db, 0);
+    case '>':           return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da>db, 0);
+    case LEX_GEQUAL:    return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da>=db, 0);
+    default: r = 0; op = 0; break;
+    }
+    if (op) {
+      if (r>=-2147483648LL && r<=2147483647LL) // as jsvNewFromLongInteger
+        return jsvMathsOpNumberAndUnLock(a, b, JSV_INTEGER, (JsVarInt)r, 0);
+      return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, (JsVarFloat)r);
+    }
+  } else if (ta && tb) {
+    JsVarFloat da = (ta==JSV_INTEGER) ? (JsVarFloat)ia : fa;
+    JsVarFloat db = (tb==JSV_INTEGER) ? (JsVarFloat)ib : fb;
+    switch (op) {
+    case '+': return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, da+db);
+    case '-': return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, da-db);
+    case '*': return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, da*db);
+    case '/': return jsvMathsOpNumberAndUnLock(a, b, JSV_FLOAT, 0, da/db);
+    case LEX_TYPEEQUAL:
+    case LEX_EQUAL:     return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da==db, 0);
+    case LEX_NTYPEEQUAL:
+    case LEX_NEQUAL:    return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da!=db, 0);
+    case '<':           return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da<db, 0);
+    case LEX_LEQUAL:    return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da<=db, 0);
+    case '>':           return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da>db, 0);
+    case LEX_GEQUAL:    return jsvMathsOpNumberAndUnLock(a, b, JSV_BOOLEAN, da>=db, 0);
+    default: break; // eg. bitwise ops, which need converting to ints
+    }
+  }
+  JsVar *res = jsvMathsOpSkipNames(a, b, op);
+  jsvUnLock2(a, b);
+  return res;
+}
 
 JsVar *jsvMathsOpError(int op, const char *datatype) {
   char opName[32];
@@ -3520,10 +4651,7 @@ JsVar *jsvMathsOp(JsVar *a, JsVar *b, int op) {
 }
 
 JsVar *jsvNegateAndUnLock(JsVar *v) {
-  JsVar *zero = jsvNewFromInteger(0);
-  JsVar *res = jsvMathsOpSkipNames(zero, v, '-');
-  jsvUnLock2(zero, v);
-  return res;
+  return jsvMathsOpSkipNamesAndUnLock(jsvNewFromInteger(0), v, '-');
 }
 
 /// see jsvGetPathTo
@@ -3716,12 +4844,28 @@ void jsvTrace(JsVar *var, int indent) {
 }
 
 
-/** Recursively mark the variable. Return false if it fails due to stack. */
-static bool jsvGarbageCollectMarkUsed(JsVar *var) {
+/// Vars that have been marked as used by the GC, but whose children haven't been marked yet
+typedef struct {
+  JsVarRef refs[JSV_GC_MARK_STACK_SIZE];
+  unsigned int count;
+  bool overflowed; ///< We marked a var but didn't have space to remember it
+} JsvGCMarkStack;
+
+/// Mark a var that has JSV_GARBAGE_COLLECT set as used, and remember to mark its children
+static void jsvGarbageCollectMarkPush(JsvGCMarkStack *stack, JsVar *var) {
   var->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+  if (!jsvHasCharacterData(var) && !jsvHasSingleChild(var) && !jsvHasChildren(var))
+    return; // nothing else to mark
+  if (stack->count < JSV_GC_MARK_STACK_SIZE)
+    stack->refs[stack->count++] = jsvGetRef(var);
+  else
+    stack->overflowed = true;
+}
+
+/// Mark the children of a var that has already been marked as used
+static void jsvGarbageCollectMarkChildren(JsvGCMarkStack *stack, JsVar *var) {
   JsVarRef child;
   JsVar *childVar;
-
   if (jsvHasCharacterData(var)) {
     // non-recursively scan strings
     child = jsvGetLastChild(var);
@@ -3736,27 +4880,220 @@ static bool jsvGarbageCollectMarkUsed(JsVar *var) {
     if (jsvGetFirstChild(var)) {
       childVar = jsvGetAddressOf(jsvGetFirstChild(var));
       if (childVar->flags & JSV_GARBAGE_COLLECT)
-        if (!jsvGarbageCollectMarkUsed(childVar)) return false;
+        jsvGarbageCollectMarkPush(stack, childVar);
     }
   } else if (jsvHasChildren(var)) {
-    if (jsuGetFreeStack() < 256) return false;
-
+#ifdef JSV_CHILD_INDEXES
+    if (jsvHasChildIndex(var))
+      jsvGetAddressOf(jsvGetNextSibling(var))->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+#endif
     child = jsvGetFirstChild(var);
     while (child) {
       childVar = jsvGetAddressOf(child);
-      if (childVar->flags & JSV_GARBAGE_COLLECT)
-        if (!jsvGarbageCollectMarkUsed(childVar)) return false;
+      if (childVar->flags & JSV_GARBAGE_COLLECT) {
+        /* Children are names, which have no children of their own - so mark
+         * them (and push their values) now rather than filling the stack with them */
+        childVar->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+        jsvGarbageCollectMarkChildren(stack, childVar);
+      }
       child = jsvGetNextSibling(childVar);
     }
   }
+}
 
-  return true;
+/** Mark var, and everything that can be reached from it, as used. We keep a
+ * fixed-size stack of vars whose children still need marking. If it fills up we
+ * keep marking vars but don't remember them, and when the stack is empty we
+ * search memory for used vars whose children might not have been marked. */
+static void jsvGarbageCollectMarkUsed(JsVar *var) {
+  JsvGCMarkStack stack;
+  stack.count = 0;
+  stack.overflowed = false;
+  jsvGarbageCollectMarkPush(&stack, var);
+  while (true) {
+    while (stack.count)
+      jsvGarbageCollectMarkChildren(&stack, jsvGetAddressOf(stack.refs[--stack.count]));
+    if (!stack.overflowed) return;
+    stack.overflowed = false;
+    JsVarRef i;
+    for (i=1;i<=jsVarsSize;i++) {
+      JsVar *v = jsvGetAddressOf(i);
+      if (jsvIsFlatString(v)) {
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip the string's data
+      } else if ((v->flags&JSV_VARTYPEMASK) != JSV_UNUSED &&
+                 !(v->flags & JSV_GARBAGE_COLLECT) &&
+                 !jsvIsStringExt(v)) {
+        jsvGarbageCollectMarkChildren(&stack, v);
+        while (stack.count)
+          jsvGarbageCollectMarkChildren(&stack, jsvGetAddressOf(stack.refs[--stack.count]));
+      }
+    }
+  }
 }
 
+/** Mark vars that are only kept by refs from outside of JsVars (rather
+ * than by locks) as used */
+static void jsvGarbageCollectMarkRoots() {
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+  unsigned int i;
+  for (i=0;i<JSV_NATIVE_FUNCTION_CACHE_SIZE;i++) {
+    JsVarRef ref = jsvNativeFunctionCache[i];
+    if (ref && (jsvGetAddressOf(ref)->flags & JSV_GARBAGE_COLLECT))
+      jsvGarbageCollectMarkUsed(jsvGetAddressOf(ref));
+  }
+#endif
+}
+
+/** The GC is about to free this var. If it had a child that wasn't listed
+ * for GC then we need to unref it. Everything else is fine because it'll
+ * disappear anyway. We don't have to check if we should free this other
+ * variable here because we know the GC picked up it was referenced from
+ * somewhere else. */
+static void jsvGarbageCollectUnRefChild(JsVar *var) {
+  if (jsvHasSingleChild(var)) {
+    JsVarRef ch = jsvGetFirstChild(var);
+    if (ch) {
+      JsVar *child = jsvGetAddressOf(ch); // not locked
+      if (child->flags!=JSV_UNUSED && // not already GC'd!
+          !(child->flags&JSV_GARBAGE_COLLECT)) // not marked for GC
+        jsvUnRef(child);
+    }
+  }
+#ifdef JSV_NAME_ATOMS
+  JsVarRef atomRef = jsvGetNameAtom(var);
+  if (atomRef) {
+    JsVar *atom = jsvGetAddressOf(atomRef); // not locked
+    if (!(atom->flags&JSV_GARBAGE_COLLECT)) // still used by other names
+      jsvUnRef(atom);
+  }
+#endif
+}
+
+#ifdef JSV_GC_INCREMENTAL_VARS
+static void jsvGarbageCollectRecordPause(JsSysTime startTime) {
+  JsSysTime t = jshGetSystemTime() - startTime;
+  if (t > gcMaxPause) gcMaxPause = t;
+}
+
+/** Do one step (JSV_GC_INCREMENTAL_VARS vars) of the current pass of an incremental
+ * garbage collection. Returns the number of vars freed */
+static unsigned int jsvGarbageCollectIncrementalStep() {
+  unsigned int freedCount = 0;
+  JsVarRef i = gcIncrementalPos;
+  JsVarRef end = (JsVarRef)(i + JSV_GC_INCREMENTAL_VARS);
+  if (end > jsVarsSize+1) end = (JsVarRef)(jsVarsSize+1);
+  switch (gcIncrementalState) {
+  case GCI_FLAG: // Add GC flags to anything that is currently used
+    for (;i<end;i++) {
+      JsVar *var = jsvGetAddressOf(i);
+      if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+        var->flags |= (JsVarFlags)JSV_GARBAGE_COLLECT;
+        if (jsvIsFlatString(var))
+          i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+      }
+    }
+    break;
+  case GCI_MARK: // recursively remove flags from anything that is referenced from a var that is locked
+    if (i==1) jsvGarbageCollectMarkRoots();
+    for (;i<end;i++) {
+      JsVar *var = jsvGetAddressOf(i);
+      if ((var->flags & JSV_GARBAGE_COLLECT) && jsvGetLocks(var)>0)
+        jsvGarbageCollectMarkUsed(var);
+      if (jsvIsFlatString(var))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+    break;
+  case GCI_UNREF: // we don't free anything in this pass, so no vars can be reused while we look at their children
+    for (;i<end;i++) {
+      JsVar *var = jsvGetAddressOf(i);
+      if (var->flags & JSV_GARBAGE_COLLECT) {
+        if (jsvIsFlatString(var))
+          i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+        else
+          jsvGarbageCollectUnRefChild(var);
+      } else if (jsvIsFlatString(var))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+    break;
+  case GCI_SWEEP:
+    for (;i<end;i++) {
+      JsVar *var = jsvGetAddressOf(i);
+      if (var->flags & JSV_GARBAGE_COLLECT) {
+        unsigned int count = jsvIsFlatString(var) ? (unsigned int)jsvGetFlatStringBlocks(var) : 0;
+        freedCount += count+1;
+        jsvAddToFreeList(var);
+        while (count-- > 0) // free a flat string's other blocks
+          jsvAddToFreeList(jsvGetAddressOf(++i));
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+        jsvObjectChangeCount++;
+#endif
+      } else if (jsvIsFlatString(var))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+    break;
+  default: break;
+  }
+  if (gcIncrementalState!=GCI_IDLE) {
+    gcIncrementalPos = i;
+    if (i > jsVarsSize) { // on to the next pass
+      gcIncrementalPos = 1;
+      if (gcIncrementalState==GCI_SWEEP) gcIncrementalState = GCI_IDLE;
+      else gcIncrementalState = (GCIncrementalState)(gcIncrementalState+1);
+    }
+  }
+  return freedCount;
+}
+
+/** Stop any incremental garbage collection. If it was still flagging or marking
+ * nothing has changed yet, but if it was unreffing or sweeping then some garbage
+ * has already had its children unreffed, so it mustn't be flagged again - finish
+ * those passes instead. Returns the number of vars freed. */
+static unsigned int jsvGarbageCollectIncrementalFinish() {
+  unsigned int freedCount = 0;
+  while (gcIncrementalState==GCI_UNREF || gcIncrementalState==GCI_SWEEP)
+    freedCount += jsvGarbageCollectIncrementalStep();
+  gcIncrementalState = GCI_IDLE;
+  return freedCount;
+}
+#endif
+
+#ifdef JSPARSE_MAX_TOKEN_CACHE_LENGTH
+/** Drop every function's pretokenised copy of its code (see jspeFunctionCacheTokens).
+ * They're made again when the functions are next called, if there's enough memory.
+ * Returns the number of copies freed */
+static unsigned int jsvFunctionTokensPurge() {
+  unsigned int freed = 0;
+  JsVarRef i;
+  for (i=1;i<=jsVarsSize;i++)  {
+    JsVar *var = jsvGetAddressOf(i);
+    if (jsvIsName(var) && jsvIsString(var) && jsvGetFirstChild(var) &&
+        jsvIsStringEqual(var, JSPARSE_FUNCTION_TOKENS_NAME)) {
+      JsVarRef tokensRef = jsvGetFirstChild(var);
+      JsVar *tokens = jsvGetAddressOf(tokensRef);
+      // if it's shared (it's the function's code, because that couldn't be tokenised) leave it
+      if (jsvGetRefs(tokens)==1) {
+        if (!jsvGetLocks(tokens)) freed++; // else it's being executed, and will be freed afterwards
+        jsvSetFirstChild(var, 0);
+        jsvUnRefRef(tokensRef);
+      }
+    }
+    // if we have a flat string, skip that many blocks
+    if (jsvIsFlatString(var))
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+  }
+  return freed;
+}
+#endif
+
 /** Run a garbage collection sweep - return nonzero if things have been freed */
 int jsvGarbageCollect() {
   if (isMemoryBusy) return 0;
   isMemoryBusy = MEMBUSY_GC;
+  unsigned int freedCount = 0;
+#ifdef JSV_GC_INCREMENTAL_VARS
+  JsSysTime startTime = jshGetSystemTime();
+  freedCount += jsvGarbageCollectIncrementalFinish(); // we're doing everything now
+#endif
   JsVarRef i;
   // Add GC flags to anything that is currently used
   for (i=1;i<=jsVarsSize;i++)  {
@@ -3769,16 +5106,12 @@ int jsvGarbageCollect() {
     }
   }
   /* recursively remove anything that is referenced from a var that is locked. */
+  jsvGarbageCollectMarkRoots();
   for (i=1;i<=jsVarsSize;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags & JSV_GARBAGE_COLLECT) && // not already GC'd
         jsvGetLocks(var)>0) { // or it is locked
-      if (!jsvGarbageCollectMarkUsed(var)) {
-        // this could fail due to stack exhausted (eg big linked list)
-        // JSV_GARBAGE_COLLECT are left set, but not a big problem as next GC will clear them
-        isMemoryBusy = MEM_NOT_BUSY;
-        return 0;
-      }
+      jsvGarbageCollectMarkUsed(var);
     }
     // if we have a flat string, skip that many blocks
     if (jsvIsFlatString(var))
@@ -3788,9 +5121,8 @@ int jsvGarbageCollect() {
    * Also update the free list - this means that every new variable that
    * gets allocated gets allocated towards the start of memory, which
    * hopefully helps compact everything towards the start. */
-  unsigned int freedCount = 0;
   jsVarFirstEmpty = 0;
-  JsVar *lastEmpty = 0;
+  JsVarRef lastEmpty = 0;
   for (i=1;i<=jsVarsSize;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if (var->flags & JSV_GARBAGE_COLLECT) {
@@ -3801,35 +5133,18 @@ int jsvGarbageCollect() {
         // Free the first block
         var->flags = JSV_UNUSED;
         // add this to our free list
-        if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-        else jsVarFirstEmpty = i;
-        lastEmpty = var;
+        jsvFreeListAppend(&lastEmpty, i);
         // free subsequent blocks
         while (count-- > 0) {
           i++;
           var = jsvGetAddressOf((JsVarRef)(i));
           var->flags = JSV_UNUSED;
           // add this to our free list
-          if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-          else jsVarFirstEmpty = i;
-          lastEmpty = var;
+          jsvFreeListAppend(&lastEmpty, i);
         }
       } else {
         // otherwise just free 1 block
-        if (jsvHasSingleChild(var)) {
-          /* If this had a child that wasn't listed for GC then we need to
-           * unref it. Everything else is fine because it'll disappear anyway.
-           * We don't have to check if we should free this other variable
-           * here because we know the GC picked up it was referenced from
-           * somewhere else. */
-          JsVarRef ch = jsvGetFirstChild(var);
-          if (ch) {
-            JsVar *child = jsvGetAddressOf(ch); // not locked
-            if (child->flags!=JSV_UNUSED && // not already GC'd!
-                !(child->flags&JSV_GARBAGE_COLLECT)) // not marked for GC
-              jsvUnRef(child);
-          }
-        }
+        jsvGarbageCollectUnRefChild(var);
         /* Sanity checks here. We're making sure that any variables that are
          * linked from this one have either already been garbage collected or
          * are marked for GC */
@@ -3852,9 +5167,7 @@ int jsvGarbageCollect() {
         // free!
         var->flags = JSV_UNUSED;
         // add this to our free list
-        if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-        else jsVarFirstEmpty = i;
-        lastEmpty = var;
+        jsvFreeListAppend(&lastEmpty, i);
         freedCount++;
       }
     } else if (jsvIsFlatString(var)) {
@@ -3862,92 +5175,242 @@ int jsvGarbageCollect() {
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
     } else if (var->flags == JSV_UNUSED) {
       // this is already free - add it to the free list
-      if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-      else jsVarFirstEmpty = i;
-      lastEmpty = var;
+      jsvFreeListAppend(&lastEmpty, i);
     }
   }
-  if (lastEmpty) jsvSetNextSibling(lastEmpty, 0);
+  jsvFreeListEnd(lastEmpty);
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+  if (freedCount) jsvObjectChangeCount++;
+#endif
   isMemoryBusy = MEM_NOT_BUSY;
+#ifdef JSV_GC_INCREMENTAL_VARS
+  jsvGarbageCollectRecordPause(startTime);
+#endif
   return (int)freedCount;
 }
 
-void jsvDefragment() {
-  // garbage collect - removes cruft
-  // also puts free list in order
-  jsvGarbageCollect();
-  // Fill defragVars with defraggable variables
-  jshInterruptOff();
-  const int DEFRAGVARS = 256; // POWER OF 2
-  JsVarRef defragVars[DEFRAGVARS];
-  memset(defragVars, 0, sizeof(defragVars));
-  int defragVarIdx = 0;
-  for (int i=0;i<jsvGetMemoryTotal();i++) {
-    JsVarRef vr = i+1;
-    JsVar *v = _jsvGetAddressOf(vr);
-    if ((v->flags&JSV_VARTYPEMASK)!=JSV_UNUSED) {
-      if (jsvIsFlatString(v)) {
-        i += jsvGetFlatStringBlocks(v); // skip forward
-      } else if (jsvGetLocks(v)==0) {
-        defragVars[defragVarIdx] = vr;
-        defragVarIdx = (defragVarIdx+1) & (DEFRAGVARS-1);
-      }
+#ifdef JSV_GC_INCREMENTAL_VARS
+bool jsvGarbageCollectIncremental() {
+  if (isMemoryBusy) return false;
+  isMemoryBusy = MEMBUSY_GC;
+  JsSysTime startTime = jshGetSystemTime();
+  /* Marking is only valid if nothing changed while we were doing it.
+   * Once we're unreffing/sweeping, anything that is still flagged is
+   * unreachable, so nothing can change it. */
+  if ((gcIncrementalState==GCI_FLAG || gcIncrementalState==GCI_MARK) &&
+      gcIncrementalChangeCount != jsvVarChangeCount)
+    gcIncrementalState = GCI_IDLE;
+  if (gcIncrementalState==GCI_IDLE) {
+    gcIncrementalState = GCI_FLAG;
+    gcIncrementalPos = 1;
+  }
+  jsvGarbageCollectIncrementalStep();
+  gcIncrementalChangeCount = jsvVarChangeCount;
+  isMemoryBusy = MEM_NOT_BUSY;
+  jsvGarbageCollectRecordPause(startTime);
+  return gcIncrementalState!=GCI_IDLE;
+}
+
+#ifndef RELEASE
+int jsvGarbageCollectIncrementalTest(int pass) {
+  bool more = true;
+  while (more && (int)gcIncrementalState!=pass)
+    more = jsvGarbageCollectIncremental();
+  if (more) jsvGarbageCollectIncremental();
+  return (int)gcIncrementalState;
+}
+#endif
+
+JsSysTime jsvGetGarbageCollectMaxPause() {
+  JsSysTime t = gcMaxPause;
+  gcMaxPause = 0;
+  return t;
+}
+#endif
+
+/// If ref is in 'from', return the matching ref in 'to'
+static JsVarRef jsvDefragmentGetNewRef(JsVarRef ref, const JsVarRef *from, const JsVarRef *to, unsigned int count, JsVarRef minFrom) {
+  if (ref < minFrom) return ref; // quick check
+  for (unsigned int i=0;i<count;i++)
+    if (from[i]==ref) return to[i];
+  return ref;
+}
+
+/** Move up to JSV_DEFRAG_VARS unlocked vars from the top of memory into
+ * free vars at the bottom, and update any references to them. Returns
+ * the number of vars that were moved. */
+static unsigned int jsvDefragmentStep() {
+  JsVarRef fromRefs[JSV_DEFRAG_VARS]; // ring buffer of the highest unlocked vars
+  JsVarRef toRefs[JSV_DEFRAG_VARS]; // the lowest free vars
+  unsigned int fromCount = 0, fromIdx = 0, toCount = 0;
+  JsVarRef top = defragHighPos ? defragHighPos : (JsVarRef)jsVarsSize;
+  isMemoryBusy = MEMBUSY_SYSTEM;
+  JsVarRef i;
+  for (i=defragLowPos;i<=top;i++) {
+    JsVar *v = jsvGetAddressOf(i);
+    if ((v->flags&JSV_VARTYPEMASK)==JSV_UNUSED) {
+      if (toCount<JSV_DEFRAG_VARS)
+        toRefs[toCount++] = i;
+    } else if (jsvIsFlatString(v)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip forward - these can't move
+    } else if (toCount && jsvGetLocks(v)==0) { // only worth moving if there's a free var below
+      fromRefs[fromIdx] = i;
+      fromIdx = (fromIdx+1) % JSV_DEFRAG_VARS;
+      fromCount++;
     }
   }
-  // Now go through defragVars defragging them
-  defragVarIdx--;
-  if (defragVarIdx<0) defragVarIdx+=DEFRAGVARS;
-  while (defragVars[defragVarIdx]) {
-    JsVarRef defragFromRef = defragVars[defragVarIdx];
-    JsVarRef defragToRef = jsVarFirstEmpty;
-    if (!defragToRef || defragFromRef<defragToRef) {
-      // we're done!
-      break;
+  // Put the highest vars first, and pair them with the lowest free vars
+  JsVarRef ring[JSV_DEFRAG_VARS];
+  memcpy(ring, fromRefs, sizeof(ring));
+  if (fromCount > JSV_DEFRAG_VARS) fromCount = JSV_DEFRAG_VARS;
+  unsigned int count = 0;
+  while (count<fromCount && count<toCount) {
+    JsVarRef from = ring[(fromIdx + JSV_DEFRAG_VARS - 1 - count) % JSV_DEFRAG_VARS];
+    if (from < toRefs[count]) break; // everything below here is already packed
+    fromRefs[count++] = from;
+  }
+  if (!count) {
+    isMemoryBusy = MEM_NOT_BUSY;
+    defragLowPos = 1; // start from scratch next time
+    defragHighPos = 0;
+    return 0;
+  }
+  JsVarRef minFrom = fromRefs[count-1];
+  // Next time, start searching just above the last var we fill, and stop below the last one we empty
+  defragLowPos = (JsVarRef)(toRefs[count-1]+1);
+  defragHighPos = (JsVarRef)(minFrom-1);
+  /* Anything may reference the vars we're moving, so that still needs
+   * one pass over all of memory - with IRQs off, as vars are invalid
+   * until it's done */
+  jshInterruptOff();
+  // relocate!
+  for (unsigned int j=0;j<count;j++) {
+    JsVar *from = jsvGetAddressOf(fromRefs[j]);
+    *jsvGetAddressOf(toRefs[j]) = *from;
+    from->flags = JSV_UNUSED;
+  }
+  // find references!
+  for (i=1;i<=jsVarsSize;i++) {
+    JsVar *v = jsvGetAddressOf(i);
+    if ((v->flags&JSV_VARTYPEMASK)==JSV_UNUSED) continue;
+    if (jsvIsFlatString(v)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip forward
+      continue;
     }
-    // relocate!
-    JsVar *defragFrom = _jsvGetAddressOf(defragFromRef);
-    JsVar *defragTo = _jsvGetAddressOf(defragToRef);
-    jsVarFirstEmpty = jsvGetNextSibling(defragTo); // move our reference to the next in the free list
-    // copy data
-    *defragTo = *defragFrom;
-    defragFrom->flags = JSV_UNUSED;
-    // find references!
-    for (int i=0;i<jsvGetMemoryTotal();i++) {
-      JsVarRef vr = i+1;
-      JsVar *v = _jsvGetAddressOf(vr);
-      if ((v->flags&JSV_VARTYPEMASK)!=JSV_UNUSED) {
-        if (jsvIsFlatString(v)) {
-          i += jsvGetFlatStringBlocks(v); // skip forward
-        } else {
-          if (jsvHasSingleChild(v))
-            if (jsvGetFirstChild(v)==defragFromRef)
-              jsvSetFirstChild(v,defragToRef);
-          if (jsvHasStringExt(v))
-            if (jsvGetLastChild(v)==defragFromRef)
-              jsvSetLastChild(v,defragToRef);
-          if (jsvHasChildren(v)) {
-            if (jsvGetFirstChild(v)==defragFromRef)
-              jsvSetFirstChild(v,defragToRef);
-            if (jsvGetLastChild(v)==defragFromRef)
-              jsvSetLastChild(v,defragToRef);
-          }
-          if (jsvIsName(v)) {
-            if (jsvGetNextSibling(v)==defragFromRef)
-              jsvSetNextSibling(v,defragToRef);
-            if (jsvGetPrevSibling(v)==defragFromRef)
-              jsvSetPrevSibling(v,defragToRef);
-          }
-        }
-      }
+#define DEFRAG_NEW_REF(REF) jsvDefragmentGetNewRef(REF, fromRefs, toRefs, count, minFrom)
+    if (jsvHasSingleChild(v))
+      jsvSetFirstChild(v, DEFRAG_NEW_REF(jsvGetFirstChild(v)));
+    if (jsvHasStringExt(v))
+      jsvSetLastChild(v, DEFRAG_NEW_REF(jsvGetLastChild(v)));
+    if (jsvHasChildren(v)) {
+      jsvSetFirstChild(v, DEFRAG_NEW_REF(jsvGetFirstChild(v)));
+      jsvSetLastChild(v, DEFRAG_NEW_REF(jsvGetLastChild(v)));
+    }
+    if (jsvIsName(v)) {
+      jsvSetNextSibling(v, DEFRAG_NEW_REF(jsvGetNextSibling(v)));
+      jsvSetPrevSibling(v, DEFRAG_NEW_REF(jsvGetPrevSibling(v)));
     }
-    // zero element and move to next...
-    defragVars[defragVarIdx] = 0;
-    defragVarIdx--;
-    if (defragVarIdx<0) defragVarIdx+=DEFRAGVARS;
+#ifdef JSV_CHILD_INDEXES
+    if (jsvHasChildIndex(v)) { // child indexes are flat strings so never move, but they point to names that can
+      unsigned int length;
+      JsVarRef *index = jsvGetChildIndex(v, &length);
+      for (unsigned int j=1;j<length;j++)
+        index[j] = DEFRAG_NEW_REF(index[j]);
+    }
+#endif
   }
+  // References to vars that are stored outside of JsVars
+  timerArray = DEFRAG_NEW_REF(timerArray);
+  watchArray = DEFRAG_NEW_REF(watchArray);
+  if (timerQueue) { // a flat string (and locked) so it never moves, but it points to timers that can
+    JsVarRef *queue = (JsVarRef*)jsvGetFlatStringPointer(timerQueue);
+    for (JsVarRef j=1;j<=queue[0];j++)
+      queue[j] = DEFRAG_NEW_REF(queue[j]);
+  }
+  if (watchTable) { // likewise
+    JsiWatch *watches = (JsiWatch*)jsvGetFlatStringPointer(watchTable);
+    size_t watchCount = jsvGetCharactersInVar(watchTable)/sizeof(JsiWatch);
+    for (size_t j=0;j<watchCount;j++)
+      watches[j].watch = DEFRAG_NEW_REF(watches[j].watch);
+  }
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+  for (unsigned int j=0;j<JSV_NATIVE_FUNCTION_CACHE_SIZE;j++)
+    jsvNativeFunctionCache[j] = DEFRAG_NEW_REF(jsvNativeFunctionCache[j]);
+#endif
+#undef DEFRAG_NEW_REF
+  jshInterruptOn();
+  isMemoryBusy = MEM_NOT_BUSY;
   // rebuild free var list
   jsvCreateEmptyVarList();
-  jshInterruptOn();
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+  jsvObjectChangeCount++; // vars have moved
+#endif
+  return count;
+}
+
+void jsvDefragment() {
+  // garbage collect - removes cruft
+  jsvGarbageCollect();
+  if (isMemoryBusy) return;
+  defragLowPos = 1; // the GC may have freed vars anywhere
+  defragHighPos = 0;
+  while (jsvDefragmentStep());
+#ifdef JSV_GC_INCREMENTAL_VARS
+  defragRequested = false;
+#endif
+}
+
+#ifdef JSV_GC_INCREMENTAL_VARS
+void jsvDefragmentRequest() {
+  defragRequested = true;
+  defragLowPos = 1;
+  defragHighPos = 0;
+}
+
+bool jsvDefragmentIncremental() {
+  if (!defragRequested || isMemoryBusy) return false;
+  JsSysTime startTime = jshGetSystemTime();
+  if (gcIncrementalState==GCI_UNREF || gcIncrementalState==GCI_SWEEP) {
+    /* Garbage that's been unreffed but not freed yet can't be moved, so
+     * finish the GC first - a step at a time, as it would have been */
+    isMemoryBusy = MEMBUSY_GC;
+    jsvGarbageCollectIncrementalStep();
+    isMemoryBusy = MEM_NOT_BUSY;
+    defragLowPos = 1; // vars have been freed
+    defragHighPos = 0;
+    jsvGarbageCollectRecordPause(startTime);
+    return true;
+  }
+  // vars can't move while they're being marked - but that hasn't changed anything yet, so GC can start again afterwards
+  gcIncrementalState = GCI_IDLE;
+  unsigned int moved = jsvDefragmentStep();
+  jsvGarbageCollectRecordPause(startTime);
+  if (moved < JSV_DEFRAG_VARS) // nothing left to move
+    defragRequested = false;
+  return defragRequested;
+}
+#endif
+
+void jsvGetFragmentation(unsigned int *largestFreeRun, unsigned int *fragmentation) {
+  unsigned int freeCount = 0, run = 0, largest = 0;
+  JsVar *lastVar = 0;
+  for (JsVarRef i=1;i<=jsVarsSize;i++) {
+    JsVar *v = jsvGetAddressOf(i);
+    if ((v->flags&JSV_VARTYPEMASK)==JSV_UNUSED) {
+      freeCount++;
+      // with RESIZABLE_JSVARS, vars in different blocks aren't contiguous
+      if (v!=lastVar+1) run = 0;
+      run++;
+      if (run>largest) largest = run;
+      lastVar = v;
+    } else {
+      run = 0;
+      if (jsvIsFlatString(v))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(v));
+    }
+  }
+  *largestFreeRun = largest;
+  *fragmentation = freeCount ? 100 - (largest*100 / freeCount) : 0;
 }
 
 // Dump any locked variables that aren't referenced from `global` - for debugging memory leaks
@@ -344,6 +344,13 @@ JsVar *jsvNewObject(); ///< Create a new object
 JsVar *jsvNewEmptyArray(); ///< Create a new array
 JsVar *jsvNewArray(JsVar **elements, int elementCount); ///< Create an array containing the given elements
 JsVar *jsvNewNativeFunction(void (*ptr)(void), unsigned short argTypes); ///< Create an array containing the given elements
+/** Like jsvNewNativeFunction, but used when a built-in function is referenced by name (eg `Math.sin`).
+ * If one was created recently and nothing else is using it (or has modified it), that var is returned rather than a new one */
+JsVar *jsvNewNativeFunctionShared(void (*ptr)(void), unsigned short argTypes);
+#ifdef JSV_NATIVE_FUNCTION_CACHE_SIZE
+/// Release the built-in functions kept by jsvNewNativeFunctionShared
+void jsvNativeFunctionCacheClear();
+#endif
 JsVar *jsvNewNativeString(char *ptr, size_t len); ///< Create a Native String pointing to the given memory area
 #ifdef SPIFLASH_BASE
 JsVar *jsvNewFlashString(char *ptr, size_t len); ///< Create a Flash String pointing to the given memory area
@@ -352,6 +359,10 @@ JsVar *jsvNewArrayBufferFromString(JsVar *str, unsigned int lengthOrZero); ///<
 
 /// Turns var into a Variable name that links to the given value... No locking so no need to unlock var
 JsVar *jsvMakeIntoVariableName(JsVar *var, JsVar *valueOrZero);
+#ifdef JSV_NAME_ATOMS
+/// Release the table of the characters that long names share (see jsvMakeIntoVariableName)
+void jsvNameAtomsClear();
+#endif
 /// Turns var into a 'function parameter' that the parser recognises when parsing a function
 void jsvMakeFunctionParameter(JsVar *v);
 /// Add a new function parameter to a function (name may be 0) - use this when binding function arguments This unlocks paramName if specified, but not value.
@@ -647,6 +658,10 @@ JsVar *jsvAsName(JsVar *var);
 
 /// MATHS!
 JsVar *jsvMathsOpSkipNames(JsVar *a, JsVar *b, int op);
+/** Same as jsvMathsOpSkipNames, but unlocks a and b. If both are numbers (or
+ * names of numbers), the result may be stored in a or b (if nothing else can see
+ * them) rather than in a new var. */
+JsVar *jsvMathsOpSkipNamesAndUnLock(JsVar *a, JsVar *b, int op);
 bool jsvMathsOpTypeEqual(JsVar *a, JsVar *b);
 JsVar *jsvMathsOp(JsVar *a, JsVar *b, int op);
 /// Negates an integer/double value
@@ -718,6 +733,12 @@ JsVar *jsvArrayPopFirst(JsVar *arr); ///< Removes the first element of an array,
 void jsvArrayAddUnique(JsVar *arr, JsVar *v); ///< Adds a new variable element to the end of an array (IF it was not already there). Return true if successful
 JsVar *jsvArrayJoin(JsVar *arr, JsVar *filler); ///< Join all elements of an array together into a string
 void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element); ///< Insert a new element before beforeIndex, DOES NOT UPDATE INDICES
+/// Compare two values for jsvArraySortInPlace - return <0, 0 or >0 as for strcmp
+typedef JsVarInt (*JsvArrayCompareFn)(JsVar *a, JsVar *b, void *userData);
+/** Stable sort of an array's elements, relinking the names that hold them. Doesn't
+ * allocate anything or recurse, but elements end up numbered from 0 (so any
+ * missing ones are moved to the end). Stops sorting if execution is interrupted */
+void jsvArraySortInPlace(JsVar *arr, JsvArrayCompareFn compare, void *userData);
 static ALWAYS_INLINE bool jsvArrayIsEmpty(JsVar *arr) { assert(jsvIsArray(arr)); return !jsvGetFirstChild(arr); } ///< Return true is array is empty
 
 
@@ -728,9 +749,51 @@ void jsvTrace(JsVar *var, int indent);
 /** Run a garbage collection sweep - return nonzero if things have been freed */
 int jsvGarbageCollect();
 
+#ifdef JSV_GC_INCREMENTAL_VARS
+/** Do part of a garbage collection, looking at no more than JSV_GC_INCREMENTAL_VARS
+ * vars. Returns true if there's more to do, in which case it should be called again
+ * (eg. from the idle loop). If any vars change between calls before everything has
+ * been marked, the collection starts again. */
+bool jsvGarbageCollectIncremental();
+/// Return the longest time execution was stopped for garbage collection since this was last called
+JsSysTime jsvGetGarbageCollectMaxPause();
+#ifndef RELEASE
+/** For testing. Run jsvGarbageCollectIncremental until it's doing the given pass (1=flag,
+ * 2=mark, 3=unref, 4=sweep) and then do one more step. Returns the pass it's in afterwards, or 0 if finished */
+int jsvGarbageCollectIncrementalTest(int pass);
+#endif
+#endif
+
+#ifdef JSPARSE_MEMBER_CACHE_SIZE
+/** Incremented whenever a name is removed from an object or function, or an object
+ * is freed or moved. While it's unchanged, a name found in an object is still in it. */
+extern unsigned int jsvObjectChangeCount;
+#endif
+#ifdef JSPARSE_SCOPE_CACHE_SIZE
+/** Incremented whenever a name is added to an object or function that is referenced
+ * from somewhere (so could be a scope). While it's unchanged, a name that wasn't in
+ * a scope still isn't. */
+extern unsigned int jsvObjectAddCount;
+#endif
+
 /** Defragement memory - this could take a while with interrupts turned off! */
 void jsvDefragment();
 
+#ifdef JSV_GC_INCREMENTAL_VARS
+/// Ask for jsvDefragmentIncremental to defragment memory
+void jsvDefragmentRequest();
+/** If jsvDefragmentRequest was called, move up to JSV_DEFRAG_VARS vars down to the
+ * bottom of memory. Returns true if there's more to do, in which case it should be
+ * called again (eg. from the idle loop). No vars may be referenced from C code
+ * without being locked when this is called. */
+bool jsvDefragmentIncremental();
+#endif
+
+/** Get the size of the largest block of contiguous free vars (which limits the
+ * size of flat strings), and how fragmented free memory is as a percentage
+ * (0 = all free vars are contiguous, 100 = no two free vars are together) */
+void jsvGetFragmentation(unsigned int *largestFreeRun, unsigned int *fragmentation);
+
 // Dump any locked variables that aren't referenced from `global` - for debugging memory leaks
 void jsvDumpLockedVars();
 // Dump the free list - in order
@@ -381,6 +381,26 @@ void jsvStringIteratorAppend(JsvStringIterator *it, char ch) {
   jsvSetCharactersInVar(it->var, it->charsInVar);
 }
 
+void jsvStringIteratorAppendBuf(JsvStringIterator *it, const char *str, size_t length) {
+  while (length) {
+    // append one char (which allocates a new block if needed)...
+    jsvStringIteratorAppend(it, *(str++));
+    length--;
+    if (!it->var) return; // out of memory
+    // ...then fill up the rest of the block directly
+    size_t maxChars = jsvGetMaxCharactersInVar(it->var);
+    if (!length || it->charsInVar >= maxChars) continue;
+    size_t chars = maxChars - it->charsInVar;
+    if (chars > length) chars = length;
+    memcpy(&it->ptr[it->charsInVar], str, chars);
+    str += chars;
+    length -= chars;
+    it->charsInVar += chars;
+    it->charIdx = it->charsInVar-1;
+    jsvSetCharactersInVar(it->var, it->charsInVar);
+  }
+}
+
 void jsvStringIteratorAppendString(JsvStringIterator *it, JsVar *str, size_t startIdx, int maxLength) {
   JsvStringIterator sit;
   jsvStringIteratorNew(&sit, str, startIdx);
@@ -601,6 +621,30 @@ void jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value) {
   if (dataLen!=1) it->hasAccessedElement = true;
 }
 
+void jsvArrayBufferIteratorSetFloatValue(JsvArrayBufferIterator *it, JsVarFloat v) {
+  if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return;
+  if (!JSV_ARRAYBUFFER_IS_FLOAT(it->type)) {
+    jsvArrayBufferIteratorSetIntegerValue(it, (JsVarInt)v);
+    return;
+  }
+  assert(!it->hasAccessedElement); // we just haven't implemented this case yet
+  char data[8];
+  int i,dataLen = (int)JSV_ARRAYBUFFER_GET_SIZE(it->type);
+  jsvArrayBufferIteratorFloatToData(data, (unsigned)dataLen, it->type, v);
+  if (it->type & ARRAYBUFFERVIEW_BIG_ENDIAN) {
+    for (i=dataLen-1;i>=0;i--) {
+      jsvStringIteratorSetChar(&it->it, data[i]);
+      jsvStringIteratorNext(&it->it);
+    }
+  } else {
+    for (i=0;i<dataLen;i++) {
+      jsvStringIteratorSetChar(&it->it, data[i]);
+      jsvStringIteratorNext(&it->it);
+    }
+  }
+  it->hasAccessedElement = true;
+}
+
 void jsvArrayBufferIteratorSetByteValue(JsvArrayBufferIterator *it, char c) {
   if (JSV_ARRAYBUFFER_GET_SIZE(it->type)!=1) {
     assert(0);
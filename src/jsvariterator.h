@@ -162,6 +162,9 @@ void jsvStringIteratorGoto(JsvStringIterator *it, JsVar *str, size_t startIdx);
 /// Append a character TO THE END of a string iterator
 void jsvStringIteratorAppend(JsvStringIterator *it, char ch);
 
+/// Append a buffer of characters TO THE END of a string iterator (filling each block in one go)
+void jsvStringIteratorAppendBuf(JsvStringIterator *it, const char *str, size_t length);
+
 /// Append an entire JsVar string TO THE END of a string iterator
 void jsvStringIteratorAppendString(JsvStringIterator *it, JsVar *str, size_t startIdx, int maxLength);
 
@@ -240,6 +243,7 @@ JsVarFloat jsvArrayBufferIteratorGetFloatValue(JsvArrayBufferIterator *it);
 void   jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value);
 void   jsvArrayBufferIteratorSetValueAndRewind(JsvArrayBufferIterator *it, JsVar *value);
 void   jsvArrayBufferIteratorSetIntegerValue(JsvArrayBufferIterator *it, JsVarInt value);
+void   jsvArrayBufferIteratorSetFloatValue(JsvArrayBufferIterator *it, JsVarFloat value);
 void   jsvArrayBufferIteratorSetByteValue(JsvArrayBufferIterator *it, char c); ///< special case for when we know we're writing to a byte array
 JsVar* jsvArrayBufferIteratorGetIndex(JsvArrayBufferIterator *it);
 bool   jsvArrayBufferIteratorHasElement(JsvArrayBufferIterator *it);
@@ -725,12 +725,27 @@ Returns true if the provided object is an array
  */
 
 
+/// Can we get the string value of this without allocating anything?
+static bool _jswrap_array_sort_isSimple(JsVar *v) {
+  return !v || jsvIsNumeric(v) || jsvIsBoolean(v) || jsvIsNull(v);
+}
+
 NO_INLINE static JsVarInt _jswrap_array_sort_compare(JsVar *a, JsVar *b, JsVar *compareFn) {
   if (compareFn) {
     JsVar *args[2] = {a,b};
     JsVarFloat f = jsvGetFloatAndUnLock(jspeFunctionCall(compareFn, 0, 0, false, 2, args));
     if (f==0) return 0;
     return (f<0)?-1:1;
+  } else if (jsvIsString(a) && jsvIsString(b)) {
+    return jsvCompareString(a,b, 0, 0, false);
+  } else if (_jswrap_array_sort_isSimple(a) && _jswrap_array_sort_isSimple(b) &&
+             !jsvIsString(a) && !jsvIsString(b)) {
+    // numbers are still compared as strings, but we do it on the stack
+    char sa[JS_NUMBER_BUFFER_SIZE], sb[JS_NUMBER_BUFFER_SIZE];
+    jsvGetString(a, sa, sizeof(sa));
+    jsvGetString(b, sb, sizeof(sb));
+    int r = strcmp(sa, sb);
+    return (r<0)?-1:(r>0);
   } else {
     JsVar *sa = jsvAsString(a);
     JsVar *sb = jsvAsString(b);
@@ -740,76 +755,58 @@ NO_INLINE static JsVarInt _jswrap_array_sort_compare(JsVar *a, JsVar *b, JsVar *
   }
 }
 
-NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compareFn) {
-  if (n < 2) return; // sort done!
-
-  JsvIterator pivot;
-  jsvIteratorClone(&pivot, head);
-  bool pivotLowest = true; // is the pivot the lowest value in here?
-  JsVar *pivotValue = jsvIteratorGetValue(&pivot);
-  /* We're just going to use the first entry (head) as the pivot...
-   * We'll move along with our iterator 'it', and if it < pivot then we'll
-   * swap the values over (hence moving pivot forwards)  */
-
-  int nlo = 0, nhigh = 0;
-  JsvIterator it;
-  jsvIteratorClone(&it, head); //
-  jsvIteratorNext(&it);
-
-
-  /* Partition and count sizes. */
-  while (--n && !jspIsInterrupted()) {
-    JsVar *itValue = jsvIteratorGetValue(&it);
-    JsVarInt cmp = _jswrap_array_sort_compare(itValue, pivotValue, compareFn);
-    if (cmp<=0) {
-      if (cmp<0) pivotLowest = false;
-      nlo++;
-      /* 'it' <= 'pivot', so we need to move it behind.
-         In this diagram, P=pivot, L=it
-
-               l l l l l P h h h h h L
-                         |  \       /
-                          \  \_____/_
-                          _\______/  \
-                         / |         |
-                         | |         |
-               l l l l l L P h h h h h
-
-         It makes perfect sense now...
-       */
-      // first, get the old pivot value and overwrite it with the iterator value
-      jsvIteratorSetValue(&pivot, itValue); // no unlock needed
-      // now move pivot forwards, and set 'it' to the value the new pivot has
-      jsvIteratorNext(&pivot);
-      jsvUnLock(jsvIteratorSetValue(&it, jsvIteratorGetValue(&pivot)));
-      // finally set the pivot iterator to the pivot's value again
-      jsvIteratorSetValue(&pivot, pivotValue); // no unlock needed
-    } else {
-      nhigh++;
-      // Great, 'it' > 'pivot' so it's in the right place
+/** Stable merge sort of n JsVarRefs in 'refs', using 'tmp' (also n long) as
+ * working space. Returns whichever of them the result ends up in. If we're
+ * interrupted, what's returned still contains every ref but isn't sorted */
+static JsVarRef *_jswrap_array_mergesort(JsVarRef *refs, JsVarRef *tmp, int n, JsVar *compareFn) {
+  for (int width=1; width<n; width*=2) {
+    for (int lo=0; lo<n; lo+=width*2) {
+      int mid = lo+width, hi = lo+width*2;
+      if (mid>n) mid=n;
+      if (hi>n) hi=n;
+      int l = lo, r = mid, o = lo;
+      bool needsMerge = mid<hi;
+      // if the two halves are already in order we don't have to merge them
+      if (needsMerge) {
+        JsVar *a = jsvLockSafe(refs[mid-1]);
+        JsVar *b = jsvLockSafe(refs[mid]);
+        needsMerge = _jswrap_array_sort_compare(a, b, compareFn)>0;
+        jsvUnLock2(a, b);
+      }
+      if (needsMerge) {
+        while (l<mid && r<hi) {
+          JsVar *a = jsvLockSafe(refs[l]);
+          JsVar *b = jsvLockSafe(refs[r]);
+          // take from the left if equal, so the sort is stable
+          if (_jswrap_array_sort_compare(a, b, compareFn)<=0)
+            tmp[o++] = refs[l++];
+          else
+            tmp[o++] = refs[r++];
+          jsvUnLock2(a, b);
+        }
+        if (jspIsInterrupted() || jspHasError()) return refs;
+      }
+      while (l<mid) tmp[o++] = refs[l++];
+      while (r<hi) tmp[o++] = refs[r++];
     }
-    jsvUnLock(itValue);
-    jsvIteratorNext(&it);
+    JsVarRef *t = refs;
+    refs = tmp;
+    tmp = t;
   }
-  jsvIteratorFree(&it);
-  jsvUnLock(pivotValue);
+  return refs;
+}
 
-  if (jspIsInterrupted()) {
-    jsvIteratorFree(&pivot);
-    return;
-  }
+/// Compare function for jsvArraySortInPlace
+static JsVarInt _jswrap_array_sort_compare_cb(JsVar *a, JsVar *b, void *compareFn) {
+  return _jswrap_array_sort_compare(a, b, (JsVar*)compareFn);
+}
 
-  // now recurse. Do RHS first because we can
-  // free the pivot early if we do this
-  jsvIteratorNext(&pivot);
-  _jswrap_array_sort(&pivot, nhigh, compareFn);
-  jsvIteratorFree(&pivot);
-  // LHS
-  /* If the pivot is the lowest number in this chunk of numbers, then
-   * we know that anything to the left of it must be joint equal to it.
-   * In that casem there's no need to sort it. */
-  if (!pivotLowest)
-    _jswrap_array_sort(head, nlo, compareFn);
+/// Unlock the values whose refs are in 'refs' (we kept them locked while sorting)
+static void _jswrap_array_sort_unlock(JsVarRef *refs, int n) {
+  for (int i=0;i<n;i++) {
+    JsVar *v = jsvLockSafe(refs[i]);
+    jsvUnLock2(v, v);
+  }
 }
 
 /*JSON{
@@ -823,7 +820,7 @@ NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compar
   ],
   "return" : ["JsVar","This array object"]
 }
-Do an in-place quicksort of the array
+Do an in-place, stable sort of the array
  */
 JsVar *jswrap_array_sort (JsVar *array, JsVar *compareFn) {
   if (!jsvIsUndefined(compareFn) && !jsvIsFunction(compareFn)) {
@@ -853,9 +850,56 @@ JsVar *jswrap_array_sort (JsVar *array, JsVar *compareFn) {
     n = (int)jsvGetLength(array);
   }
 
-  jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
-  _jswrap_array_sort(&it, n, compareFn);
-  jsvIteratorFree(&it);
+  if (n<2) return jsvLockAgain(array);
+
+  /* Sort a list of refs to the values (in a flat string). Each value stays
+   * locked while we sort, so it can't be freed (eg. if the compare function
+   * modifies the array) or moved by a defrag. Getting values may need a var
+   * each (for ints), so check there's space first. */
+  JsVar *buf = jsvMoreFreeVariablesThan((unsigned int)n) ?
+      jsvNewFlatStringOfLength((unsigned int)(sizeof(JsVarRef)*2*(size_t)n)) : 0;
+  JsVarRef *refs = buf ? (JsVarRef*)jsvGetFlatStringPointer(buf) : 0;
+  int i = 0;
+  if (refs) {
+    jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
+    while (i<n && jsvIteratorHasElement(&it)) {
+      JsVar *v = jsvIteratorGetValue(&it);
+      // if it's in the array lots of times we could run out of locks
+      if (v && jsvGetLocks(v) > JSV_LOCK_MAX/2) {
+        jsvUnLock(v);
+        _jswrap_array_sort_unlock(refs, i);
+        jsvUnLock(buf);
+        refs = 0;
+        break;
+      }
+      refs[i++] = v ? jsvGetRef(v) : 0; // 0 = undefined
+      jsvIteratorNext(&it);
+    }
+    jsvIteratorFree(&it);
+  }
+  if (!refs) {
+    // not enough memory - relink the array's elements in order instead
+    if (jsvIsArray(array))
+      jsvArraySortInPlace(array, _jswrap_array_sort_compare_cb, compareFn);
+    return jsvLockAgain(array);
+  }
+  n = i;
+
+  JsVarRef *sorted = _jswrap_array_mergesort(refs, refs+n, n, compareFn);
+  // Write the values back in the right order
+  if (!jspIsInterrupted() && !jspHasError()) {
+    i = 0;
+    jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
+    while (i<n && jsvIteratorHasElement(&it)) {
+      JsVar *v = jsvLockSafe(sorted[i++]);
+      jsvIteratorSetValue(&it, v);
+      jsvUnLock(v);
+      jsvIteratorNext(&it);
+    }
+    jsvIteratorFree(&it);
+  }
+  _jswrap_array_sort_unlock(refs, n);
+  jsvUnLock(buf);
   return jsvLockAgain(array);
 }
 
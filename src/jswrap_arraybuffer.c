@@ -640,7 +640,8 @@ Join all elements of this array together into one string, using 'separator' betw
   "return" : ["JsVar","This array object"],
   "return_object" : "ArrayBufferView"
 }
-Do an in-place quicksort of the array
+Do an in-place sort of the array. If no compare function is given, elements
+are sorted numerically.
  */
 static JsVarFloat _jswrap_arraybufferview_sort_float(JsVarFloat a, JsVarFloat b) {
   return a-b;
@@ -649,11 +650,73 @@ static JsVarInt _jswrap_arraybufferview_sort_int(JsVarInt a, JsVarInt b) {
   return a-b;
 }
 
+/// a<b for sorting, with NaN at the end
+static ALWAYS_INLINE bool _jswrap_arraybufferview_sort_less(JsVarFloat a, JsVarFloat b) {
+  return a<b || (isnan(b) && !isnan(a));
+}
+
+/// Heapsort (in-place, and no recursion) for an array of numbers
+static void _jswrap_arraybufferview_heapsort(JsVarFloat *v, size_t n) {
+  size_t start = n/2, end = n;
+  while (end > 1) {
+    if (start > 0) { // build the heap
+      start--;
+    } else { // take the max off the heap
+      end--;
+      JsVarFloat t = v[end]; v[end] = v[0]; v[0] = t;
+    }
+    // sift down from 'start'
+    size_t root = start;
+    while (root*2+1 < end) {
+      size_t child = root*2+1;
+      if (child+1 < end && _jswrap_arraybufferview_sort_less(v[child], v[child+1]))
+        child++;
+      if (!_jswrap_arraybufferview_sort_less(v[root], v[child])) break;
+      JsVarFloat t = v[root]; v[root] = v[child]; v[child] = t;
+      root = child;
+    }
+  }
+}
+
 JsVar *jswrap_arraybufferview_sort(JsVar *array, JsVar *compareFn) {
   if (!jsvIsArrayBuffer(array)) return 0;
-  bool isFloat = JSV_ARRAYBUFFER_IS_FLOAT(array->varData.arraybuffer.type);
+  JsVarDataArrayBufferViewType type = array->varData.arraybuffer.type;
+  bool isFloat = JSV_ARRAYBUFFER_IS_FLOAT(type);
   if (compareFn)
     return jswrap_array_sort(array, compareFn);
+  /* Copy the values out into a flat string, sort them natively and write them back.
+   * JsVarFloat is big enough to hold every type exactly */
+  size_t n = jsvGetArrayBufferLength(array);
+  JsVar *buf = jsvNewFlatStringOfLength((unsigned int)(n*sizeof(JsVarFloat)));
+  if (buf) {
+    JsVarFloat *values = (JsVarFloat*)jsvGetFlatStringPointer(buf);
+    bool isUint32 = (type & ~ARRAYBUFFERVIEW_BIG_ENDIAN) == ARRAYBUFFERVIEW_UINT32;
+    JsvArrayBufferIterator it;
+    size_t i = 0;
+    jsvArrayBufferIteratorNew(&it, array, 0);
+    while (i<n && jsvArrayBufferIteratorHasElement(&it)) {
+      if (isFloat) values[i] = jsvArrayBufferIteratorGetFloatValue(&it);
+      else if (isUint32) values[i] = (JsVarFloat)(uint32_t)jsvArrayBufferIteratorGetIntegerValue(&it);
+      else values[i] = (JsVarFloat)jsvArrayBufferIteratorGetIntegerValue(&it);
+      i++;
+      jsvArrayBufferIteratorNext(&it);
+    }
+    jsvArrayBufferIteratorFree(&it);
+    n = i;
+    _jswrap_arraybufferview_heapsort(values, n);
+    i = 0;
+    jsvArrayBufferIteratorNew(&it, array, 0);
+    while (i<n && jsvArrayBufferIteratorHasElement(&it)) {
+      if (isFloat) jsvArrayBufferIteratorSetFloatValue(&it, values[i]);
+      else jsvArrayBufferIteratorSetIntegerValue(&it, (JsVarInt)(long long)values[i]);
+      i++;
+      jsvArrayBufferIteratorNext(&it);
+    }
+    jsvArrayBufferIteratorFree(&it);
+    jsvUnLock(buf);
+    return jsvLockAgain(array);
+  }
+  // Not enough memory - use the normal sort with a native compare function
   compareFn = isFloat ?
       jsvNewNativeFunction(
           (void (*)(void))_jswrap_arraybufferview_sort_float,
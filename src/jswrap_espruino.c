@@ -1139,6 +1139,48 @@ void jswrap_espruino_dumpFreeList() {
 }
 #endif
 
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "stepGC",
+  "ifndef" : "RELEASE",
+  "generate" : "jswrap_espruino_stepGC",
+  "params" : [
+    ["pass","int","The pass to stop in: 1=flag, 2=mark, 3=unref, 4=sweep"]
+  ],
+  "return" : ["int","The pass the garbage collection is in afterwards, or 0 if it finished"]
+}
+Run the garbage collection that is normally done a bit at a time when idle
+until it is part way through the given pass - for testing only.
+*/
+#ifndef RELEASE
+int jswrap_espruino_stepGC(int pass) {
+#ifdef JSV_GC_INCREMENTAL_VARS
+  return jsvGarbageCollectIncrementalTest(pass);
+#else
+  NOT_USED(pass);
+  return 0;
+#endif
+}
+#endif
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "getSymbolCompares",
+  "ifndef" : "RELEASE",
+  "generate" : "jswrap_espruino_getSymbolCompares",
+  "return" : ["int","The number of names compared against built-in symbols so far"]
+}
+Return how many times a name has been compared against a built-in symbol
+when looking it up - for testing only.
+*/
+#ifndef RELEASE
+int jswrap_espruino_getSymbolCompares() {
+  return (int)jswSymbolCompares;
+}
+#endif
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "E",
@@ -1232,10 +1274,31 @@ void jswrap_e_dumpVariables() {
   "ifndef" : "SAVE_ON_FLASH",
   "class" : "E",
   "name" : "defrag",
-  "generate" : "jsvDefragment"
+  "generate" : "jswrap_espruino_defrag",
+  "params" : [
+    ["incremental","bool","If true, defragment a bit at a time when Espruino is idle rather than all at once"]
+  ]
 }
 BETA: defragment memory!
+
+This moves variables to the bottom of memory so that there is more contiguous
+free memory for big Strings and ArrayBuffers. See `fragmentation` and `freeRun`
+in `process.memory()`.
+
+By default this is all done at once, which could take a while with interrupts
+turned off. With `E.defrag(true)`, a few variables are moved each time Espruino
+is idle instead - which also happens automatically if a big String or
+ArrayBuffer couldn't be allocated because memory was fragmented.
  */
+void jswrap_espruino_defrag(bool incremental) {
+#ifdef JSV_GC_INCREMENTAL_VARS
+  if (incremental) {
+    jsvDefragmentRequest();
+    return;
+  }
+#endif
+  jsvDefragment();
+}
 
 /*JSON{
   "type" : "staticmethod",
@@ -43,8 +43,11 @@ int jswrap_espruino_reverseByte(int v);
 void jswrap_espruino_dumpTimers();
 void jswrap_espruino_dumpLockedVars();
 void jswrap_espruino_dumpFreeList();
+int jswrap_espruino_stepGC(int pass);
+int jswrap_espruino_getSymbolCompares();
 void jswrap_e_dumpFragmentation();
 void jswrap_e_dumpVariables();
+void jswrap_espruino_defrag(bool incremental);
 JsVar *jswrap_espruino_getSizeOf(JsVar *v, int depth);
 JsVarInt jswrap_espruino_getAddressOf(JsVar *v, bool flatAddress);
 void jswrap_espruino_mapInPlace(JsVar *from, JsVar *to, JsVar *map, JsVarInt bits);
@@ -390,8 +390,10 @@ setTime((new Date("Tue, 19 Feb 2019 10:57")).getTime()/1000)
 To set the timezone for all new Dates, use `E.setTimeZone(hours)`.
  */
 void jswrap_interactive_setTime(JsVarFloat time) {
-  jshInterruptOff();
   JsSysTime stime = jshGetTimeFromMilliseconds(time*1000);
+  // keep timers firing the same time after the last idle loop as they would have
+  jsiTimersShift(stime - jsiLastIdleTime);
+  jshInterruptOff();
   jsiLastIdleTime = stime;
   JsSysTime oldtime = jshGetSystemTime();
   // set system time
@@ -516,7 +518,7 @@ JsVar *_jswrap_interface_setTimeoutOrInterval(JsVar *func, JsVarFloat interval,
   // Create a new timer
   JsVar *timerPtr = jsvNewObject();
   JsSysTime intervalInt = jshGetTimeFromMilliseconds(interval);
-  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger((jshGetSystemTime() - jsiLastIdleTime) + intervalInt));
+  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(jshGetSystemTime() + intervalInt));
   if (!isTimeout) {
     jsvObjectSetChildAndUnLock(timerPtr, "interval", jsvNewFromLongInteger(intervalInt));
   }
@@ -527,7 +529,6 @@ JsVar *_jswrap_interface_setTimeoutOrInterval(JsVar *func, JsVarFloat interval,
   // Add to array
   JsVar *itemIndex = jsvNewFromInteger(jsiTimerAdd(timerPtr));
   jsvUnLock(timerPtr);
-  jsiTimersChanged(); // mark timers as changed
   return itemIndex;
 }
 JsVar *jswrap_interface_setInterval(JsVar *func, JsVarFloat timeout, JsVar *args) {
@@ -581,13 +582,13 @@ void _jswrap_interface_clearTimeoutOrInterval(JsVar *idVarArr, bool isTimeout) {
     JsvObjectIterator it;
     jsvObjectIteratorNew(&it, timerArrayPtr);
     while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *timerName = jsvObjectIteratorGetKey(&it);
       JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
       JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0);
+      jsvObjectIteratorNext(&it);
       if (!watchPtr)
-        jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
-      else
-        jsvObjectIteratorNext(&it); 
-      jsvUnLock2(watchPtr, timerPtr);
+        jsiTimerRemove(timerName);
+      jsvUnLock3(watchPtr, timerPtr, timerName);
     }
     jsvObjectIteratorFree(&it);
   } else {
@@ -598,14 +599,13 @@ void _jswrap_interface_clearTimeoutOrInterval(JsVar *idVarArr, bool isTimeout) {
     } else {
       JsVar *child = jsvIsBasic(idVar) ? jsvFindChildFromVar(timerArrayPtr, idVar, false) : 0;
       if (child) {
-        jsvRemoveChild(timerArrayPtr, child);
+        jsiTimerRemove(child);
         jsvUnLock(child);
       }
       jsvUnLock(idVar);
     }
   }
   jsvUnLock(timerArrayPtr);
-  jsiTimersChanged(); // mark timers as changed
 }
 void jswrap_interface_clearInterval(JsVar *idVarArr) {
   _jswrap_interface_clearTimeoutOrInterval(idVarArr, false);
@@ -641,10 +641,9 @@ void jswrap_interface_changeInterval(JsVar *idVar, JsVarFloat interval) {
     JsVar *timer = jsvSkipNameAndUnLock(timerName);
     JsSysTime intervalInt = jshGetTimeFromMilliseconds(interval);
     jsvObjectSetChildAndUnLock(timer, "interval", jsvNewFromLongInteger(intervalInt));
-    jsvObjectSetChildAndUnLock(timer, "time", jsvNewFromLongInteger((jshGetSystemTime()-jsiLastIdleTime) + intervalInt));
+    jsiTimerSetTime(timer, jshGetSystemTime() + intervalInt);
     jsvUnLock(timer);
     // timerName already unlocked
-    jsiTimersChanged(); // mark timers as changed
   } else {
     jsExceptionHere(JSET_ERROR, "Unknown Interval");
   }
@@ -751,6 +751,7 @@ JsVar *jswrap_interface_setWatch(
     JsVar *watchArrayPtr = jsvLock(watchArray);
     itemIndex = jsvArrayAddToEnd(watchArrayPtr, watchPtr, 1) - 1;
     jsvUnLock2(watchArrayPtr, watchPtr);
+    jsiWatchesChanged();
 
 
   }
@@ -787,6 +788,7 @@ void jswrap_interface_clearWatch(JsVar *idVarArr) {
     // remove all items
     jsvRemoveAllChildren(watchArrayPtr);
     jsvUnLock(watchArrayPtr);
+    jsiWatchesChanged();
   } else {
     JsVar *idVar = jsvGetArrayItem(idVarArr, 0);
     if (jsvIsUndefined(idVar)) {
@@ -797,17 +799,8 @@ void jswrap_interface_clearWatch(JsVar *idVarArr) {
     JsVar *watchNamePtr = jsvFindChildFromVar(watchArrayPtr, idVar, false);
     jsvUnLock(watchArrayPtr);
     if (watchNamePtr) { // child is a 'name'
-      JsVar *watchPtr = jsvSkipName(watchNamePtr);
-      Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
-      jsvUnLock(watchPtr);
-
-      JsVar *watchArrayPtr = jsvLock(watchArray);
-      jsvRemoveChild(watchArrayPtr, watchNamePtr);
-      jsvUnLock2(watchNamePtr, watchArrayPtr);
-
-      // Now check if this pin is still being watched
-      if (!jsiIsWatchingPin(pin))
-        jshPinWatch(pin, false); // 'unwatch' pin
+      jsiWatchRemove(watchNamePtr);
+      jsvUnLock(watchNamePtr);
     } else {
       jsExceptionHere(JSET_ERROR, "Unknown Watch %v", idVar);
     }
@@ -55,7 +55,7 @@ Convert the given object into a JSON string which can subsequently be parsed wit
  */
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space) {
   NOT_USED(replacer);
-  JSONFlags flags = JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY|JSON_JSON_COMPATIBILE|JSON_ALLOW_TOJSON;
+  JSONFlags flags = JSON_STRINGIFY_FLAGS;
   JsVar *result = jsvNewFromEmptyString();
   if (result) {// could be out of memory
     char whitespace[11] = "";
@@ -76,80 +76,294 @@ JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space) {
 }
 
 
-JsVar *jswrap_json_parse_internal() {
-  switch (lex->tk) {
-  case LEX_R_TRUE:  jslGetNextToken(); return jsvNewFromBool(true);
-  case LEX_R_FALSE: jslGetNextToken(); return jsvNewFromBool(false);
-  case LEX_R_NULL:  jslGetNextToken(); return jsvNewWithFlags(JSV_NULL);
-  case '-': {
-    jslGetNextToken();
-    if (lex->tk!=LEX_INT && lex->tk!=LEX_FLOAT) return 0;
-    JsVar *v = jswrap_json_parse_internal();
-    JsVar *zero = jsvNewFromInteger(0);
-    JsVar *r = jsvMathsOp(zero, v, '-');
-    jsvUnLock2(v, zero);
-    return r;
-  }
-  case LEX_INT: {
-    long long v = stringToInt(jslGetTokenValueAsString());
-    jslGetNextToken();
-    return jsvNewFromLongInteger(v);
-  }
-  case LEX_FLOAT: {
-    JsVarFloat v = stringToFloat(jslGetTokenValueAsString());
-    jslGetNextToken();
-    return jsvNewFromFloat(v);
-  }
-  case LEX_STR: {
-    JsVar *a = jslGetTokenValueAsVar();
-    jslGetNextToken();
-    return a;
+/// State for the JSON parser (see jsonParseValue)
+typedef struct {
+  JsvStringIterator it;
+  char ch; ///< The current character, or 0 at the end of the string
+  bool streaming; ///< If set, running out of data is not an error as more may arrive (see JSON.parser)
+  bool incomplete; ///< Set if we ran out of data while streaming
+} JsonParser;
+
+static ALWAYS_INLINE void jsonNextCh(JsonParser *p) {
+  jsvStringIteratorNextInline(&p->it);
+  p->ch = jsvStringIteratorGetChar(&p->it);
+}
+
+static void jsonParserNew(JsonParser *p, JsVar *str, bool streaming) {
+  jsvStringIteratorNew(&p->it, str, 0);
+  p->ch = jsvStringIteratorGetChar(&p->it);
+  p->streaming = streaming;
+  p->incomplete = false;
+}
+
+/// Get the character after the current one
+static char jsonPeekCh(JsonParser *p) {
+  JsvStringIterator it;
+  jsvStringIteratorClone(&it, &p->it);
+  jsvStringIteratorNext(&it);
+  char ch = jsvStringIteratorGetChar(&it);
+  jsvStringIteratorFree(&it);
+  return ch;
+}
+
+/// Report that we got something other than what we expected
+static void jsonParseError(JsonParser *p, const char *expected) {
+  if (!p->ch && p->streaming) {
+    p->incomplete = true;
+    return;
+  }
+  if (p->ch) // escape the character, as it could be anything (a control character, binary...)
+    jsExceptionHere(JSET_SYNTAXERROR, "Got '%s' expected %s", escapeCharacter(p->ch, false), expected);
+  else
+    jsExceptionHere(JSET_SYNTAXERROR, "Got EOF expected %s", expected);
+}
+
+/// Skip whitespace and comments (which the JS lexer allowed, so we do too)
+static bool jsonSkipWhitespace(JsonParser *p) {
+  while (true) {
+    while (isWhitespace(p->ch)) jsonNextCh(p);
+    if (p->ch!='/') return true;
+    char next = jsonPeekCh(p);
+    if (next=='/') {
+      while (p->ch && p->ch!='\n') jsonNextCh(p);
+    } else if (next=='*') {
+      jsonNextCh(p);
+      jsonNextCh(p);
+      while (p->ch && !(p->ch=='*' && jsonPeekCh(p)=='/'))
+        jsonNextCh(p);
+      if (!p->ch) {
+        jsonParseError(p, "end of comment");
+        return false;
+      }
+      jsonNextCh(p);
+      jsonNextCh(p);
+    } else if (!next && p->streaming) {
+      p->incomplete = true; // might be the start of a comment
+      return false;
+    } else return true;
+  }
+}
+
+/// If the current character is 'ch' skip it (and whitespace after), or report an error
+static bool jsonMatch(JsonParser *p, char ch) {
+  if (p->ch!=ch) {
+    char expected[4] = "' '";
+    expected[1] = ch;
+    jsonParseError(p, expected);
+    return false;
+  }
+  jsonNextCh(p);
+  return jsonSkipWhitespace(p);
+}
+
+/// Parse a string, with escape characters handled the same way as the JS lexer
+static JsVar *jsonParseString(JsonParser *p) {
+  char delim = p->ch;
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, 0);
+  jsonNextCh(p);
+  while (p->ch && p->ch!=delim && p->ch!='\n') {
+    char ch = p->ch;
+    jsonNextCh(p);
+    if (ch=='\\') {
+      ch = p->ch;
+      jsonNextCh(p);
+      switch (ch) {
+      case 'n'  : ch = 0x0A; break;
+      case 'b'  : ch = 0x08; break;
+      case 'f'  : ch = 0x0C; break;
+      case 'r'  : ch = 0x0D; break;
+      case 't'  : ch = 0x09; break;
+      case 'v'  : ch = 0x0B; break;
+      case 'u' :
+      case 'x' : { // hex digits
+        char buf[5] = "0x??";
+        if (ch == 'u') {
+          // We don't support unicode, so we just take the bottom 8 bits
+          // of the unicode character
+          jsonNextCh(p);
+          jsonNextCh(p);
+        }
+        buf[2] = p->ch; jsonNextCh(p);
+        buf[3] = p->ch; jsonNextCh(p);
+        ch = (char)stringToInt(buf);
+      } break;
+      default:
+        if (ch>='0' && ch<='7') {
+          // octal digits
+          char buf[5] = "0";
+          buf[1] = ch;
+          int n=2;
+          if (p->ch>='0' && p->ch<='7') {
+            buf[n++] = p->ch; jsonNextCh(p);
+            if (p->ch>='0' && p->ch<='7') {
+              buf[n++] = p->ch; jsonNextCh(p);
+            }
+          }
+          buf[n]=0;
+          ch = (char)stringToInt(buf);
+        }
+        // for anything else, just push the character through
+        break;
+      }
+    }
+    jsvStringIteratorAppend(&it, ch);
+  }
+  jsvStringIteratorFree(&it);
+  if (p->ch!=delim) {
+    jsvUnLock(str);
+    jsonParseError(p, "end of string");
+    return 0;
+  }
+  jsonNextCh(p);
+  if (!jsonSkipWhitespace(p)) {
+    jsvUnLock(str);
+    return 0;
   }
+  return str;
+}
+
+/** Parse a number, accepting the same formats as the JS lexer (eg. hex). The characters
+ * are put into a buffer on the stack so we can use the same conversion functions */
+static JsVar *jsonParseNumber(JsonParser *p, bool negate) {
+  char buf[JSLEX_MAX_TOKEN_LENGTH];
+  size_t len = 0;
+#define JSON_NUMBER_APPEND(c) { if (len < sizeof(buf)-1) buf[len++] = (c); jsonNextCh(p); }
+  bool canBeFloating = true;
+  bool isFloat = false;
+  if (p->ch=='.') {
+    isFloat = true;
+  } else {
+    if (p->ch=='0') {
+      JSON_NUMBER_APPEND(p->ch);
+      if (p->ch=='x' || p->ch=='X' || p->ch=='b' || p->ch=='B' || p->ch=='o' || p->ch=='O') {
+        canBeFloating = false;
+        JSON_NUMBER_APPEND(p->ch);
+      }
+    }
+    while (isNumeric(p->ch) || (!canBeFloating && isHexadecimal(p->ch)))
+      JSON_NUMBER_APPEND(p->ch);
+    isFloat = canBeFloating && p->ch=='.';
+  }
+  if (isFloat) {
+    JSON_NUMBER_APPEND('.');
+    while (isNumeric(p->ch))
+      JSON_NUMBER_APPEND(p->ch);
+  }
+  if (canBeFloating && (p->ch=='e' || p->ch=='E')) {
+    isFloat = true;
+    JSON_NUMBER_APPEND(p->ch);
+    if (p->ch=='-' || p->ch=='+') JSON_NUMBER_APPEND(p->ch);
+    while (isNumeric(p->ch))
+      JSON_NUMBER_APPEND(p->ch);
+  }
+#undef JSON_NUMBER_APPEND
+  buf[len] = 0;
+  if (!jsonSkipWhitespace(p)) return 0;
+  if (isFloat) {
+    JsVarFloat v = stringToFloat(buf);
+    return jsvNewFromFloat(negate ? -v : v);
+  }
+  long long v = stringToInt(buf);
+  return jsvNewFromLongInteger(negate ? -v : v);
+}
+
+/// Parse a JSON value. Whitespace before it should already have been skipped
+static JsVar *jsonParseValue(JsonParser *p) {
+  switch (p->ch) {
+  case '"':
+  case '\'':
+    return jsonParseString(p);
   case '[': {
+    if (!jsonMatch(p, '[')) return 0;
     JsVar *arr = jsvNewEmptyArray(); if (!arr) return 0;
-    jslGetNextToken(); // [
-    while (lex->tk != ']' && !jspHasError()) {
-      JsVar *value = jswrap_json_parse_internal();
+    while (p->ch != ']' && !jspHasError()) {
+      JsVar *value = jsonParseValue(p);
       if (!value ||
-          (lex->tk!=']' && !jslMatch(','))) {
+          (p->ch!=']' && !jsonMatch(p, ','))) {
         jsvUnLock2(value, arr);
         return 0;
       }
       jsvArrayPush(arr, value);
       jsvUnLock(value);
     }
-    if (!jslMatch(']')) {
+    if (!jsonMatch(p, ']')) {
       jsvUnLock(arr);
       return 0;
     }
     return arr;
   }
   case '{': {
+    if (!jsonMatch(p, '{')) return 0;
     JsVar *obj = jsvNewObject(); if (!obj) return 0;
-    jslGetNextToken(); // {
-    while (lex->tk == LEX_STR && !jspHasError()) {
-      JsVar *key = jsvAsArrayIndexAndUnLock(jslGetTokenValueAsVar());
-      jslGetNextToken();
+    while ((p->ch == '"' || p->ch == '\'') && !jspHasError()) {
+      JsVar *key = jsvAsArrayIndexAndUnLock(jsonParseString(p));
       JsVar *value = 0;
-      if (!jslMatch(':') ||
-          !(value=jswrap_json_parse_internal()) ||
-          (lex->tk!='}' && !jslMatch(','))) {
+      if (!key ||
+          !jsonMatch(p, ':') ||
+          !(value=jsonParseValue(p)) ||
+          (p->ch!='}' && !jsonMatch(p, ','))) {
         jsvUnLock3(key, value, obj);
         return 0;
       }
       jsvAddName(obj, jsvMakeIntoVariableName(key, value));
       jsvUnLock2(value, key);
     }
-    if (!jslMatch('}')) {
+    if (!jsonMatch(p, '}')) {
       jsvUnLock(obj);
       return 0;
     }
     return obj;
   }
+  case '-': {
+    jsonNextCh(p);
+    if (!jsonSkipWhitespace(p)) return 0;
+    if (!(isNumeric(p->ch) || (p->ch=='.' && isNumeric(jsonPeekCh(p))))) {
+      jsonParseError(p, "a number");
+      return 0;
+    }
+    return jsonParseNumber(p, true);
+  }
   default: {
-    char buf[32];
-    jslTokenAsString(lex->tk, buf, 32);
-    jsExceptionHere(JSET_SYNTAXERROR, "Expecting a valid value, got %s", buf);
+    if (isNumeric(p->ch) || (p->ch=='.' && isNumeric(jsonPeekCh(p))))
+      return jsonParseNumber(p, false);
+    if (p->ch=='.' && !jsonPeekCh(p) && p->streaming) {
+      p->incomplete = true;
+      return 0;
+    }
+    if (isAlpha(p->ch)) {
+      // true/false/null - anything else is an error
+      char buf[8];
+      size_t len = 0;
+      while (isAlpha(p->ch) || isNumeric(p->ch) || p->ch=='$') {
+        if (len < sizeof(buf)-1) buf[len++] = p->ch;
+        else len = sizeof(buf); // too long to be one of ours
+        jsonNextCh(p);
+      }
+      JsVar *v = 0;
+      if (len<sizeof(buf)) {
+        buf[len] = 0;
+        if (!strcmp(buf,"true")) v = jsvNewFromBool(true);
+        else if (!strcmp(buf,"false")) v = jsvNewFromBool(false);
+        else if (!strcmp(buf,"null")) v = jsvNewWithFlags(JSV_NULL);
+      }
+      if (!v && !p->ch && p->streaming) {
+        p->incomplete = true; // might just be the start of 'true'/etc
+        return 0;
+      }
+      if (!v) {
+        jsExceptionHere(JSET_SYNTAXERROR, "Expecting a valid value, got ID");
+        return 0;
+      }
+      if (!jsonSkipWhitespace(p)) {
+        jsvUnLock(v);
+        return 0;
+      }
+      return v;
+    }
+    jsonParseError(p, "a valid value");
     return 0; // undefined = error
   }
   }
@@ -167,20 +381,313 @@ JsVar *jswrap_json_parse_internal() {
 }
 Parse the given JSON string into a JavaScript object
 
-NOTE: This implementation uses eval() internally, and as such it is unsafe as it can allow arbitrary JS commands to be executed.
+**Note:** As well as standard JSON, this also accepts single-quoted strings,
+hexadecimal numbers and comments.
  */
 JsVar *jswrap_json_parse(JsVar *v) {
-  JsLex lex;
   JsVar *str = jsvAsString(v);
-  JsLex *oldLex = jslSetLex(&lex);
-  jslInit(str);
+  if (!str) return 0;
+  JsonParser p;
+  jsonParserNew(&p, str, false);
+  JsVar *res = 0;
+  if (jsonSkipWhitespace(&p))
+    res = jsonParseValue(&p);
+  jsvStringIteratorFree(&p.it);
   jsvUnLock(str);
-  JsVar *res = jswrap_json_parse_internal();
-  jslKill();
-  jslSetLex(oldLex);
   return res;
 }
 
+#ifndef SAVE_ON_FLASH
+#define JSON_PARSER_BUFFER_NAME JS_HIDDEN_CHAR_STR"buf" // data we haven't been able to parse yet
+#define JSON_PARSER_CALLBACK_NAME JS_HIDDEN_CHAR_STR"cb" // function to call with each value
+#define JSON_PARSER_INDEX_NAME JS_HIDDEN_CHAR_STR"idx" // if we're in a top-level array, the index of the next element
+#define JSON_PARSER_SCAN_NAME JS_HIDDEN_CHAR_STR"scn" // how far jsonScanValue got through an incomplete value in the buffer
+#define JSON_PARSER_SCAN_STATE_NAME JS_HIDDEN_CHAR_STR"sst" // jsonScanValue's depth and state at JSON_PARSER_SCAN_NAME
+#define JSON_PARSER_PENDING_NAME JS_HIDDEN_CHAR_STR"pnd" // while the callback is running, data written to us from it
+#define JSON_PARSER_ENDED_NAME JS_HIDDEN_CHAR_STR"end" // set if end() was called from the callback
+
+/*JSON{
+  "type" : "class",
+  "class" : "JSONParser",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+A streaming JSON parser, created with `JSON.parser(...)`
+ */
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "JSON",
+  "name" : "parser",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_json_parser",
+  "params" : [
+    ["callback","JsVar","A function to call with `(value, index)` for each value that is parsed"]
+  ],
+  "return" : ["JsVar","A `JSONParser` object"],
+  "return_object" : "JSONParser"
+}
+Create a parser for JSON that arrives in chunks (for instance from an HTTP
+request or Serial port). Call `.write(chunk)` as data arrives, and `.end()`
+when there is no more.
+
+`callback` is called with each top-level value as soon as it has been received
+(so newline-separated JSON works fine). If the top-level value is an array,
+`callback` is called with each *element* of it along with its index, so large
+arrays of records can be handled without having the whole array (or all of its
+text) in memory at once.
+
+```
+var p = JSON.parser(function(value, index) {
+  print(index, value);
+});
+p.write('[{"a":1},{"a"');
+p.write(':2}]');
+p.end();
+```
+ */
+JsVar *jswrap_json_parser(JsVar *callback) {
+  if (!jsvIsFunction(callback)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a callback function, got %t", callback);
+    return 0;
+  }
+  JsVar *parser = jspNewObject(0, "JSONParser");
+  if (!parser) return 0;
+  jsvObjectSetChild(parser, JSON_PARSER_CALLBACK_NAME, callback);
+  return parser;
+}
+
+/// What jsonScanValue is in the middle of
+typedef enum {
+  JSON_SCAN_VALUE,
+  JSON_SCAN_DQUOTE, ///< in a "string"
+  JSON_SCAN_SQUOTE, ///< in a 'string'
+  JSON_SCAN_DQUOTE_ESCAPE, ///< after a backslash in a "string"
+  JSON_SCAN_SQUOTE_ESCAPE, ///< after a backslash in a 'string'
+  JSON_SCAN_SLASH, ///< after a '/' that may start a comment
+  JSON_SCAN_LINE_COMMENT,
+  JSON_SCAN_BLOCK_COMMENT,
+  JSON_SCAN_BLOCK_COMMENT_STAR, ///< after a '*' in a block comment
+  JSON_SCAN_STATE_MASK = 15,
+  JSON_SCAN_DEPTH_SHIFT = 4 ///< the state is stored with the number of unclosed '{'/'[' above this
+} JsonScanState;
+
+/** Check whether the object, array or string starting at 'start' in 'buf' has been
+ * completely received, without parsing it. How far we got is saved in the parser,
+ * so when more data arrives we don't scan (or parse) the start of a big value
+ * again and again. */
+static bool jsonScanValue(JsVar *parser, JsVar *buf, size_t start) {
+  size_t pos = start;
+  JsVarInt state = JSON_SCAN_VALUE;
+  JsVar *posVar = jsvObjectGetChild(parser, JSON_PARSER_SCAN_NAME, 0);
+  if (posVar) {
+    pos = (size_t)jsvGetIntegerAndUnLock(posVar);
+    state = jsvGetIntegerAndUnLock(jsvObjectGetChild(parser, JSON_PARSER_SCAN_STATE_NAME, 0));
+  }
+  JsVarInt depth = state >> JSON_SCAN_DEPTH_SHIFT;
+  state &= JSON_SCAN_STATE_MASK;
+  bool complete = false;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, buf, pos);
+  while (!complete && jsvStringIteratorHasChar(&it)) {
+    char ch = jsvStringIteratorGetCharAndNext(&it);
+    pos++;
+    switch (state) {
+    case JSON_SCAN_SLASH:
+      if (ch=='/') { state = JSON_SCAN_LINE_COMMENT; break; }
+      if (ch=='*') { state = JSON_SCAN_BLOCK_COMMENT; break; }
+      state = JSON_SCAN_VALUE;
+      // fall through - it wasn't a comment
+    case JSON_SCAN_VALUE:
+      if (ch=='"') state = JSON_SCAN_DQUOTE;
+      else if (ch=='\'') state = JSON_SCAN_SQUOTE;
+      else if (ch=='/') state = JSON_SCAN_SLASH;
+      else if (ch=='{' || ch=='[') depth++;
+      else if (ch=='}' || ch==']') complete = --depth <= 0;
+      break;
+    case JSON_SCAN_DQUOTE:
+    case JSON_SCAN_SQUOTE:
+      if (ch=='\\') state += JSON_SCAN_DQUOTE_ESCAPE-JSON_SCAN_DQUOTE;
+      else if (ch==(state==JSON_SCAN_DQUOTE ? '"' : '\'') || ch=='\n') { // a newline ends the string (with an error)
+        state = JSON_SCAN_VALUE;
+        complete = depth<=0;
+      }
+      break;
+    case JSON_SCAN_DQUOTE_ESCAPE:
+    case JSON_SCAN_SQUOTE_ESCAPE:
+      state -= JSON_SCAN_DQUOTE_ESCAPE-JSON_SCAN_DQUOTE;
+      break;
+    case JSON_SCAN_LINE_COMMENT:
+      if (ch=='\n') state = JSON_SCAN_VALUE;
+      break;
+    case JSON_SCAN_BLOCK_COMMENT:
+    case JSON_SCAN_BLOCK_COMMENT_STAR:
+      if (ch=='/' && state==JSON_SCAN_BLOCK_COMMENT_STAR) state = JSON_SCAN_VALUE;
+      else state = (ch=='*') ? JSON_SCAN_BLOCK_COMMENT_STAR : JSON_SCAN_BLOCK_COMMENT;
+      break;
+    }
+  }
+  jsvStringIteratorFree(&it);
+  if (complete) {
+    jsvObjectRemoveChild(parser, JSON_PARSER_SCAN_NAME);
+    jsvObjectRemoveChild(parser, JSON_PARSER_SCAN_STATE_NAME);
+  } else {
+    jsvObjectSetChildAndUnLock(parser, JSON_PARSER_SCAN_NAME, jsvNewFromInteger((JsVarInt)pos));
+    jsvObjectSetChildAndUnLock(parser, JSON_PARSER_SCAN_STATE_NAME, jsvNewFromInteger((depth << JSON_SCAN_DEPTH_SHIFT) | state));
+  }
+  return complete;
+}
+
+/** Parse as many values as we can from the buffered data, calling the callback for
+ * each one and then removing the text for them from the buffer. If !ended we
+ * just stop when we run out of data, as the rest may arrive later. */
+static void jswrap_jsonparser_process(JsVar *parser, bool ended) {
+  JsVar *buf = jsvObjectGetChild(parser, JSON_PARSER_BUFFER_NAME, 0);
+  if (!buf) buf = jsvNewFromEmptyString();
+  JsVar *callback = jsvObjectGetChild(parser, JSON_PARSER_CALLBACK_NAME, 0);
+  JsVarInt index = -1;
+  JsVar *indexVar = jsvObjectGetChild(parser, JSON_PARSER_INDEX_NAME, 0);
+  if (indexVar) index = jsvGetIntegerAndUnLock(indexVar);
+  size_t consumed = 0; // how many characters have been fully dealt with
+  JsonParser p;
+  jsonParserNew(&p, buf, !ended);
+  while (!jspHasError()) {
+    if (!jsonSkipWhitespace(&p)) break;
+    if (index<0) {
+      if (!p.ch) break; // all done
+      if (p.ch=='[') {
+        // top-level array - we'll return each element
+        jsonNextCh(&p);
+        index = 0;
+        consumed = jsvStringIteratorGetIndex(&p.it);
+        continue;
+      }
+    } else {
+      if (p.ch==']') {
+        jsonNextCh(&p);
+        index = -1;
+        consumed = jsvStringIteratorGetIndex(&p.it);
+        continue;
+      }
+      if (index>0) {
+        if (!jsonMatch(&p, ',')) break;
+        if (p.ch==']') continue; // trailing comma
+      }
+    }
+    // Don't try to parse a big value until we know we have all of it
+    if (!ended && (p.ch=='{' || p.ch=='[' || p.ch=='"' || p.ch=='\'') &&
+        !jsonScanValue(parser, buf, jsvStringIteratorGetIndex(&p.it)))
+      break;
+    JsVar *value = jsonParseValue(&p);
+    if (!value) break;
+    if (!p.ch && !ended) {
+      // The value ends at the end of the data - it may be a number that's not finished yet
+      jsvUnLock(value);
+      p.incomplete = true;
+      break;
+    }
+    consumed = jsvStringIteratorGetIndex(&p.it);
+    JsVar *args[2] = { value, index>=0 ? jsvNewFromInteger(index) : 0 };
+    jsvUnLock(jspExecuteFunction(callback, parser, 2, args));
+    jsvUnLockMany(2, args);
+    if (index>=0) index++;
+  }
+  jsvStringIteratorFree(&p.it);
+  jsvUnLock(callback);
+  if (jspHasError() || ended) {
+    // start afresh
+    jsvObjectRemoveChild(parser, JSON_PARSER_BUFFER_NAME);
+    jsvObjectRemoveChild(parser, JSON_PARSER_INDEX_NAME);
+    jsvObjectRemoveChild(parser, JSON_PARSER_SCAN_NAME);
+    jsvObjectRemoveChild(parser, JSON_PARSER_SCAN_STATE_NAME);
+  } else {
+    // keep only what we couldn't parse
+    if (consumed) {
+      jsvObjectSetChildAndUnLock(parser, JSON_PARSER_BUFFER_NAME, jsvNewFromStringVar(buf, consumed, JSVAPPENDSTRINGVAR_MAXLENGTH));
+      JsVar *posVar = jsvObjectGetChild(parser, JSON_PARSER_SCAN_NAME, 0);
+      if (posVar) // the value we were scanning has moved down too
+        jsvObjectSetChildAndUnLock(parser, JSON_PARSER_SCAN_NAME, jsvNewFromInteger(jsvGetIntegerAndUnLock(posVar) - (JsVarInt)consumed));
+    } else
+      jsvObjectSetChild(parser, JSON_PARSER_BUFFER_NAME, buf);
+    jsvObjectSetChildAndUnLock(parser, JSON_PARSER_INDEX_NAME, jsvNewFromInteger(index));
+  }
+  jsvUnLock(buf);
+}
+
+/// Add data to the end of the parser's buffer
+static void jswrap_jsonparser_append(JsVar *parser, JsVar *chunk) {
+  JsVar *str = jsvAsString(chunk);
+  if (!str) return;
+  JsVar *buf = jsvObjectGetChild(parser, JSON_PARSER_BUFFER_NAME, 0);
+  if (!buf) {
+    buf = jsvNewFromEmptyString();
+    jsvObjectSetChild(parser, JSON_PARSER_BUFFER_NAME, buf);
+  }
+  if (buf) jsvAppendStringVarComplete(buf, str);
+  jsvUnLock2(buf, str);
+}
+
+/** Add data and parse what we can. The callback may write to us too, but we're
+ * still part way through the buffer then - so that data is kept separately, and
+ * dealt with once we've finished. */
+static void jswrap_jsonparser_writeOrEnd(JsVar *parser, JsVar *chunk, bool ended) {
+  JsVar *pending = jsvObjectGetChild(parser, JSON_PARSER_PENDING_NAME, 0);
+  if (pending) { // called from the callback
+    JsVar *str = chunk ? jsvAsString(chunk) : 0;
+    if (str) jsvAppendStringVarComplete(pending, str);
+    if (ended) jsvObjectSetChildAndUnLock(parser, JSON_PARSER_ENDED_NAME, jsvNewFromBool(true));
+    jsvUnLock2(str, pending);
+    return;
+  }
+  if (chunk) jswrap_jsonparser_append(parser, chunk);
+  while (true) {
+    jsvObjectSetChildAndUnLock(parser, JSON_PARSER_PENDING_NAME, jsvNewFromEmptyString());
+    jswrap_jsonparser_process(parser, ended);
+    pending = jsvObjectGetChild(parser, JSON_PARSER_PENDING_NAME, 0);
+    jsvObjectRemoveChild(parser, JSON_PARSER_PENDING_NAME);
+    ended = jsvGetBoolAndUnLock(jsvObjectGetChild(parser, JSON_PARSER_ENDED_NAME, 0));
+    jsvObjectRemoveChild(parser, JSON_PARSER_ENDED_NAME);
+    bool more = !jspHasError() && (ended || (pending && jsvGetStringLength(pending)));
+    if (more) jswrap_jsonparser_append(parser, pending);
+    jsvUnLock(pending);
+    if (!more) return;
+  }
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONParser",
+  "name" : "write",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_jsonparser_write",
+  "params" : [
+    ["chunk","JsVar","The next chunk of JSON text"]
+  ]
+}
+Add more data to the parser. The callback is called for any values that have
+now been completely received.
+ */
+void jswrap_jsonparser_write(JsVar *parser, JsVar *chunk) {
+  jswrap_jsonparser_writeOrEnd(parser, chunk, false);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONParser",
+  "name" : "end",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_jsonparser_end",
+  "params" : [
+    ["chunk","JsVar","[optional] The final chunk of JSON text"]
+  ]
+}
+Signal that there is no more data. Any value still buffered is parsed, and
+an exception is thrown if the data was incomplete.
+ */
+void jswrap_jsonparser_end(JsVar *parser, JsVar *chunk) {
+  jswrap_jsonparser_writeOrEnd(parser, chunk, true);
+}
+#endif
+
 /* This is like jsfGetJSONWithCallback, but handles ONLY functions (and does not print the initial 'function' text) */
 void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data) {
   assert(jsvIsFunction(var));
@@ -481,13 +988,48 @@ void jsfGetJSONWithCallback(JsVar *var, JsVar *varName, JSONFlags flags, const c
   var->flags &= ~JSV_IS_RECURSING;
 }
 
+/** jsfGetJSONWithCallback produces its output a few characters at a time, so
+ * we gather it up in a buffer and pass it on in bigger chunks */
+#define JSON_WRITER_BUFFER_SIZE 64
+typedef struct {
+  vcbprintf_callback callback; ///< Where the buffered data goes
+  void *callbackData;
+  size_t len; ///< Characters in buf
+  char buf[JSON_WRITER_BUFFER_SIZE+1];
+} JsonWriter;
+
+static void jsonWriterFlush(JsonWriter *w) {
+  if (!w->len) return;
+  w->buf[w->len] = 0;
+  w->callback(w->buf, w->callbackData);
+  w->len = 0;
+}
+
+static void jsonWriterCallback(const char *str, void *user_data) {
+  JsonWriter *w = (JsonWriter*)user_data;
+  while (*str) {
+    if (w->len >= JSON_WRITER_BUFFER_SIZE) jsonWriterFlush(w);
+    w->buf[w->len++] = *(str++);
+  }
+}
+
+/// Like jsfGetJSONWithCallback, but the output is buffered
+void jsfGetJSONWithBufferedCallback(JsVar *var, JSONFlags flags, const char *whitespace, vcbprintf_callback user_callback, void *user_data) {
+  JsonWriter w;
+  w.callback = user_callback;
+  w.callbackData = user_data;
+  w.len = 0;
+  jsfGetJSONWithCallback(var, NULL, flags, whitespace, jsonWriterCallback, &w);
+  jsonWriterFlush(&w);
+}
+
 void jsfGetJSONWhitespace(JsVar *var, JsVar *result, JSONFlags flags, const char *whitespace) {
   assert(jsvIsString(result));
   JsvStringIterator it;
   jsvStringIteratorNew(&it, result, 0);
   jsvStringIteratorGotoEnd(&it);
 
-  jsfGetJSONWithCallback(var, NULL, flags, whitespace, (vcbprintf_callback)&jsvStringIteratorPrintfCallback, &it);
+  jsfGetJSONWithBufferedCallback(var, flags, whitespace, (vcbprintf_callback)&jsvStringIteratorPrintfCallback, &it);
 
   jsvStringIteratorFree(&it);
 }
@@ -497,7 +1039,7 @@ void jsfGetJSON(JsVar *var, JsVar *result, JSONFlags flags) {
 }
 
 void jsfPrintJSON(JsVar *var, JSONFlags flags) {
-  jsfGetJSONWithCallback(var, NULL, flags, 0, (vcbprintf_callback)jsiConsolePrintString, 0);
+  jsfGetJSONWithBufferedCallback(var, flags, 0, (vcbprintf_callback)jsiConsolePrintString, 0);
 }
 void jsfPrintJSONForFunction(JsVar *var, JSONFlags flags) {
   jsfGetJSONForFunctionWithCallback(var, flags, (vcbprintf_callback)jsiConsolePrintString, 0);
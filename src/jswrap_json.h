@@ -16,6 +16,9 @@
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space);
 JsVar *jswrap_json_parse_ext(JsVar *v, bool throwExceptions);
 JsVar *jswrap_json_parse(JsVar *v);
+JsVar *jswrap_json_parser(JsVar *callback);
+void jswrap_jsonparser_write(JsVar *parser, JsVar *chunk);
+void jswrap_jsonparser_end(JsVar *parser, JsVar *chunk);
 
 typedef enum {
   JSON_NONE,
@@ -38,6 +41,9 @@ typedef enum {
   JSON_INDENT            = 4096, // MUST BE THE LAST ENTRY IN JSONFlags - we use this to count the amount of indents
 } JSONFlags;
 
+/// The flags used for JSON.stringify
+#define JSON_STRINGIFY_FLAGS (JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY|JSON_JSON_COMPATIBILE|JSON_ALLOW_TOJSON)
+
 /* This is like jsfGetJSONWithCallback, but handles ONLY functions (and does not print the initial 'function' text) */
 void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data);
 /* Dump to JSON, using the given callbacks for printing data
@@ -48,6 +54,9 @@ flags = control how stuff is rendered
 */
 void jsfGetJSONWithCallback(JsVar *var, JsVar *varName, JSONFlags flags, const char *whitespace, vcbprintf_callback user_callback, void *user_data);
 
+/* Like jsfGetJSONWithCallback, but output is buffered so user_callback gets called with bigger chunks */
+void jsfGetJSONWithBufferedCallback(JsVar *var, JSONFlags flags, const char *whitespace, vcbprintf_callback user_callback, void *user_data);
+
 /* Convenience function for using jsfGetJSONWithCallback - print to var */
 void jsfGetJSONWhitespace(JsVar *var, JsVar *result, JSONFlags flags, const char *whitespace);
 /* Convenience function for using jsfGetJSONWithCallback - print to var */
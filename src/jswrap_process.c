@@ -146,6 +146,9 @@ Run a Garbage Collection pass, and return an object containing information on me
 * `history` : Memory used for command history - that is freed if memory is low. Note that this is INCLUDED in the figure for 'free'
 * `gc`      : Memory freed during the GC pass
 * `gctime`  : Time taken for GC pass (in milliseconds)
+* `gcpause` : The longest time (in milliseconds) that execution was stopped for Garbage Collection since `process.memory()` was last called (not including `gctime`)
+* `freeRun` : The largest number of free blocks that are next to each other. Big Strings and ArrayBuffers need this many blocks to be allocated as one (+1 for a header)
+* `fragmentation` : How fragmented free memory is as a percentage - 0 if all free blocks are next to each other. See `E.defrag()`
 * `blocksize` : Size of a block (variable) in bytes
 * `stackEndAddress` : (on ARM) the address (that can be used with peek/poke/etc) of the END of the stack. The stack grows down, so unless you do a lot of recursion the bytes above this can be used.
 * `flash_start`      : (on ARM) the address of the start of flash memory (usually `0x8000000`)
@@ -158,6 +161,9 @@ Memory units are specified in 'blocks', which are around 16 bytes each (dependin
 **Note:** To find free areas of flash memory, see `require('Flash').getFree()`
  */
 JsVar *jswrap_process_memory() {
+#ifdef JSV_GC_INCREMENTAL_VARS
+  JsSysTime gcPause = jsvGetGarbageCollectMaxPause();
+#endif
   JsSysTime time1 = jshGetSystemTime();
   int gc = jsvGarbageCollect();
   JsSysTime time2 = jshGetSystemTime();
@@ -177,6 +183,14 @@ JsVar *jswrap_process_memory() {
     jsvObjectSetChildAndUnLock(obj, "history", jsvNewFromInteger((JsVarInt)history));
     jsvObjectSetChildAndUnLock(obj, "gc", jsvNewFromInteger((JsVarInt)gc));
     jsvObjectSetChildAndUnLock(obj, "gctime", jsvNewFromFloat(jshGetMillisecondsFromTime(time2-time1)));
+#ifdef JSV_GC_INCREMENTAL_VARS
+    jsvGetGarbageCollectMaxPause(); // don't include the GC we just did
+    jsvObjectSetChildAndUnLock(obj, "gcpause", jsvNewFromFloat(jshGetMillisecondsFromTime(gcPause)));
+#endif
+    unsigned int largestFreeRun, fragmentation;
+    jsvGetFragmentation(&largestFreeRun, &fragmentation);
+    jsvObjectSetChildAndUnLock(obj, "freeRun", jsvNewFromInteger((JsVarInt)largestFreeRun));
+    jsvObjectSetChildAndUnLock(obj, "fragmentation", jsvNewFromInteger((JsVarInt)fragmentation));
     jsvObjectSetChildAndUnLock(obj, "blocksize", jsvNewFromInteger(sizeof(JsVar)));
 
 #ifdef ARM
@@ -19,252 +19,582 @@
 #include "jslex.h"
 #include "jsinteractive.h"
 
-/* TODO:
+/* Regular expressions are compiled into a small bytecode program when the
+ * RegExp is created, and that's stored in a hidden string on the RegExp object.
  *
- * Handling of 'global' flag especially
- * lastIndex support?
+ * The program is run with a 'Pike VM': every way the program could match is
+ * stepped forward together, one character of the input at a time. There's no
+ * backtracking, so match time is linear in the length of the input however the
+ * expression is written. See https://swtch.com/~rsc/regexp/regexp2.html
  */
 
 #define MAX_GROUPS 9
-#define NO_RANGE  256
+#define REGEXP_PROGRAM_NAME JS_HIDDEN_CHAR_STR"prg" // the compiled program (RegExpHeader followed by bytecode)
+#define RE_MAX_CODE 0x7FFF ///< Jumps are signed 16 bit offsets
+#define RE_UNSET ((size_t)-1) ///< Capture slot that has not been set
+
+typedef enum {
+  // these need a character
+  RE_CHAR,  ///< [op,c] match character c
+  RE_ANY,   ///< [op] match any character
+  RE_SET,   ///< [op,n,items..] match one of n 3 byte RegExpSetItems
+  RE_NSET,  ///< [op,n,items..] match anything but the n RegExpSetItems
+  RE_CLASS, ///< [op,c] match a class, c is 'd','s','w' (or uppercase to invert)
+  // these don't
+  RE_BOL,   ///< [op] start of string
+  RE_EOL,   ///< [op] end of string
+  RE_SAVE,  ///< [op,n] store the current position in capture slot n
+  RE_SPLIT, ///< [op,x,x,y,y] carry on at both offsets, preferring x
+  RE_JMP,   ///< [op,x,x] carry on at offset x
+  RE_MATCH, ///< [op] we have a match
+} RegExpOp;
+
+typedef enum {
+  RE_SET_RANGE, ///< [item,lo,hi] characters lo to hi inclusive
+  RE_SET_CLASS, ///< [item,c,0] a class, as for RE_CLASS
+} RegExpSetItem;
 
 typedef struct {
-  JsVar *sourceStr;
-  size_t startIndex;
+  uint16_t codeLength;   ///< bytes of bytecode after this header
+  uint16_t instructions; ///< instructions in the bytecode (the most threads we can have)
+  unsigned char groups;  ///< capturing groups
   bool ignoreCase;
-  bool rangeMatch;
-  short rangeFirstChar;
-  int groups;
-  size_t groupStart[MAX_GROUPS];
-  size_t groupEnd[MAX_GROUPS];
-} matchInfo;
+} RegExpHeader;
 
-static JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info);
+typedef struct {
+  const char *re;          ///< The next character of the regex
+  unsigned char *code;     ///< Where to write bytecode, or 0 if we're just working out its size
+  size_t length;           ///< Bytes of bytecode so far
+  unsigned int instructions;
+  unsigned char groups;
+  bool ignoreCase;
+  bool error;              ///< An exception has been thrown
+} RegExpCompiler;
 
-static JsVar *matchfound(JsvStringIterator *txtIt, matchInfo info) {
-  JsVar *rmatch = jsvNewEmptyArray();
-  size_t endIndex = jsvStringIteratorGetIndex(txtIt);
-  JsVar *matchStr = jsvNewFromStringVar(info.sourceStr, info.startIndex, endIndex-info.startIndex);
-  jsvSetArrayItem(rmatch, 0, matchStr);
-  jsvUnLock(matchStr);
-  int i;
-  for (i=0;i<info.groups;i++) {
-    matchStr = jsvNewFromStringVar(info.sourceStr, info.groupStart[i], info.groupEnd[i]-info.groupStart[i]);
-    jsvSetArrayItem(rmatch, i+1, matchStr);
-    jsvUnLock(matchStr);
-  }
-  jsvObjectSetChildAndUnLock(rmatch, "index", jsvNewFromInteger((JsVarInt)info.startIndex));
-  jsvObjectSetChild(rmatch, "input", info.sourceStr);
+static void reError(RegExpCompiler *c, const char *msg) {
+  if (!c->error) jsExceptionHere(JSET_ERROR, "%s", msg);
+  c->error = true;
+}
 
-  return rmatch;
+static void reEmit(RegExpCompiler *c, int byte) {
+  if (c->code) c->code[c->length] = (unsigned char)byte;
+  c->length++;
 }
 
-// No match found, so search to end of regex to see if there's an '|'
-static JsVar *nomatchfound(char *regexp, matchInfo info) {
-  if (!jspCheckStackPosition()) return 0;
-  // TODO: | inside a group?
-  while (*regexp && *regexp!='|') {
-    if (*regexp=='\\') {
-      regexp++; // end of regex after escape char!
-      if (!*regexp) return 0;
-    }
-    regexp++;
-  }
-  if (*regexp != '|') return 0;
-  regexp++;
+static void reEmitOp(RegExpCompiler *c, RegExpOp op) {
+  reEmit(c, op);
+  c->instructions++;
+}
 
-  JsvStringIterator txtIt;
-  jsvStringIteratorNew(&txtIt,  info.sourceStr, info.startIndex);
-  JsVar *rmatch = matchhere(regexp, &txtIt, info);
-  jsvStringIteratorFree(&txtIt);
-  return rmatch;
+/// Write the offset (at 'at') for the instruction at 'from' to jump to 'to'
+static void reSetOffset(RegExpCompiler *c, size_t at, size_t from, size_t to) {
+  if (!c->code) return;
+  int offset = (int)to - (int)from;
+  c->code[at] = (unsigned char)offset;
+  c->code[at+1] = (unsigned char)(offset>>8);
 }
 
-/* match: search for regexp anywhere in text */
-static JsVar *match(char *regexp, JsVar *str, size_t startIndex, bool ignoreCase) {
-  matchInfo info;
-  info.sourceStr = str;
-  info.startIndex = startIndex;
-  info.ignoreCase = ignoreCase;
-  info.rangeMatch = false;
-  info.rangeFirstChar = NO_RANGE;
-  info.groups = 0;
-
-  JsVar *rmatch;
-  JsvStringIterator txtIt, txtIt2;
-  jsvStringIteratorNew(&txtIt, str, startIndex);
-  /* must look even if string is empty */
-  jsvStringIteratorClone(&txtIt2, &txtIt);
-  rmatch = matchhere(regexp, &txtIt2, info);
-  jsvStringIteratorFree(&txtIt2);
-  jsvStringIteratorNext(&txtIt);
-  while (!rmatch && jsvStringIteratorHasChar(&txtIt)) {
-    info.startIndex++;
-    jsvStringIteratorClone(&txtIt2, &txtIt);
-    rmatch = matchhere(regexp, &txtIt2, info);
-    jsvStringIteratorFree(&txtIt2);
-    jsvStringIteratorNext(&txtIt);
-  }
-  jsvStringIteratorFree(&txtIt);
-  return rmatch;
+static int reGetOffset(const unsigned char *code) {
+  return (int16_t)(code[0] | (code[1]<<8));
 }
 
-/* Match one character. Doesn't modify txtIt, returns length of regexp char in *length  */
-bool matchcharacter(char *regexp, JsvStringIterator *txtIt, int *length, matchInfo *info) {
-  *length = 1;
-  char ch = jsvStringIteratorGetChar(txtIt);
-  if (regexp[0]=='.') return true;
-  if (regexp[0]=='[') { // Character set (any char inside '[]')
-    info->rangeMatch = true;
-    bool inverted = regexp[1]=='^';
-    if (inverted) (*length)++;
-    bool matchAny = false;
-    while (regexp[*length] && regexp[*length]!=']') {
-      int matchLen;
-      if (regexp[*length]=='.') { // https://github.com/espruino/Espruino/issues/1948
-        matchAny |= ch=='.';
-        (*length)++;
-      } else {
-        matchAny |= matchcharacter(&regexp[*length], txtIt, &matchLen, info);
-        (*length) += matchLen;
+/// Insert a split at 'at' to the given targets (which are positions after the insertion)
+static void reInsertSplit(RegExpCompiler *c, size_t at, size_t x, size_t y) {
+  if (c->code) memmove(&c->code[at+5], &c->code[at], c->length-at);
+  c->length += 5;
+  c->instructions++;
+  if (c->code) c->code[at] = RE_SPLIT;
+  reSetOffset(c, at+1, at, x);
+  reSetOffset(c, at+3, at, y);
+}
+
+static void reEmitJump(RegExpCompiler *c, size_t to) {
+  size_t at = c->length;
+  reEmitOp(c, RE_JMP);
+  reEmit(c, 0);
+  reEmit(c, 0);
+  reSetOffset(c, at+1, at, to);
+}
+
+static void reCompileAlternatives(RegExpCompiler *c);
+
+/// Parse the character after a '\'. Returns the character, or sets *cls for classes like \d
+static char reParseEscape(RegExpCompiler *c, char *cls) {
+  *cls = 0;
+  char ch = *c->re;
+  if (!ch) return '\\'; // '\' at the end of the regex
+  c->re++;
+  switch (ch) {
+    case 'd': case 'D': case 's': case 'S': case 'w': case 'W':
+      *cls = ch;
+      return 0;
+    case 'f': return 0x0C;
+    case 'b': return 0x08;
+    case 'n': return 0x0A;
+    case 'r': return 0x0D;
+    case 't': return 0x09;
+    case 'v': return 0x0B;
+    case '0': return 0;
+    case 'x':
+      if (c->re[0] && c->re[1]) {
+        ch = (char)hexToByte(c->re[0], c->re[1]);
+        c->re += 2;
       }
-    }
-    if (regexp[*length]==']') {
-      (*length)++;
+      return ch;
+  }
+  if (ch>='1' && ch<='9')
+    reError(c, "Backreferences not supported");
+  // fallback to the quoted character (e.g. /,-,? etc.)
+  return ch;
+}
+
+static void reCompileSet(RegExpCompiler *c) {
+  size_t start = c->length;
+  bool inverted = *c->re=='^';
+  if (inverted) c->re++;
+  reEmitOp(c, inverted ? RE_NSET : RE_SET);
+  reEmit(c, 0); // item count, filled in below
+  unsigned int items = 0;
+  while (*c->re && *c->re!=']' && !c->error) {
+    char cls = 0;
+    char lo = *(c->re++);
+    if (lo=='\\') lo = reParseEscape(c, &cls);
+    if (cls) {
+      reEmit(c, RE_SET_CLASS);
+      reEmit(c, cls);
+      reEmit(c, 0);
     } else {
-      jsExceptionHere(JSET_ERROR, "Unfinished character set in RegEx");
-      return false;
+      char hi = lo;
+      if (c->re[0]=='-' && c->re[1] && c->re[1]!=']') { // Character set range
+        c->re++;
+        hi = *(c->re++);
+        if (hi=='\\') hi = reParseEscape(c, &cls);
+        if (cls || (unsigned char)hi < (unsigned char)lo)
+          reError(c, "Invalid character range in RegEx");
+      }
+      reEmit(c, RE_SET_RANGE);
+      reEmit(c, lo);
+      reEmit(c, hi);
+    }
+    items++;
+  }
+  if (*c->re!=']') {
+    reError(c, "Unfinished character set in RegEx");
+    return;
+  }
+  c->re++;
+  if (items>255) reError(c, "Character set too large in RegEx");
+  else if (c->code) c->code[start+1] = (unsigned char)items;
+}
+
+static void reCompileGroup(RegExpCompiler *c) {
+  int group = -1;
+  if (c->re[0]=='?') {
+    if (c->re[1]!=':') {
+      reError(c, "Only (?: groups supported in RegEx");
+      return;
+    }
+    c->re += 2;
+  } else {
+    if (c->groups>=MAX_GROUPS) {
+      reError(c, "Too many groups in RegEx");
+      return;
     }
-    info->rangeMatch = false;
-    return matchAny != inverted;
-  }
-  char cH = regexp[0];
-  if (cH=='\\') { // escape character
-    *length = 2;
-    // fallback to the quoted character (e.g. /,-,? etc.)
-    cH = regexp[1];
-    // missing quite a few here
-    // https://developer.mozilla.org/en-US/docs/Web/JavaScript/Guide/Regular_Expressions
-    if (cH=='d') return isNumeric(ch);
-    if (cH=='D') return !isNumeric(ch);
-    if (cH=='f') { cH=0x0C; goto haveCode; }
-    if (cH=='b') { cH=0x08; goto haveCode; }
-    if (cH=='n') { cH=0x0A; goto haveCode; }
-    if (cH=='r') { cH=0x0D; goto haveCode; }
-    if (cH=='s') return isWhitespace(ch);
-    if (cH=='S') return !isWhitespace(ch);
-    if (cH=='t') { cH=0x09; goto haveCode; }
-    if (cH=='v') { cH=0x0B; goto haveCode; }
-    if (cH=='w') return isNumeric(ch) || isAlpha(ch) || ch=='_';
-    if (cH=='W') return !(isNumeric(ch) || isAlpha(ch) || ch=='_');
-    if (cH=='0') { cH=0; goto haveCode; }
-    if (cH>='1' && cH<='9') {
-      jsExceptionHere(JSET_ERROR, "Backreferences not supported");
+    group = ++c->groups;
+    reEmitOp(c, RE_SAVE);
+    reEmit(c, group*2);
+  }
+  if (!jspCheckStackPosition()) {
+    c->error = true;
+    return;
+  }
+  reCompileAlternatives(c);
+  if (*c->re!=')') {
+    reError(c, "Unfinished group in RegEx");
+    return;
+  }
+  c->re++;
+  if (group>=0) {
+    reEmitOp(c, RE_SAVE);
+    reEmit(c, group*2+1);
+  }
+}
+
+/// Compile a single item, return false if it's not something that can be repeated
+static bool reCompileAtom(RegExpCompiler *c) {
+  char cls = 0;
+  char ch = *(c->re++);
+  switch (ch) {
+    case '^': reEmitOp(c, RE_BOL); return false;
+    case '$': reEmitOp(c, RE_EOL); return false;
+    case '.': reEmitOp(c, RE_ANY); return true;
+    case '[': reCompileSet(c); return true;
+    case '(': reCompileGroup(c); return true;
+    case '*': case '+': case '?':
+      reError(c, "Nothing to repeat in RegEx");
       return false;
-      // we could implement this if needed by matching against info->groupStart/End
+    case '\\':
+      ch = reParseEscape(c, &cls);
+      if (cls) {
+        reEmitOp(c, RE_CLASS);
+        reEmit(c, cls);
+        return true;
+      }
+      break;
+  }
+  reEmitOp(c, RE_CHAR);
+  reEmit(c, c->ignoreCase ? jsvStringCharToLower(ch) : ch);
+  return true;
+}
+
+/// Parse '{n}', '{n,}' or '{n,m}'. Returns false (and doesn't move on) if it's not one of those
+static bool reParseCount(RegExpCompiler *c, int *min, int *max) {
+  const char *re = c->re+1;
+  if (!isNumeric(*re)) return false;
+  *min = 0;
+  while (isNumeric(*re) && *min<=RE_MAX_CODE) *min = *min*10 + *(re++) - '0';
+  *max = *min;
+  if (*re==',') {
+    re++;
+    *max = -1;
+    if (isNumeric(*re)) {
+      *max = 0;
+      while (isNumeric(*re) && *max<=RE_MAX_CODE) *max = *max*10 + *(re++) - '0';
+    }
+  }
+  if (*re!='}') return false;
+  c->re = re+1;
+  return true;
+}
+
+/// Repeat the code from 'start' (which has 'instructions' instructions in it) between min and max (-1 = no limit) times
+static void reRepeat(RegExpCompiler *c, size_t start, unsigned int instructions, int min, int max, bool greedy) {
+  size_t length = c->length - start;
+  if (max>=0 && max<min) {
+    reError(c, "Numbers out of order in RegEx quantifier");
+    return;
+  }
+  if (max==0) { // remove it completely
+    c->length = start;
+    c->instructions -= instructions;
+    return;
+  }
+  // Make the copies we need, then turn the optional ones into loops/splits
+  int copies = (max<0) ? (min?min:1) : max;
+  int i;
+  for (i=1;i<copies && c->length<=RE_MAX_CODE;i++) {
+    if (c->code) memcpy(&c->code[c->length], &c->code[start], length);
+    c->length += length;
+    c->instructions += instructions;
+  }
+  if (c->length>RE_MAX_CODE) {
+    reError(c, "RegEx too large");
+    return;
+  }
+  if (max<0) {
+    size_t last = start + (size_t)(copies-1)*length;
+    if (min) { // x+ -> L1: x, SPLIT L1, L2; L2:
+      size_t at = c->length;
+      if (greedy) reInsertSplit(c, at, last, at+5);
+      else reInsertSplit(c, at, at+5, last);
+    } else { // x* -> L1: SPLIT L2, L3; L2: x; JMP L1; L3:
+      size_t end = c->length+5+3;
+      if (greedy) reInsertSplit(c, last, last+5, end);
+      else reInsertSplit(c, last, end, last+5);
+      reEmitJump(c, last);
     }
-    if (cH=='x' && regexp[2] && regexp[3]) {
-      *length = 4;
-      cH = (char)hexToByte(regexp[2],regexp[3]);
-      goto haveCode;
+  } else {
+    // x? -> SPLIT L1, L2; L1: x; L2:
+    // do the last ones first so the positions of the earlier copies don't change
+    for (i=max;i>min;i--) {
+      size_t at = start + (size_t)(i-1)*length;
+      if (greedy) reInsertSplit(c, at, at+5, at+5+length);
+      else reInsertSplit(c, at, at+5+length, at+5);
+    }
+  }
+}
+
+static void reCompileSequence(RegExpCompiler *c) {
+  while (*c->re && *c->re!='|' && *c->re!=')' && !c->error) {
+    size_t start = c->length;
+    unsigned int instructions = c->instructions;
+    if (!reCompileAtom(c) || c->error) continue;
+    int min = 0, max = -1;
+    char ch = *c->re;
+    if (ch=='*') c->re++;
+    else if (ch=='+') { c->re++; min = 1; }
+    else if (ch=='?') { c->re++; max = 1; }
+    else if (ch!='{' || !reParseCount(c, &min, &max)) continue;
+    bool greedy = true;
+    if (*c->re=='?') { // lazy
+      c->re++;
+      greedy = false;
     }
+    reRepeat(c, start, c->instructions-instructions, min, max, greedy);
   }
-haveCode:
-  if (info->rangeMatch && regexp[*length] == '-' && regexp[1+*length] != ']') { // Character set range start
-    info->rangeFirstChar = cH;
-    (*length)++;
-    int matchLen;
-    bool match = matchcharacter(&regexp[*length], txtIt, &matchLen, info);
-    (*length)+=matchLen;
-    return match;
-  }
-  if (info->ignoreCase) {
-    ch = jsvStringCharToLower(ch);
-    cH = jsvStringCharToLower(cH);
-  }
-  if (info->rangeFirstChar != NO_RANGE) { // Character set range
-    char cL = (char)info->rangeFirstChar;
-    if (info->ignoreCase) {
-      cL = jsvStringCharToLower(cL);
+}
+
+/* a|b|c -> SPLIT L1, L2; L1: a; JMP end; L2: SPLIT L3, L4; L3: b; JMP end; L4: c; end:
+ * While compiling, each JMP's offset points back to the previous JMP so they can all be filled in at the end */
+static void reCompileAlternatives(RegExpCompiler *c) {
+  size_t start = c->length;
+  size_t lastJump = 0;
+  reCompileSequence(c);
+  while (*c->re=='|' && !c->error) {
+    c->re++;
+    reInsertSplit(c, start, start+5, c->length+5+3);
+    size_t jump = c->length;
+    reEmitJump(c, lastJump ? lastJump : jump);
+    lastJump = jump;
+    start = c->length;
+    reCompileSequence(c);
+  }
+  while (lastJump && c->code) {
+    int previous = reGetOffset(&c->code[lastJump+1]);
+    reSetOffset(c, lastJump+1, lastJump, c->length);
+    lastJump = (size_t)((int)lastJump + previous);
+    if (!previous) break;
+  }
+}
+
+/** Compile the regex into code (if code==0 just work out the size). Returns
+ * false and throws an exception if the regex is invalid */
+static bool reCompile(const char *re, bool ignoreCase, RegExpHeader *header, unsigned char *code) {
+  RegExpCompiler c;
+  c.re = re;
+  c.code = code;
+  c.length = 0;
+  c.instructions = 0;
+  c.groups = 0;
+  c.ignoreCase = ignoreCase;
+  c.error = false;
+  reEmitOp(&c, RE_SAVE);
+  reEmit(&c, 0);
+  reCompileAlternatives(&c);
+  if (*c.re==')') reError(&c, "Unmatched ')' in RegEx");
+  reEmitOp(&c, RE_SAVE);
+  reEmit(&c, 1);
+  reEmitOp(&c, RE_MATCH);
+  if (c.length>RE_MAX_CODE) reError(&c, "RegEx too large");
+  header->codeLength = (uint16_t)c.length;
+  header->instructions = (uint16_t)c.instructions;
+  header->groups = c.groups;
+  header->ignoreCase = ignoreCase;
+  return !c.error;
+}
+
+/** Compile the RegExp's source and store the program on it. Returns false
+ * if it couldn't be compiled (an exception is thrown if the regex was invalid) */
+static bool jswrap_regexp_compile(JsVar *parent) {
+  JsVar *source = jsvObjectGetChild(parent, "source", 0);
+  if (!jsvIsString(source)) {
+    jsvUnLock(source);
+    return false;
+  }
+  size_t sourceLen = jsvGetStringLength(source);
+  if (sourceLen+256 > jsuGetFreeStack()) {
+    jsvUnLock(source);
+    jsExceptionHere(JSET_ERROR, "Not enough free stack to compile RegEx");
+    return false;
+  }
+  char *re = (char *)alloca(sourceLen+1);
+  jsvGetString(source, re, sourceLen+1);
+  jsvUnLock(source);
+  RegExpHeader header;
+  bool ignoreCase = jswrap_regexp_hasFlag(parent,'i');
+  if (!reCompile(re, ignoreCase, &header, 0))
+    return false;
+  size_t programLen = sizeof(RegExpHeader)+header.codeLength;
+  if (programLen+256 > jsuGetFreeStack()) {
+    jsExceptionHere(JSET_ERROR, "Not enough free stack to compile RegEx");
+    return false;
+  }
+  char *ptr = (char *)alloca(programLen);
+  reCompile(re, ignoreCase, &header, (unsigned char*)ptr+sizeof(RegExpHeader));
+  memcpy(ptr, &header, sizeof(RegExpHeader));
+  JsVar *program = jsvNewStringOfLength((unsigned int)programLen, ptr);
+  if (!program) return false; // out of memory
+  jsvObjectSetChildAndUnLock(parent, REGEXP_PROGRAM_NAME, program);
+  return true;
+}
+
+typedef struct {
+  unsigned int count; ///< Threads in the list
+  uint16_t *pc;       ///< Program counter of each thread
+  size_t *caps;       ///< Capture slots for each thread
+  uint16_t *index;    ///< For each program counter, where it is in 'pc' (if it's there at all)
+} RegExpThreadList;
+
+typedef struct {
+  const unsigned char *code;
+  unsigned int slots; ///< capture slots per thread
+  size_t position;    ///< index in the string
+  size_t length;      ///< length of the string
+} RegExpVM;
+
+/// Add a thread at pc to the list, following any jumps/splits/saves right away
+static void reAddThread(RegExpVM *vm, RegExpThreadList *l, unsigned int pc, size_t *caps) {
+  // If this pc is already in the list then a higher priority thread got there first
+  unsigned int i = l->index[pc];
+  if (i<l->count && l->pc[i]==pc) return;
+  i = l->count++;
+  l->index[pc] = (uint16_t)i;
+  l->pc[i] = (uint16_t)pc;
+  const unsigned char *code = &vm->code[pc];
+  switch ((RegExpOp)code[0]) {
+    case RE_JMP:
+      reAddThread(vm, l, (unsigned int)((int)pc+reGetOffset(&code[1])), caps);
+      break;
+    case RE_SPLIT:
+      if (!jspCheckStackPosition()) return;
+      reAddThread(vm, l, (unsigned int)((int)pc+reGetOffset(&code[1])), caps);
+      reAddThread(vm, l, (unsigned int)((int)pc+reGetOffset(&code[3])), caps);
+      break;
+    case RE_SAVE: {
+      size_t old = caps[code[1]];
+      caps[code[1]] = vm->position;
+      reAddThread(vm, l, pc+2, caps);
+      caps[code[1]] = old;
+      break;
     }
-    info->rangeFirstChar = NO_RANGE;
-    return (ch >= cL && ch <= cH && cL < cH);
+    case RE_BOL:
+      if (vm->position==0) reAddThread(vm, l, pc+1, caps);
+      break;
+    case RE_EOL:
+      if (vm->position==vm->length) reAddThread(vm, l, pc+1, caps);
+      break;
+    default: // this instruction needs a character (or it's a match), so the thread waits here
+      memcpy(&l->caps[i*vm->slots], caps, vm->slots*sizeof(size_t));
+      break;
   }
-  return cH==ch;
 }
 
-/* matchhere: search for regexp at beginning of text. Only handles up to '|' character. Modifies txtIt */
-static JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info) {
-  if (jspIsInterrupted()) return 0;
-  if (regexp[0] == '\0' || // end of regex
-      regexp[0] == '|') // end of this 'or' section of regex
-    return matchfound(txtIt, info);
-  if (regexp[0] == '^') { // must be beginning of String
-    if (jsvStringIteratorGetIndex(txtIt)!=0)
-      return 0; // no match
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+1, txtIt, info);
-  }
-  // Marker for end of String
-  if (regexp[0] == '$') {
-    if (!jsvStringIteratorHasChar(txtIt))
-      return matchhere(regexp+1, txtIt, info);
+static bool reMatchClass(char cls, char ch) {
+  bool match;
+  if (cls=='d' || cls=='D') match = isNumeric(ch);
+  else if (cls=='s' || cls=='S') match = isWhitespace(ch);
+  else match = isNumeric(ch) || isAlpha(ch) || ch=='_';
+  return (cls>='a') ? match : !match;
+}
+
+static bool reMatchSet(const unsigned char *code, char ch, bool ignoreCase) {
+  unsigned int i, items = code[1];
+  const unsigned char *item = &code[2];
+  unsigned char c = (unsigned char)ch;
+  unsigned char cL = (unsigned char)jsvStringCharToLower(ch);
+  unsigned char cU = (unsigned char)jsvStringCharToUpper(ch);
+  bool match = false;
+  for (i=0;i<items && !match;i++,item+=3) {
+    if (item[0]==RE_SET_CLASS)
+      match = reMatchClass((char)item[1], ch);
     else
-      return nomatchfound(regexp+1, info); // not the end, it's a fail
-  }
-  if (regexp[0] == '(') {
-    info.groupStart[info.groups] = jsvStringIteratorGetIndex(txtIt);
-    info.groupEnd[info.groups] = info.groupStart[info.groups];
-    if (info.groups<MAX_GROUPS) info.groups++;
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+1, txtIt, info);
-  }
-  if (regexp[0] == ')') {
-    if (info.groups>0)
-      info.groupEnd[info.groups-1] = jsvStringIteratorGetIndex(txtIt);
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+1, txtIt, info);
-  }
-  int charLength;
-  bool charMatched = matchcharacter(regexp, txtIt, &charLength, &info);
-  if (regexp[charLength] == '*' || regexp[charLength] == '+') {
-    char op = regexp[charLength];
-    if (!charMatched && op=='+') {
-      // with '+' operator it has to match at least once
-      return nomatchfound(&regexp[charLength+1], info);
+      match = (c>=item[1] && c<=item[2]) ||
+              (ignoreCase && ((cL>=item[1] && cL<=item[2]) || (cU>=item[1] && cU<=item[2])));
+  }
+  return match != (code[0]==RE_NSET);
+}
+
+/// If op needs a character, return whether ch matches it and set *next to the following instruction
+static bool reMatchOp(const unsigned char *op, char ch, bool ignoreCase, unsigned int *next) {
+  switch ((RegExpOp)op[0]) {
+    case RE_CHAR: *next += 2; return (ignoreCase ? jsvStringCharToLower(ch) : ch)==(char)op[1];
+    case RE_ANY: *next += 1; return true;
+    case RE_CLASS: *next += 2; return reMatchClass((char)op[1], ch);
+    case RE_SET:
+    case RE_NSET: *next += 2+3u*op[1]; return reMatchSet(op, ch, ignoreCase);
+    default: return false;
+  }
+}
+
+/* Run the program on str from startIndex. Returns the result array, or 0 if no match */
+static JsVar *reExec(const RegExpHeader *header, const unsigned char *code, JsVar *str, size_t startIndex) {
+  RegExpVM vm;
+  vm.code = code;
+  vm.slots = 2*(header->groups+1u);
+  vm.position = startIndex;
+  vm.length = jsvGetStringLength(str);
+  unsigned int threads = header->instructions;
+  size_t capsSize = vm.slots*sizeof(size_t);
+  size_t needed = capsSize*(2*threads+2) + sizeof(uint16_t)*2*(threads+header->codeLength);
+  if (needed+256 > jsuGetFreeStack()) {
+    jsExceptionHere(JSET_ERROR, "Not enough free stack to run RegEx");
+    return 0;
+  }
+  size_t *mem = (size_t*)alloca(needed);
+  size_t *caps = mem;
+  size_t *matchCaps = &caps[vm.slots];
+  RegExpThreadList lists[2];
+  lists[0].caps = &matchCaps[vm.slots];
+  lists[1].caps = &lists[0].caps[threads*vm.slots];
+  lists[0].pc = (uint16_t*)&lists[1].caps[threads*vm.slots];
+  lists[1].pc = &lists[0].pc[threads];
+  lists[0].index = &lists[1].pc[threads];
+  lists[1].index = &lists[0].index[header->codeLength];
+  RegExpThreadList *clist = &lists[0], *nlist = &lists[1];
+  clist->count = 0;
+  unsigned int i;
+  for (i=0;i<vm.slots;i++) caps[i] = RE_UNSET;
+  /* If the regex always starts by matching a character (after 'SAVE 0'), while
+   * we're not part way through a match we can skip straight to a character that matches */
+  bool canSkip = code[2]<RE_BOL; // the ops before RE_BOL all need a character
+  unsigned int unused;
+  bool matched = false;
+
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, startIndex);
+  while (true) {
+    char ch = jsvStringIteratorGetChar(&it);
+    if (!matched) {
+      if (!clist->count && canSkip) {
+        while (vm.position<vm.length && !reMatchOp(&code[2], ch, header->ignoreCase, &unused)) {
+          jsvStringIteratorNext(&it);
+          vm.position++;
+          ch = jsvStringIteratorGetChar(&it);
+        }
+      }
+      // Start a new match here - lower priority than any that started earlier
+      reAddThread(&vm, clist, 0, caps);
     }
-    char *regexpAfterStar = regexp+charLength+1;
-    JsvStringIterator txtIt2;
-    // Try and match everything after right now
-    jsvStringIteratorClone(&txtIt2, txtIt);
-    JsVar *lastrmatch = matchhere(regexpAfterStar, &txtIt2, info);
-    jsvStringIteratorFree(&txtIt2);
-    // Otherwise try and match more than one
-    while (jsvStringIteratorHasChar(txtIt) && charMatched) {
-      // We had this character matched, so move on and see if we can match with the new one
-      jsvStringIteratorNext(txtIt);
-      charMatched = matchcharacter(regexp, txtIt, &charLength, &info);
-      // See if we can match after the character...
-      jsvStringIteratorClone(&txtIt2, txtIt);
-      JsVar *rmatch = matchhere(regexpAfterStar, &txtIt2, info);
-      jsvStringIteratorFree(&txtIt2);
-      // can't match with this - use the last one
-      if (rmatch) {
-        jsvUnLock(lastrmatch);
-        lastrmatch = rmatch;
+    if (!clist->count) break;
+    bool hasChar = vm.position < vm.length;
+    nlist->count = 0;
+    vm.position++;
+    for (i=0;i<clist->count;i++) {
+      const unsigned char *op = &code[clist->pc[i]];
+      size_t *threadCaps = &clist->caps[i*vm.slots];
+      if (op[0]==RE_MATCH) {
+        matched = true;
+        memcpy(matchCaps, threadCaps, capsSize);
+        break; // threads after this one are lower priority, so can't beat this match
       }
+      // jumps/splits/etc were handled when the thread was added, so this needs a character
+      unsigned int next = clist->pc[i];
+      if (hasChar && reMatchOp(op, ch, header->ignoreCase, &next))
+        reAddThread(&vm, nlist, next, threadCaps);
     }
-    return lastrmatch;
+    RegExpThreadList *t = clist;
+    clist = nlist;
+    nlist = t;
+    if (!hasChar || jspIsInterrupted()) break;
+    jsvStringIteratorNext(&it);
   }
+  jsvStringIteratorFree(&it);
+  if (!matched || jspIsInterrupted()) return 0;
 
-  // This character is matched
-  if (jsvStringIteratorHasChar(txtIt) && charMatched) {
-    jsvStringIteratorNext(txtIt);
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+charLength, txtIt, info);
+  JsVar *rmatch = jsvNewEmptyArray();
+  if (!rmatch) return 0;
+  for (i=0;i<=header->groups;i++) {
+    size_t start = matchCaps[i*2], end = matchCaps[i*2+1];
+    // groups that weren't used in the match are undefined
+    JsVar *matchStr = 0;
+    if (start!=RE_UNSET && end!=RE_UNSET && end>=start)
+      matchStr = jsvNewFromStringVar(str, start, end-start);
+    jsvSetArrayItem(rmatch, (JsVarInt)i, matchStr);
+    jsvUnLock(matchStr);
   }
-  // No match
-  return nomatchfound(&regexp[charLength], info);
+  jsvObjectSetChildAndUnLock(rmatch, "index", jsvNewFromInteger((JsVarInt)matchCaps[0]));
+  jsvObjectSetChild(rmatch, "input", str);
+  return rmatch;
 }
 
 /*JSON{
@@ -276,6 +606,10 @@ The built-in class for handling Regular Expressions
 
 **Note:** Espruino's regular expression parser does not contain all the features
 present in a full ES6 JS engine. However it does contain support for the all the basics.
+
+Regular expressions are compiled when they are created, and matching takes time
+proportional to the length of the string (there's no backtracking), so expressions
+like `/(a*)*b/` can't take forever to run. Lookahead and backreferences are not supported.
 */
 
 /*JSON{
@@ -307,6 +641,11 @@ JsVar *jswrap_regexp_constructor(JsVar *str, JsVar *flags) {
       jsvObjectSetChild(r, "flags", flags);
   }
   jsvObjectSetChildAndUnLock(r, "lastIndex", jsvNewFromInteger(0));
+  // compile now so we only do it once, and so errors are reported straight away
+  if (!jswrap_regexp_compile(r) && jspHasError()) {
+    jsvUnLock(r);
+    return 0;
+  }
   return r;
 }
 
@@ -348,20 +687,27 @@ Or with groups `/W(o)rld/.exec("Hello World")` returns:
 JsVar *jswrap_regexp_exec(JsVar *parent, JsVar *arg) {
   JsVar *str = jsvAsString(arg);
   JsVarInt lastIndex = jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "lastIndex", 0));
-  JsVar *regex = jsvObjectGetChild(parent, "source", 0);
-  if (!jsvIsString(regex) || lastIndex>jsvGetStringLength(str)) {
-    jsvUnLock2(str,regex);
+  if (lastIndex<0 || lastIndex>(JsVarInt)jsvGetStringLength(str)) {
+    jsvUnLock(str);
     return 0;
   }
-  size_t regexLen = jsvGetStringLength(regex);
-  char *regexPtr = (char *)alloca(regexLen+1);
-  if (!regexPtr) {
-    jsvUnLock2(str,regex);
+  JsVar *program = jsvObjectGetChild(parent, REGEXP_PROGRAM_NAME, 0);
+  if (!program && jswrap_regexp_compile(parent))
+    program = jsvObjectGetChild(parent, REGEXP_PROGRAM_NAME, 0);
+  // the program is small, so copy it onto the stack to run it
+  size_t programLen = jsvIsString(program) ? jsvGetStringLength(program) : 0;
+  RegExpHeader header;
+  if (programLen<sizeof(RegExpHeader) || programLen+256 > jsuGetFreeStack()) {
+    jsvUnLock2(str,program);
     return 0;
   }
-  jsvGetString(regex, regexPtr, regexLen+1);
-  jsvUnLock(regex);
-  JsVar *rmatch = match(regexPtr, str, (size_t)lastIndex, jswrap_regexp_hasFlag(parent,'i'));
+  char *ptr = (char *)alloca(programLen);
+  jsvGetStringChars(program, 0, ptr, programLen);
+  jsvUnLock(program);
+  memcpy(&header, ptr, sizeof(RegExpHeader));
+  JsVar *rmatch = 0;
+  if (programLen == sizeof(RegExpHeader)+header.codeLength)
+    rmatch = reExec(&header, (const unsigned char*)ptr+sizeof(RegExpHeader), str, (size_t)lastIndex);
   jsvUnLock(str);
   if (!rmatch) {
     rmatch = jsvNewWithFlags(JSV_NULL);
@@ -471,14 +471,27 @@ Serial1.inject('Hello World');
 This is most useful if you wish to send characters to Espruino's
 REPL (console) while it is on another device.
  */
+typedef struct {
+  IOEventFlags device;
+  unsigned int len;
+  char buf[64];
+} serial_inject_data;
+// Data is pushed in blocks, as it would be if it came from USB or DMA
 static void _jswrap_serial_inject_cb(int data, void *userData) {
-  IOEventFlags device = *(IOEventFlags*)userData;
-  jshPushIOCharEvent(device, (char)data);
+  serial_inject_data *d = (serial_inject_data*)userData;
+  d->buf[d->len++] = (char)data;
+  if (d->len == sizeof(d->buf)) {
+    jshPushIOCharEvents(d->device, d->buf, d->len);
+    d->len = 0;
+  }
 }
 void jswrap_serial_inject(JsVar *parent, JsVar *args) {
-  IOEventFlags device = jsiGetDeviceFromClass(parent);
-  if (!DEVICE_IS_SERIAL(device)) return;
-  jsvIterateCallback(args, _jswrap_serial_inject_cb, (void*)&device);
+  serial_inject_data d;
+  d.device = jsiGetDeviceFromClass(parent);
+  if (!DEVICE_IS_SERIAL(d.device)) return;
+  d.len = 0;
+  jsvIterateCallback(args, _jswrap_serial_inject_cb, (void*)&d);
+  if (d.len) jshPushIOCharEvents(d.device, d.buf, d.len);
 }
 
 /*JSON{
@@ -271,16 +271,105 @@ or power is lost.
 Simply write `require("Storage").writeJSON("MyFile", [1,2,3])` to write
 a new file, and `require("Storage").readJSON("MyFile")` to read it.
 
-This is equivalent to: `require("Storage").write(name, JSON.stringify(data))`
+This is equivalent to: `require("Storage").write(name, JSON.stringify(data))`,
+except that if there isn't enough memory to create the JSON in RAM first,
+it is written straight to flash.
 
 **Note:** This function should be used with normal files, and not
 `StorageFile`s created with `require("Storage").open(filename, ...)`
 */
+/// State for writing JSON straight into a file, see jswrap_storage_writeJSON
+typedef struct {
+  JsfFileName name;
+  uint32_t size; ///< Total size of the file
+  uint32_t offset; ///< How much we've written so far
+  bool ok; ///< false if we failed
+} StorageJSONWriter;
+
+/// State for creating JSON in RAM, see jswrap_storage_writeJSON
+typedef struct {
+  JsvStringIterator it; ///< it.var is 0 if we ran out of memory
+  uint32_t size; ///< How many characters of JSON there were
+} StorageJSONString;
+
+static void jswrap_storage_writeJSONToString(const char *str, void *user_data) {
+  StorageJSONString *s = (StorageJSONString*)user_data;
+  s->size += (uint32_t)strlen(str);
+  while (*str && s->it.var) jsvStringIteratorAppend(&s->it, *(str++));
+}
+
+static void jswrap_storage_writeJSONCallback(const char *str, void *user_data) {
+  StorageJSONWriter *w = (StorageJSONWriter*)user_data;
+  uint32_t len = (uint32_t)strlen(str);
+  if (!w->ok) return;
+  if (w->offset+len > w->size) {
+    w->ok = false;
+  } else {
+    JsVar *chunk = jsvNewNativeString((char*)str, len);
+    w->ok = chunk && jsfWriteFile(w->name, chunk, JSFF_NONE, (JsVarInt)w->offset, (JsVarInt)w->size);
+    jsvUnLock(chunk);
+  }
+  w->offset += len;
+}
+
 bool jswrap_storage_writeJSON(JsVar *name, JsVar *data) {
-  JsVar *d = jswrap_json_stringify(data,0,0);
-  bool r = jsfWriteFile(jsfNameFromVar(name), d, JSFF_NONE, 0, 0);
-  jsvUnLock(d);
-  return r;
+  StorageJSONWriter w;
+  w.name = jsfNameFromVar(name);
+  w.offset = 0;
+  w.ok = true;
+  /* Create the JSON in RAM if we can, so toJSON/getters are only called
+   * once and we can write (or leave alone, if it's unchanged) the whole
+   * file in one go. If we run out of memory we stop adding to the string
+   * but carry on, to find out how big the file needs to be. */
+  StorageJSONString s;
+  s.size = 0;
+  JsErrorFlags lowMemory = jsErrorFlags & JSERR_LOW_MEMORY;
+  JsVar *str = jsvNewFromEmptyString();
+  if (str) jsvStringIteratorNew(&s.it, str, 0);
+  else s.it.var = 0;
+  jsfGetJSONWithBufferedCallback(data, JSON_STRINGIFY_FLAGS, 0, jswrap_storage_writeJSONToString, &s);
+  bool inRAM = s.it.var!=0;
+  jsvStringIteratorFree(&s.it);
+  if (jspHasError()) {
+    jsvUnLock(str);
+    return false;
+  }
+  w.size = s.size;
+  JsVar *flat = inRAM ? jsvAsFlatString(str) : 0;
+  // If we ran out of memory, that was expected - so don't report it
+  if (!lowMemory) jsErrorFlags &= ~JSERR_LOW_MEMORY;
+  if (flat) {
+    jsvUnLock(str);
+    w.ok = jsfWriteFile(w.name, flat, JSFF_NONE, 0, 0);
+    jsvUnLock(flat);
+    return w.ok;
+  }
+  if (inRAM) {
+    // Not enough contiguous memory for a flat string - write it a chunk at a time
+    char buf[64];
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, str, 0);
+    while (w.ok && jsvStringIteratorHasChar(&it)) {
+      size_t len = 0;
+      while (len<sizeof(buf)-1 && jsvStringIteratorHasChar(&it))
+        buf[len++] = jsvStringIteratorGetCharAndNext(&it);
+      buf[len] = 0;
+      jswrap_storage_writeJSONCallback(buf, &w);
+    }
+    jsvStringIteratorFree(&it);
+    jsvUnLock(str);
+  } else {
+    jsvUnLock(str);
+    // Write the JSON straight to flash, a chunk at a time
+    jsfGetJSONWithBufferedCallback(data, JSON_STRINGIFY_FLAGS, 0, jswrap_storage_writeJSONCallback, &w);
+  }
+  if (w.offset!=w.size) w.ok = false;
+  if (!w.ok) {
+    jsfEraseFile(w.name); // don't leave a partial file
+    if (!jspHasError())
+      jsExceptionHere(JSET_ERROR, "JSON changed while writing");
+  }
+  return w.ok;
 }
 
 /*JSON{
@@ -334,9 +334,12 @@ JsVar *jswrap_string_replace(JsVar *parent, JsVar *subStr, JsVar *newSubStr) {
         unsigned int argCount = 0;
         JsVar *args[13];
         args[argCount++] = jsvLockAgain(matchStr);
-        JsVar *v;
-        while ((v = jsvGetArrayItem(match, (JsVarInt)argCount)))
-          args[argCount++] = v;
+        // groups that weren't part of the match are undefined
+        JsVarInt groups = jsvGetArrayLength(match);
+        while ((JsVarInt)argCount < groups) {
+          args[argCount] = jsvGetArrayItem(match, (JsVarInt)argCount);
+          argCount++;
+        }
         args[argCount++] = jsvObjectGetChild(match,"index",0);
         args[argCount++] = jsvObjectGetChild(match,"input",0);
         JsVar *result = jsvAsStringAndUnLock(jspeFunctionCall(replace, 0, 0, false, (JsVarInt)argCount, args));
@@ -350,11 +353,9 @@ JsVar *jswrap_string_replace(JsVar *parent, JsVar *subStr, JsVar *newSubStr) {
           char ch = jsvStringIteratorGetCharAndNext(&src);
           if (ch=='$') {
             ch = jsvStringIteratorGetCharAndNext(&src);
-            JsVar *group = 0;
-            if (ch>'0' && ch<='9')
-              group = jsvGetArrayItem(match, ch-'0');
-            if (group) {
-              jsvStringIteratorAppendString(&dst, group, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
+            if (ch>'0' && ch<='9' && ch-'0' < jsvGetArrayLength(match)) {
+              JsVar *group = jsvGetArrayItem(match, ch-'0'); // undefined if the group wasn't matched
+              if (group) jsvStringIteratorAppendString(&dst, group, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
               jsvUnLock(group);
             } else {
               jsvStringIteratorAppend(&dst, '$');
@@ -508,29 +509,51 @@ JsVar *jswrap_string_split(JsVar *parent, JsVar *split) {
 #ifndef SAVE_ON_FLASH
   // Use RegExp if one is passed in
   if (jsvIsInstanceOf(split, "RegExp")) {
-    int last = 0;
+    /* Like the spec's SplitMatcher - if there's an empty match where the
+     * last part ended, move on a character so we don't match it forever */
+    int last = 0, pos = 0;
+    int strLen = (int)jsvGetStringLength(parent);
     JsVar *match;
-    jsvObjectSetChildAndUnLock(split, "lastIndex", jsvNewFromInteger(0));
-    match = jswrap_regexp_exec(split, parent);
-    while (match && !jsvIsNull(match)) {
+    if (strLen==0) { // an empty string gives an empty array if the RegExp matches it
+      jsvObjectSetChildAndUnLock(split, "lastIndex", jsvNewFromInteger(0));
+      match = jswrap_regexp_exec(split, parent);
+      bool matched = match && !jsvIsNull(match);
+      jsvUnLock(match);
+      jsvObjectSetChildAndUnLock(split, "lastIndex", jsvNewFromInteger(0));
+      if (!matched) jsvArrayPush(array, parent);
+      return array;
+    }
+    while (pos < strLen) {
+      jsvObjectSetChildAndUnLock(split, "lastIndex", jsvNewFromInteger(pos));
+      match = jswrap_regexp_exec(split, parent);
+      if (!match || jsvIsNull(match)) {
+        jsvUnLock(match);
+        break;
+      }
       // get info about match
       JsVar *matchStr = jsvGetArrayItem(match,0);
-      JsVarInt idx = jsvGetIntegerAndUnLock(jsvObjectGetChild(match,"index",0));
-      int len = (int)jsvGetStringLength(matchStr);
+      int idx = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(match,"index",0));
+      int end = idx + (int)jsvGetStringLength(matchStr);
       jsvUnLock(matchStr);
-      // do the replacement
-      jsvArrayPushAndUnLock(array, jsvNewFromStringVar(parent, (size_t)last, (size_t)(idx-last)));
-      last = idx+len;
-      // search again
+      if (idx >= strLen) { // we don't split on a match at the very end
+        jsvUnLock(match);
+        break;
+      }
+      if (end == last) { // empty match where the last part ended
+        pos = idx+1;
+      } else {
+        jsvArrayPushAndUnLock(array, jsvNewFromStringVar(parent, (size_t)last, (size_t)(idx-last)));
+        // add any capturing groups
+        JsVarInt i, groups = jsvGetArrayLength(match);
+        for (i=1;i<groups;i++)
+          jsvArrayPushAndUnLock(array, jsvGetArrayItem(match, i));
+        last = pos = end;
+      }
       jsvUnLock(match);
-      jsvObjectSetChildAndUnLock(split, "lastIndex", jsvNewFromInteger(last));
-      match = jswrap_regexp_exec(split, parent);
     }
-    jsvUnLock(match);
     jsvObjectSetChildAndUnLock(split, "lastIndex", jsvNewFromInteger(0));
     // add remaining string after last match
-    if (last <= (int)jsvGetStringLength(parent))
-      jsvArrayPushAndUnLock(array, jsvNewFromStringVar(parent, (size_t)last, JSVAPPENDSTRINGVAR_MAXLENGTH));
+    jsvArrayPushAndUnLock(array, jsvNewFromStringVar(parent, (size_t)last, JSVAPPENDSTRINGVAR_MAXLENGTH));
     return array;
   }
 #endif
@@ -79,9 +79,19 @@ typedef struct {
   const JswSymPtr *symbols;
   const char *symbolChars;
   unsigned char symbolCount;
+#ifdef JSWRAPPER_SYMBOL_HASH
+  const unsigned char *hashDisplacements; ///< For each bucket, the displacement that gives each name in it a unique slot
+  const unsigned char *hashSymbols; ///< For each slot, the index in 'symbols'
+  unsigned char hashBuckets; ///< Number of buckets (0 if there's no hash table)
+#endif
 } PACKED_JSW_SYM JswSymList;
 
-/// Do a binary search of the symbol table list
+#ifndef RELEASE
+/// How many names jswBinarySearch has compared against symbols - for testing only
+extern unsigned int jswSymbolCompares;
+#endif
+
+/// Look up a name in the symbol table list (using the perfect hash table if there is one, or a binary search)
 JsVar *jswBinarySearch(const JswSymList *symbolsPtr, JsVar *parent, const char *name);
 
 /** If 'name' is something that belongs to an internal function, execute it.  */
@@ -128,9 +138,11 @@ const char *jswGetBuiltInJSLibrary(const char *name);
 /** Return a comma-separated list of built-in libraries */
 const char *jswGetBuiltInLibraryNames();
 
-#ifdef EMSCRIPTEN
-// on Emscripten we cant easily hack around function calls with floats/etc so we must just do this brute-force by handling every call pattern we use
-JsVar *jswCallFunctionHack(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount);
+#if defined(EMSCRIPTEN) || !defined(SAVE_ON_FLASH)
+/** Call a native function using the code generated for its argument specifier, putting
+ * what it returned in 'result'. Returns false if no builtin uses this argument specifier
+ * (in which case the function wasn't called). */
+bool jswCallFunctionBySpecifier(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount, JsVar **result);
 #endif
 
 #endif // JSWRAPPER_H
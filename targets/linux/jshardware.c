@@ -31,6 +31,9 @@
 #include "jsutils.h"
 #include "jsparse.h"
 #include "jsinteractive.h"
+#ifdef USE_NET
+#include "network_linux.h"
+#endif
 
 #include <pthread.h>
 
@@ -60,6 +63,17 @@
 // ----------------------------------------------------------------------------
 int ioDevices[EV_DEVICE_MAX+1]; // list of open IO devices (or 0)
 JshPinState gpioState[JSH_PIN_COUNT]; // will be set to UNDEFINED if it isn't exported
+#ifndef USE_WIRINGPI
+/* With no GPIO to use, pins just remember what was written to them. Writing
+ * to a watched pin triggers its watch as if it had been wired to an input,
+ * which lets the watch code be tested. */
+bool gpioFakeValue[JSH_PIN_COUNT];
+#ifdef SYSFS_GPIO_DIR
+bool gpioIsFake; // SYSFS_GPIO_DIR didn't exist when we started
+#else
+#define gpioIsFake true
+#endif
+#endif
 
 #ifdef SYSFS_GPIO_DIR
 
@@ -241,8 +255,8 @@ int getch()
 {
     int r;
     unsigned char c;
-    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) < 0) {
-        return r;
+    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) <= 0) {
+        return -1; // error, or end of file (eg. stdin is /dev/null)
     } else {
         return c;
     }
@@ -271,7 +285,7 @@ void jshInputThread() {
       int i;
       for (i=0;i<=EV_DEVICE_MAX;i++) {
         if (ioDevices[i]) {
-          char buf[32];
+          char buf[256];
           // read can return -1 (EAGAIN) because O_NONBLOCK is set
           int bytes = (int)read(ioDevices[i], buf, sizeof(buf));
           if (bytes>0) {
@@ -354,6 +368,7 @@ void jshInit() {
   for (i=0;i<JSH_PIN_COUNT;i++) {
     gpioShouldWatch[i] = false;    
   }
+  gpioIsFake = access(SYSFS_GPIO_DIR, F_OK)!=0;
 #endif
 
   isInitialised = true;
@@ -384,7 +399,7 @@ void jshKill() {
 
   // unexport any GPIO that we exported
   for (i=0;i<JSH_PIN_COUNT;i++)
-    if (gpioState[i] != JSHPINSTATE_UNDEFINED)
+    if (gpioState[i] != JSHPINSTATE_UNDEFINED && !gpioIsFake)
       sysfs_write_int(SYSFS_GPIO_DIR"/unexport", i);
 #endif
 }
@@ -455,7 +470,7 @@ void jshDelayMicroseconds(int microsec) {
 
 void jshPinSetState(Pin pin, JshPinState state) {
 #ifdef SYSFS_GPIO_DIR
-  if (gpioState[pin] != state) {
+  if (gpioState[pin] != state && !gpioIsFake) {
     if (gpioState[pin] == JSHPINSTATE_UNDEFINED)
       sysfs_write_int(SYSFS_GPIO_DIR"/export", pin);
     char path[64] = SYSFS_GPIO_DIR"/gpio";
@@ -489,26 +504,38 @@ JshPinState jshPinGetState(Pin pin) {
 
 void jshPinSetValue(Pin pin, bool value) {
 #ifdef SYSFS_GPIO_DIR
-  char path[64] = SYSFS_GPIO_DIR"/gpio";
-  itostr(pin, &path[strlen(path)], 10);
-  strcat(&path[strlen(path)], "/value");
-  sysfs_write_int(path, value?1:0);
+  if (!gpioIsFake) {
+    char path[64] = SYSFS_GPIO_DIR"/gpio";
+    itostr(pin, &path[strlen(path)], 10);
+    strcat(&path[strlen(path)], "/value");
+    sysfs_write_int(path, value?1:0);
+  }
 #endif
 #ifdef USE_WIRINGPI
   digitalWrite(pin,value);
 #endif
+#ifndef USE_WIRINGPI
+  if (gpioIsFake && gpioFakeValue[pin] != value) {
+    gpioFakeValue[pin] = value;
+    if (gpioEventFlags[pin])
+      jshPushIOWatchEvent(gpioEventFlags[pin]);
+  }
+#endif
 }
 
 bool jshPinGetValue(Pin pin) {
 #ifdef SYSFS_GPIO_DIR
-  char path[64] = SYSFS_GPIO_DIR"/gpio";
-  itostr(pin, &path[strlen(path)], 10);
-  strcat(&path[strlen(path)], "/value");
-  return sysfs_read_int(path);
-#elif defined(USE_WIRINGPI)
+  if (!gpioIsFake) {
+    char path[64] = SYSFS_GPIO_DIR"/gpio";
+    itostr(pin, &path[strlen(path)], 10);
+    strcat(&path[strlen(path)], "/value");
+    return sysfs_read_int(path);
+  }
+#endif
+#ifdef USE_WIRINGPI
   return digitalRead(pin);
 #else
-  return false;
+  return gpioFakeValue[pin];
 #endif
 }
 
@@ -604,7 +631,7 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch) {
         gpioEventFlags[pin] = exti;
         jshPinSetState(pin, JSHPINSTATE_GPIO_IN);
 #ifdef SYSFS_GPIO_DIR
-        gpioShouldWatch[pin] = true;
+        gpioShouldWatch[pin] = !gpioIsFake;
         gpioLastState[pin] = jshPinGetValue(pin);
 #endif
 #ifdef USE_WIRINGPI
@@ -804,9 +831,14 @@ bool jshSleep(JsSysTime timeUntilWake) {
   if (hasWatches && usecs>1000) 
     usecs=1000; // don't sleep much if we have watches - we need to keep polling them
   if (usecs > 50000)
-    usecs = 50000; // don't want to sleep too much (user input/HTTP/etc)
-  if (usecs >= 1000)  
+    usecs = 50000; // don't want to sleep too much (user input, or sockets if we can't wait on them)
+  if (usecs >= 1000) {
+#ifdef USE_NET
+    // wake up as soon as a socket is ready
+    if (net_linux_sleep(usecs)) return true;
+#endif
     jshDelayMicroseconds(usecs);
+  }
   return true;
 }
 
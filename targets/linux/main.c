@@ -15,6 +15,9 @@
 #include "jshardware.h"
 #include "jsinteractive.h"
 #include "jswrapper.h"
+#ifdef USE_NET
+#include "socketserver.h"
+#endif
 
 #define TEST_DIR "tests/"
 #define CMD_NAME "espruino"
@@ -52,6 +55,15 @@ void fatal(int errcode, const char *fmt, ...) {
   exit(errcode);
 }
 
+/// Is there anything that could still make code run? (timers, or open sockets that might get data)
+bool hasPendingWork() {
+  if (jsiHasTimers()) return true;
+#ifdef USE_NET
+  if (socketHasOpenSockets()) return true;
+#endif
+  return false;
+}
+
 void perror_exit(int errcode, const char *s) {
   fflush(stdout);
   fprintf(stderr, "%s: ", CMD_NAME);
@@ -183,7 +195,7 @@ bool run_test(const char *filename) {
 
   isRunning = true;
   bool isBusy = true;
-  while (isRunning && (jsiHasTimers() || isBusy))
+  while (isRunning && (hasPendingWork() || isBusy))
     isBusy = jsiLoop();
 
   JsVar *result = jsvObjectGetChild(execInfo.root, "result", 0 /*no create*/);
@@ -381,7 +393,7 @@ int main(int argc, char **argv) {
         int errCode = handleErrors();
         isRunning = !errCode;
         bool isBusy = true;
-        while (isRunning && (jsiHasTimers() || isBusy))
+        while (isRunning && (hasPendingWork() || isBusy))
           isBusy = jsiLoop();
         jsiKill();
         jsvKill();
@@ -462,7 +474,7 @@ int main(int argc, char **argv) {
     free(buffer);
     isRunning = !errCode;
     bool isBusy = true;
-    while (isRunning && (jsiHasTimers() || isBusy))
+    while (isRunning && (hasPendingWork() || isBusy))
       isBusy = jsiLoop();
     jsiKill();
     jsvKill();
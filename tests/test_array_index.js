@@ -0,0 +1,57 @@
+// Big arrays with no missing elements get an index, so arr[i] is fast
+var results = [];
+var a = [];
+for (var i=0;i<100;i++) a.push(i*2);
+var ok = true;
+for (var i=0;i<100;i++) if (a[i]!==i*2) ok = false;
+results.push(ok && a[100]===undefined && a[-1]===undefined);
+// pushing/popping keeps the index
+a.push(200); a[101] = 202;
+results.push(a[100]==200 && a[101]==202 && a.length==102);
+results.push(a.pop()==202 && a[101]===undefined && a[100]==200);
+// making an array sparse
+var s = a.slice();
+s[150] = 1;
+results.push(s[150]==1 && s[120]===undefined && s[99]==198);
+// renumbering
+a.shift();
+results.push(a[0]==2 && a[98]==198 && a[99]==200);
+a.unshift(-1);
+results.push(a[0]==-1 && a[1]==2 && a[100]==200);
+a.reverse();
+results.push(a[0]==200 && a[100]==-1 && a[99]==2);
+a.splice(10,5);
+results.push(a[9]==182 && a[10]==170 && a.length==96);
+a.splice(10,0,"x","y");
+results.push(a[10]=="x" && a[12]==170 && a.length==98);
+// string keys
+a.foo = "bar";
+results.push(a.foo=="bar" && a[97]==-1);
+// writes
+for (var i=0;i<a.length;i++) a[i] = i;
+ok = true;
+for (var i=0;i<a.length;i++) if (a[i]!==i) ok = false;
+results.push(ok);
+// sort / defrag
+a.sort(function(x,y){return y-x;});
+results.push(a[0]==97 && a[97]==0);
+E.defrag();
+results.push(a[0]==97 && a[50]==47);
+var b = a.slice();
+results.push(b[1]==96 && b.length==98);
+// a sparse array can't have an index, and we don't keep trying to build one...
+var sp = [];
+for (var i=0;i<100;i++) if (i!=50) sp[i] = i;
+ok = true;
+for (var n=0;n<3;n++) for (var i=0;i<100;i++) if (sp[i]!==(i==50?undefined:i)) ok = false;
+results.push(ok);
+// ...until it changes
+sp[50] = 50;
+ok = true;
+for (var i=0;i<100;i++) if (sp[i]!==i) ok = false;
+results.push(ok);
+sp.length = 120; // sparse again
+sp.length = 100;
+results.push(sp[99]==99 && sp[0]==0 && sp[100]===undefined);
+
+result = results.every(r=>r);
@@ -0,0 +1,65 @@
+// Array.sort is a stable merge sort, and typed arrays are sorted natively
+var results = [];
+
+results.push([3,1,2,10,undefined,"b","a",null,true,-1,1.5].sort().join()=="-1,1,1.5,10,2,3,a,b,,true,");
+results.push([5,1,4].sort((a,b)=>a-b).join()=="1,4,5");
+
+// stable
+var st = [];
+for (var i=0;i<20;i++) st.push({k:i%3, i:i});
+results.push(st.sort((a,b)=>a.k-b.k).map(x=>x.i).join()=="0,3,6,9,12,15,18,1,4,7,10,13,16,19,2,5,8,11,14,17");
+
+// already sorted/reverse sorted input, and the same object many times
+var a = [];
+for (var i=0;i<500;i++) a.push(i);
+a.sort((x,y)=>x-y);
+results.push(a[0]==0 && a[499]==499);
+a.reverse().sort((x,y)=>x-y);
+results.push(a[0]==0 && a[499]==499);
+var o = {}, arr = [];
+for (var i=0;i<40;i++) arr.push(o);
+arr.sort();
+results.push(arr.length==40 && arr[39]===o);
+
+// modifying the array while sorting shouldn't crash
+var m = [5,4,3,2,1];
+m.sort(function(a,b) { m.pop(); return a-b; });
+
+// typed arrays - numeric, NaN at the end, full range of Uint32
+results.push(new Int16Array([5,-3,100,0]).sort().join()=="-3,0,5,100");
+results.push(new Float32Array([1.5,NaN,-2,0.25]).sort().join()=="-2,0.25,1.5,NaN");
+results.push(new Uint32Array([4000000000,1,3000000000]).sort().join()=="1,3000000000,4000000000");
+results.push(new Uint8Array([3,1,2]).sort((a,b)=>b-a).join()=="3,2,1");
+
+// values that only exist while sorting (eg. ints) must survive a GC from the compare function
+var a = [];
+for (var i=0;i<40;i++) a.push((i*37)%41);
+a.sort(function(x,y) { process.memory(); return x-y; });
+results.push(a.join()==a.slice().sort((x,y)=>x-y).join() && a[0]==0 && a[39]==40);
+// ... and objects removed from the array by the compare function, even if memory is defragmented
+var o = [];
+for (var i=0;i<40;i++) o.push({v:(i*7)%40});
+var removed = o.slice();
+o.sort(function(x,y) { if (o.length) o.length = 0; E.defrag(); return x.v-y.v; });
+results.push(o.length==0 && removed.every(x=>typeof x.v=="number"));
+
+// If there's no memory to sort a list of values (here, because one object is in
+// the array too many times to lock it for each) the elements are relinked in order
+var same = {k:-1}, big = [];
+for (var i=0;i<2000;i++) big.push({k:2000-i});
+for (var i=0;i<10;i++) big.push(same);
+var compares = 0;
+big.sort(function(x,y) { compares++; process.memory(); return x.k-y.k; });
+results.push(big.length==2010 && big[0]===same && big[9]===same && big[10].k==1 && big[2009].k==2000);
+results.push(big.every((x,i)=>!i || big[i-1].k<=x.k));
+results.push(compares < 2010*11); // O(n log n), not O(n^2)
+var st = [same,same,same,same,same,same,same,same];
+for (var i=0;i<20;i++) st.push({k:i%3, i:i});
+st.sort((a,b)=>a.k-b.k);
+results.push(st.slice(8).map(x=>x.i).join()=="0,3,6,9,12,15,18,1,4,7,10,13,16,19,2,5,8,11,14,17");
+var m = [3,2,1,same,same,same,same,same,same,same,same];
+m.foo = "bar";
+m.sort(function(a,b) { m.pop(); m.push(42); return (a===same ? 0 : 1) - (b===same ? 0 : 1); });
+results.push(m.length==11 && m.foo=="bar" && m[0]===same && m.slice(8).join()=="3,2,1" && m.indexOf(42)<0);
+
+result = results.every(r=>r);
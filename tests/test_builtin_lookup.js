@@ -0,0 +1,34 @@
+// Built-in symbols are looked up with perfect hash tables - check every one
+// can be found with just one string compare (a binary search needs several)
+var fails = [];
+function compares(fn) {
+  var c = E.getSymbolCompares();
+  fn();
+  return E.getSymbolCompares() - c;
+}
+var overhead = compares(function() {});
+var x;
+function check(obj, names, desc) {
+  names.forEach(function(n) {
+    if (n==parseInt(n)) return; // array elements
+    var c = compares(function() { x = obj[n]; }) - overhead;
+    if (c!=1 || x===undefined) fails.push(desc+"."+n+" ("+c+")");
+  });
+}
+check(Math, Object.getOwnPropertyNames(Math), "Math");
+check(JSON, Object.getOwnPropertyNames(JSON), "JSON");
+check([], Object.getOwnPropertyNames([]), "[]");
+check("", Object.getOwnPropertyNames(""), "\"\"");
+check(new Uint8Array(1), Object.getOwnPropertyNames(new Uint8Array(1)), "Uint8Array");
+check(global, ["parseInt","parseFloat","setTimeout","clearInterval","digitalWrite","isNaN","Promise","DataView"], "global");
+
+// names that aren't builtins (but may share a hash slot with one)
+["Mat", "Math2", "parseIn", "XYZ", "", "setTimeou", "a"].forEach(function(n) {
+  if (n in global) fails.push("!"+n);
+});
+if (Math.foo!==undefined || [].foo!==undefined || "".foo!==undefined) fails.push("foo");
+// pin names still work
+var pinOk = typeof D5 != "undefined" ? D5 instanceof Pin : true;
+
+result = fails.length==0 && pinOk && Math.sqrt(4)==2 && [1,2].indexOf(2)==1 && "abc".charAt(1)=="b";
+if (fails.length) console.log("Not found with one compare", fails);
@@ -0,0 +1,38 @@
+// Memory can be defragmented all at once, or a bit at a time when idle
+function fragment() {
+  var keep = [], junk = [];
+  for (var i=0;i<250;i++) {
+    keep.push({a:i,b:"Hello "+i});
+    junk.push({c:i});
+  }
+  junk = undefined;
+  return keep;
+}
+function check(keep) {
+  return keep.every((o,i)=>o.a==i && o.b=="Hello "+i);
+}
+
+var results = [];
+var data = fragment();
+var m = process.memory();
+results.push(m.fragmentation>20 && m.freeRun<m.free);
+E.defrag();
+var m2 = process.memory();
+results.push(check(data));
+results.push(m2.fragmentation<m.fragmentation && m2.freeRun>m.freeRun);
+
+var data2 = fragment();
+data = undefined;
+var m3 = process.memory();
+E.defrag(true);
+var tries = 0;
+function done() {
+  var m4 = process.memory();
+  // wait around the idle loop until it's finished
+  if (m4.fragmentation>=m3.fragmentation && ++tries<20) return setTimeout(done, 50);
+  results.push(check(data2));
+  results.push(m4.fragmentation<m3.fragmentation && m4.freeRun>m3.freeRun);
+  result = results.every(r=>r);
+  if (!result) print(results, m, m2, m3, m4);
+}
+setTimeout(done, 50);
@@ -0,0 +1,27 @@
+// Defragmenting when idle must finish an incremental GC that's part way through unreffing/sweeping first
+var keep = {v:"Hello"};
+function mkGarbage() {
+  for (var i=0;i<600;i++) {
+    var a = {k:keep};
+    a.a = a; // a cycle, so only the GC can free it
+  }
+}
+
+var results = [];
+var pass = 3;
+function next() {
+  mkGarbage();
+  results.push(E.stepGC(pass)==pass);
+  E.defrag(true);
+  setTimeout(function() {
+    process.memory(); // full GC - would unref garbage a second time if the sweep was dropped
+    results.push(keep.v=="Hello");
+    if (++pass<=4) return next();
+    keep = {v:keep.v};
+    process.memory();
+    results.push(keep.v=="Hello");
+    result = results.every(r=>r);
+    if (!result) print(results);
+  }, 500);
+}
+next();
@@ -0,0 +1,26 @@
+// Flat strings (eg. ArrayBuffers) are allocated from runs of free memory we remember
+var results = [];
+var keep = [];
+for (var i=0;i<600;i++) { keep.push({a:i}); if (i%3==0) keep.push(new Uint8Array(40+i)); }
+keep = keep.filter((x,i)=>i%2); // leave holes of different sizes
+
+var bufs = [];
+for (var j=0;j<300;j++) {
+  var b = new Uint8Array(16 + (j*37)%300);
+  b.fill(j&255);
+  bufs.push(b);
+  if (j%2) bufs.splice((j*7)%bufs.length, 1); // free some again
+  if (j%5==0) keep.push({j:j}); // and allocate some normal vars in between
+}
+// no two buffers should share memory
+results.push(bufs.every(function(b) {
+  for (var i=1;i<b.length;i++) if (b[i]!=b[0]) return false;
+  return true;
+}));
+var m1 = process.memory().usage;
+bufs = undefined;
+keep = undefined;
+var m2 = process.memory();
+results.push(m2.usage < 200 && m2.usage < m1);
+
+result = results.every(r=>r);
@@ -0,0 +1,57 @@
+// Functions get a pretokenised copy of their code cached when first called
+var results = [];
+
+function f(a) {
+  // comments and whitespace shouldn't matter
+  var s = "a\"b\n\x01";
+  return s + a + 0 + 12 + 300 + 70000 + 0x10 + 1.5;
+}
+var src = f.toString();
+results.push(f(1)=="a\"b\n\x01101230070000161.5");
+results.push(f(2)=="a\"b\n\x01201230070000161.5"); // now from the cache
+results.push(f.toString()==src); // original code is still used for toString
+
+// nested functions aren't cached, so their code is left alone
+function g() { return function() { var a = 42; /* hi */ return a; }; }
+results.push(g()()==42);
+results.push(g().toString().indexOf("/* hi */")>=0);
+
+// pretokenised code with raw strings/ints
+E.setFlags({pretokenise:1});
+function h(a) { var s = "a\"b\n"; return s.length + a + 0 + 255 + 256 + 65535 + 65536; }
+results.push(h(1)==131587);
+results.push(h.toString()=='function (a) {var s="a\\"b\\n";return s.length+a+0+255+256+65535+65536;}');
+function i() { return 5 .toString()+'x'; }
+results.push(i()=="5x");
+results.push(h["\xFFtok"]===h["\xFFcod"]); // already tokenised, so no copy is made
+function fact(n) { return n>1 ? n*fact(n-1) : 1; }
+results.push(fact(7)==5040); // recursion doesn't run out of locks on the code
+E.setFlags({pretokenise:0});
+
+// errors are reported at their position in the code that was written, not the copy
+function j(x) { var s = "a\nb", t = "0123456789"; return s+t+10+266+2560+x.foo.bar; }
+var stacks = [];
+for (var n=0;n<2;n++) try { j(1); } catch (e) { stacks.push(e.stack); }
+results.push(stacks[1]==stacks[0] && stacks[1].indexOf(" at line 1 col 63\n")==0);
+results.push(stacks[1].split("\n")[1]=="...eturn s+t+10+266+2560+x.foo.bar;");
+results.push(f["\xFFtok"].indexOf("\n")<0 && j["\xFFtok"].indexOf("\n")<0);
+
+function k(x) {
+  var s = "multi-line";
+
+  var t = s + 1;  return x.foo.bar;
+}
+stacks = [];
+for (var n=0;n<2;n++) try { k(1); } catch (e) { stacks.push(e.stack); }
+results.push(k["\xFFtok"]!=k["\xFFcod"]); // it was cached
+results.push(stacks[1]==stacks[0] && stacks[1].indexOf(" at line 3 col 31\n")==0);
+results.push(stacks[1].split("\n")[1]=="  var t = s + 1;  return x.foo.bar;");
+
+// the cached copies are dropped if we run out of memory
+var fill = [];
+while (f["\xFFtok"]!==undefined && fill.length<100000) fill.push("fill "+fill.length);
+fill = undefined;
+results.push(f["\xFFtok"]===undefined);
+results.push(f(3)=="a\"b\n\x01301230070000161.5" && f["\xFFtok"]!==undefined); // and made again
+
+result = results.every(r=>r);
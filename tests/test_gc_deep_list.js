@@ -0,0 +1,19 @@
+// GC marks without recursion, so deep structures (eg long linked lists) are collected
+var m0 = process.memory().usage;
+var head = {v:0};
+var n = head;
+for (var i=1;i<2000;i++) n = n.next = {v:i};
+n.next = head; // make it circular
+var big = {list:head};
+process.memory(); // GC with everything referenced
+
+var ok = true;
+n = big.list;
+for (var i=0;i<2000;i++) { if (n.v!=i) ok = false; n = n.next; }
+n = undefined;
+head = undefined;
+big = undefined;
+var freed = process.memory().gc;
+var m1 = process.memory().usage;
+
+result = ok && freed>4000 && m1<=m0+10;
@@ -0,0 +1,23 @@
+// A full GC while the idle loop's incremental GC is part way through must not unref anything twice
+var keep = {v:"Hello"};
+function mkGarbage() {
+  for (var i=0;i<600;i++) {
+    var a = {k:keep};
+    a.a = a; // a cycle, so only the GC can free it
+  }
+}
+
+var results = [];
+for (var pass=1;pass<=4;pass++) {
+  mkGarbage();
+  var inPass = E.stepGC(pass);
+  var m = process.memory(); // full GC
+  results.push(inPass==pass && m.gc>0 && keep.v=="Hello");
+}
+// if keep's refs were wrong it'd be freed here while still referenced
+keep = {v:keep.v};
+process.memory();
+results.push(keep.v=="Hello");
+
+result = results.every(r=>r);
+if (!result) print(results);
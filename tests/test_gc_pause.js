@@ -0,0 +1,8 @@
+// process.memory() reports the longest GC pause since it was last called
+function mk() { for (var i=0;i<50;i++) { var a = {}, b = {a:a}; a.b = b; } }
+mk();
+var m1 = process.memory();
+var m2 = process.memory();
+result = typeof m1.gcpause=="number" && m1.gcpause>=0 &&
+         m1.gc>=200 && // the cycles were freed
+         m2.gc==0 && m2.gcpause<1000;
@@ -0,0 +1,62 @@
+// On Linux, serial devices with a path are read and written by the input
+// thread while the main loop adds to the IO and transmit queues
+var fs = require('fs');
+var f1 = 'tests/test_io_queues1.tmp', f2 = 'tests/test_io_queues2.tmp', f3 = 'tests/test_io_queues3.tmp';
+var results = [];
+
+// Transmit: interleave writes to two devices, so they get many runs in the
+// transmit buffer, with more data than fits so it wraps
+fs.writeFileSync(f1, "");
+fs.writeFileSync(f2, "");
+Serial1.setup(9600, {path:f1});
+Serial2.setup(9600, {path:f2});
+var tx1 = "", tx2 = "";
+for (var i=0;i<500;i++) {
+  var a = "A"+i+",", b = (i&1) ? "b" : "bb"+i+";";
+  Serial1.write(a);
+  Serial2.write(b);
+  tx1 += a;
+  tx2 += b;
+}
+// Receive: the input thread reads Serial3 while the main loop pushes
+// characters for LoopbackA and pin watch events
+var rx3 = "";
+for (var i=0;i<200;i++) rx3 += "Line "+i+" of the data read by the input thread\n";
+fs.writeFileSync(f3, rx3);
+var got3 = "", gotA = "", sentA = "", watches = 0, edges = 0;
+Serial3.on('data', function(d) { got3 += d; });
+LoopbackA.on('data', function(d) { gotA += d; });
+digitalWrite(D5, 0);
+setWatch(function() { watches++; }, D5, {repeat:true, edge:"both"});
+Serial3.setup(9600, {path:f3});
+var n = 0;
+function producer() {
+  for (var j=0;j<10;j++) {
+    var s = "["+n+":"+j+"]";
+    LoopbackA.inject(s);
+    sentA += s;
+    digitalWrite(D5, edges&1 ? 0 : 1);
+    edges++;
+  }
+  if (++n < 50) setTimeout(producer, 1);
+  else setTimeout(check, 200);
+}
+setTimeout(producer, 1);
+
+function check() {
+  results.push(fs.readFileSync(f1) == tx1);
+  results.push(fs.readFileSync(f2) == tx2);
+  results.push(got3 == rx3);
+  results.push(gotA == sentA);
+  results.push(watches == edges);
+  results.push(E.getErrorFlags().length == 0);
+  clearWatch();
+  Serial1.setup(9600, {path:""});
+  Serial2.setup(9600, {path:""});
+  Serial3.setup(9600, {path:""});
+  fs.unlink(f1);
+  fs.unlink(f2);
+  fs.unlink(f3);
+  result = results.every(r=>r);
+  if (!result) console.log(results, got3.length, rx3.length, gotA.length, sentA.length, watches, edges);
+}
@@ -0,0 +1,28 @@
+// JSON.parse uses its own parser rather than the JS lexer
+var results = [];
+
+var o = JSON.parse('{"a":[1,2.5,-3,-0.5e2,true,false,null,"x\\ny\\u0041\\x42\\101"],"b":{},"c":[],}');
+results.push(JSON.stringify(o)=='{"a":[1,2.5,-3,-50,true,false,null,"x\\nyABA"],"b":{},"c":[]}');
+results.push(JSON.stringify(JSON.parse(" /* comment */ [1,2,] // x\n"))=="[1,2]");
+results.push(JSON.parse("0x1F")===31);
+results.push(JSON.parse("'hi'")==="hi");
+results.push(JSON.parse("1e3")===1000);
+results.push(JSON.parse("-.5")===-0.5);
+results.push(JSON.parse('{"0":1,"1":2}')[1]===2);
+
+// errors
+function err(s) { try { JSON.parse(s); } catch (e) { return e instanceof SyntaxError; } return false; }
+results.push(err("[1,"));
+results.push(err('{"a" 1}'));
+results.push(err("foo"));
+results.push(err('"abc'));
+results.push(err("/* abc"));
+results.push(err("-x"));
+
+// round trip
+var big = {a:[], s:"x".repeat(200)};
+for (var i=0;i<50;i++) big.a.push({i:i, f:i/4, s:"q\"\n"+i});
+var s = JSON.stringify(big);
+results.push(JSON.stringify(JSON.parse(s))==s);
+
+result = results.every(r=>r);
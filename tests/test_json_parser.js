@@ -0,0 +1,69 @@
+// Streaming JSON parser
+var results = [];
+var got = [];
+function cb(v,i) { got.push([i,v]); }
+
+// top-level array split at awkward places - each element is returned
+var p = JSON.parser(cb);
+var src = '[{"a":1}, "x,]y" ,123, -4.5e1,[1,[2]], true,null,]';
+for (var i=0;i<src.length;i+=3) p.write(src.substr(i,3));
+p.end();
+results.push(JSON.stringify(got)=='[[0,{"a":1}],[1,"x,]y"],[2,123],[3,-45],[4,[1,[2]]],[5,true],[6,null]]');
+
+// newline-separated values, one character at a time
+got = [];
+p = JSON.parser(cb);
+src = '{"b":2}\n12\n"s" /* c */\nfalse\n3';
+for (var i=0;i<src.length;i++) p.write(src[i]);
+results.push(got.length==4); // 3 may not be finished yet
+p.end();
+results.push(got.every(g=>g[0]===undefined));
+results.push(JSON.stringify(got.map(g=>g[1]))=='[{"b":2},12,"s",false,3]');
+
+// incomplete data is an error at the end
+p = JSON.parser(cb);
+p.write('[1,{"a"');
+try { p.end(); results.push(false); } catch (e) { results.push(e instanceof SyntaxError); }
+// parser can be reused afterwards
+got = [];
+p.end("[5]");
+results.push(JSON.stringify(got)=='[[0,5]]');
+
+// invalid data is an error straight away
+p = JSON.parser(cb);
+try { p.write('[1,}'); results.push(false); } catch (e) { results.push(e instanceof SyntaxError); }
+// control characters in the data are escaped in the error message
+p = JSON.parser(cb);
+try { p.write('[1,\x01]'); results.push(false); } catch (e) { results.push(e.message=="Got '\\1' expected a valid value"); }
+
+// the chunks passed in aren't modified
+got = [];
+var chunk = "[1";
+p = JSON.parser(cb);
+p.write(chunk);
+p.write("]");
+results.push(chunk=="[1" && got.length==1);
+
+// writing to the parser from the callback - the data goes after what's already there
+got = [];
+p = JSON.parser(function(v,i) {
+  got.push(v);
+  if (v==1) p.write(",3,");
+  if (v==3) p.end("]");
+});
+p.write("[1,2");
+results.push(JSON.stringify(got)=="[1,2,3]");
+
+// big values with brackets in strings and comments, split anywhere (these are scanned for their end before being parsed)
+src = '{"a":"[{\\"}]", \'b\':[1,{"c":"\\\\"}], /* } */ "d":{} // ]\n}\n["x]"]';
+var expected = JSON.stringify([{a:'[{"}]', b:[1,{c:"\\"}], d:{}}, "x]"]);
+[1,2,5,7].forEach(function(n) {
+  var values = [];
+  p = JSON.parser(function(v,i) { values.push(i===undefined ? v : [v]); });
+  for (var i=0;i<src.length;i+=n) p.write(src.substr(i,n));
+  p.end();
+  var r = JSON.stringify([values[0],values[1][0]]);
+  results.push(r==expected);
+});
+
+result = results.every(r=>r);
@@ -0,0 +1,43 @@
+// JSON output is buffered, numbers are printed without allocating, and Storage.writeJSON streams to flash if it has to
+var results = [];
+
+var o = {i:-123456, f:1.5e-7, n:NaN, b:true, s:"a\"b\\c\n\u0001\xE9", e:"", a:[1,2.25,[3]], u:undefined};
+results.push(JSON.stringify(o)=='{"i":-123456,"f":1.5e-7,"n":null,"b":true,"s":"a\\"b\\\\c\\n\\u0001\\u00E9","e":"","a":[1,2.25,[3]]}');
+results.push(JSON.stringify([1,"x"],null,1)=='[ \n 1, \n "x"\n ]');
+results.push(JSON.stringify("\"".repeat(100)).length==202);
+// string appends going through printf
+results.push(E.toJS(["\n", 1.5, -7])=='["\\n",1.5,-7]');
+
+var big = {list:[]};
+for (var i=0;i<100;i++) big.list.push({id:i, name:"item"+i, v:i/4});
+var json = JSON.stringify(big);
+results.push(JSON.stringify(JSON.parse(json))==json);
+
+var s = require("Storage");
+s.eraseAll();
+results.push(s.writeJSON("j", big));
+results.push(s.read("j")==json);
+var free = s.getFree();
+results.push(s.writeJSON("j", big)); // same data - no need to rewrite
+results.push(s.getFree()==free);
+big.list[99].v = "changed";
+results.push(s.writeJSON("j", big));
+results.push(s.read("j")==JSON.stringify(big));
+results.push(s.readJSON("j").list[99].v=="changed");
+// the JSON is only created once, so toJSON can return something different each time
+var calls = 0;
+var counter = {toJSON:function() { return "x".repeat(++calls); }};
+results.push(s.writeJSON("c", {c:counter}) && calls==1 && s.read("c")=='{"c":"x"}');
+// too big to fit in RAM - so it's written straight to flash
+var item = {s:"y".repeat(500)};
+var arr = [];
+for (var i=0;i<300;i++) arr.push(item);
+var len = 300*509+1;
+results.push(s.writeJSON("big", arr) && s.read("big").length==len);
+results.push(E.getErrorFlags().indexOf("LOW_MEMORY")<0);
+// ... and if the JSON then changes, we don't leave a partial file
+arr[299] = counter;
+try { s.writeJSON("big2", arr); results.push(false); } catch (e) { results.push(s.read("big2")===undefined); }
+s.eraseAll();
+
+result = results.every(r=>r);
@@ -0,0 +1,29 @@
+// Results of maths on numbers may be stored in a temporary operand rather than a new var
+var results = [];
+var a = 5, b = 2.5, c = 3;
+results.push(a+1==6 && a==5);
+results.push(a*c + b == 17.5 && a==5 && b==2.5 && c==3);
+results.push(1+2*3-4/2 == 5);
+results.push((a+1)*(c+1) == 24);
+var x = a + c;
+var y = x;
+x = x * 2;
+results.push(x==16 && y==8);
+function f() { return a; }
+results.push(f()+1==6 && a==5 && -f()==-5 && a==5);
+var o = { v:7 };
+results.push(o.v*2==14 && o.v==7);
+var arr = [1,2,3];
+results.push(arr[1]+arr[2]==5 && arr[1]==2);
+results.push(-a==-5 && a==5 && -(a+1)==-6);
+var z = 10;
+z += 2.5;
+z -= a;
+results.push(z==7.5 && a==5);
+results.push((3<4)===true && (4<=3)===false && (a==5)===true && (b===2.5)===true);
+results.push(2147483647+1==2147483648 && -2147483648-1==-2147483649);
+results.push(7%-3==1 && isNaN(7%0) && (5/2)==2.5 && (-1>>>0)==4294967295);
+results.push((1.5|0)==1 && (6&3)==2 && (1<<4)==16);
+results.push(1+"2"=="12" && "3"*2==6 && (null+1)==1);
+
+result = results.every(r=>r);
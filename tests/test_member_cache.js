@@ -0,0 +1,32 @@
+// `obj.name` remembers where it found `name` - make sure it notices changes
+var results = [];
+function get(o) { return o.x; }
+var a = {x:1}, b = {x:2, y:3};
+results.push(get(a)==1 && get(a)==1 && get(b)==2 && get(a)==1);
+a.x = 5;
+results.push(get(a)==5);
+delete a.x;
+results.push(get(a)===undefined);
+a.x = 6;
+results.push(get(a)==6);
+// prototypes aren't cached
+var p = {x:7}, c = Object.create(p);
+results.push(get(c)==7);
+p.x = 8;
+results.push(get(c)==8);
+c.x = 9;
+results.push(get(c)==9);
+delete c.x;
+results.push(get(c)==8);
+// objects that get freed and reallocated
+var n = 0;
+for (var i=0;i<20;i++) { var o = {x:i}; n += get(o); }
+results.push(n==190);
+// assignments
+var s = {v:0};
+for (var i=0;i<10;i++) s.v = s.v + i;
+results.push(s.v==45);
+E.defrag();
+results.push(get(b)==2 && get(a)==6);
+
+result = results.every(r=>r);
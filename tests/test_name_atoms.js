@@ -0,0 +1,34 @@
+// Long names share the rest of their characters with other names that end the same way
+var results = [];
+var before = process.memory().usage;
+var objs = [];
+for (var i=0;i<100;i++) objs.push({longPropertyName:i});
+var used = process.memory().usage - before;
+// a var each for the object, its name and the array element - rather than another for the rest of the name
+results.push(used < 350);
+results.push(objs.every((o,i)=>o.longPropertyName===i && o["longProperty"+"Name"]===i));
+results.push(objs[5].longPropertyNamf===undefined && objs[5].longPropertyNam===undefined);
+// same end, different start
+var o = {abcdefghijklmnopq:1, Abcdefghijklmnopq:2, abcdefghijklmnopQ:3};
+results.push(o.abcdefghijklmnopq==1 && o.Abcdefghijklmnopq==2 && o.abcdefghijklmnopQ==3);
+results.push(Object.keys(o).join()=="abcdefghijklmnopq,Abcdefghijklmnopq,abcdefghijklmnopQ");
+// copies, deletes and keys from other objects
+var c = Object.assign({}, objs[7]);
+var k = Object.keys(objs[8])[0];
+results.push(c.longPropertyName==7 && k=="longPropertyName" && objs[9][k]==9);
+delete objs[9].longPropertyName;
+results.push(objs[9].longPropertyName===undefined && objs[10].longPropertyName==10);
+var p = JSON.parse('{"longPropertyName":42,"anotherLongPropertyName":43}');
+results.push(p.longPropertyName==42 && p.anotherLongPropertyName==43 && JSON.stringify(p)=='{"longPropertyName":42,"anotherLongPropertyName":43}');
+// variables in functions
+function f(aVeryLongArgumentName) { var aVeryLongLocalName = aVeryLongArgumentName*2; return aVeryLongLocalName+1; }
+results.push(f(4)==9 && f(5)==11);
+// garbage that the GC has to free
+for (var i=0;i<20;i++) { var g = {aSelfReferencingName:0}; g.aSelfReferencingName = g; }
+g = undefined;
+objs = undefined;
+process.memory();
+results.push(c.longPropertyName==7 && p.longPropertyName==42);
+
+result = results.every(r=>r);
+if (!result) print(results, used);
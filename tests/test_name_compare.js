@@ -0,0 +1,17 @@
+// Names/strings that fit in one var are compared without a string iterator
+var results = [];
+var o = {a:1, ab:2, abc:3, abcd:4, abcdefghijklmnopqrstuvwxyz:5, "":6};
+results.push(o.a==1 && o.ab==2 && o.abc==3 && o.abcd==4);
+results.push(o.abcdefghijklmnopqrstuvwxyz==5 && o.abcdefghijklmnopqrstuvwxy===undefined);
+results.push(o[""]==6 && o["abcd"+""]==4 && o["ab"+"c"]==3);
+results.push(o.abcde===undefined && o.b===undefined);
+var k = E.toString("abc"); // flat string
+results.push(o[k]==3);
+results.push("hello".startsWith("hel") && !"hello".startsWith("help") && "hello".startsWith(""));
+results.push("hello".startsWith("llo",2) && !"hello".startsWith("hello!"));
+results.push("x"=="x" && "x"!="xy" && "xy"!="x" && ""=="");
+// integer-valued names
+o.bob = 42;
+results.push(o.bob==42 && Object.keys(o).indexOf("bob")>=0);
+
+result = results.every(r=>r);
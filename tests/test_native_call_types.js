@@ -0,0 +1,13 @@
+// Builtins are called using code generated for each argument/return type combination
+var results = [];
+results.push(isNaN("37.37")===false && isNaN("x")===true); // bool return
+results.push(Math.pow(2,0.5)==Math.sqrt(2)); // float args and return
+results.push(parseInt("-12")===-12); // int return
+results.push("abc".charCodeAt(1)==98 && "abcdef".substr(-3,2)=="de"); // int args
+results.push(Math.max(3,9,4)==9 && Math.max()==-Infinity); // argument arrays
+results.push([1,2,3].indexOf(3)==2 && [].indexOf(3)==-1);
+results.push(String.fromCharCode(72,105)=="Hi");
+results.push(E.clip(12,0,10)==10 && E.clip(-1.5,-1,1)==-1);
+results.push(new Uint8Array([1,2,300])[2]==44);
+results.push(typeof getTime()=="number");
+result = results.every(r=>r);
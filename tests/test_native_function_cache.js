@@ -0,0 +1,39 @@
+// Built-in functions are reused when referenced again, but only while nothing else has them
+var results = [];
+var s = 0;
+for (var i=0;i<100;i++) s += Math.abs(-i);
+results.push(s==4950);
+results.push(Math.sin===Math.sin); // compared by function, not var
+var f = Math.sin;
+results.push(f(0)==0 && f===Math.sin);
+f.foo = 42; // stored and modified - so we shouldn't get this one back
+results.push(Math.sin.foo===undefined);
+results.push(f.foo===42);
+// separate references never share a var, so properties don't leak between them
+var a = Math.sin, b = Math.sin;
+a.foo = 1;
+results.push(a!==b && b.foo===undefined && Math.sin.foo===undefined);
+var q = setTimeout, r = setTimeout;
+q.x = 5;
+results.push(r.x===undefined);
+function two(x, y) { x.bar = 1; return y.bar; }
+results.push(two(Math.cos, Math.cos)===undefined);
+results.push(Math.sin(0)==0);
+// Same function via different symbols/objects
+results.push([1,2].indexOf(2)==1 && [3].indexOf(3)==0);
+// constructors get a 'prototype' when used
+var a = new Uint8Array(2);
+results.push(a instanceof Uint8Array && new Uint8Array(1) instanceof Uint8Array);
+// Each argument holds a lock on the function, so the cache mustn't hand out one that can't take another
+var args = [];
+for (var i=0;i<20;i++) args.push("Math.cos");
+eval("console.log("+args.join(",")+")");
+results.push(Math.cos(0)==1);
+// The cache only holds a ref, so the GC must still see cached functions as used
+var fns = [];
+for (var i=0;i<100;i++) fns.push(Math.tan);
+fns = undefined;
+process.memory(); // GC
+results.push(Math.tan(0)==0 && Math.tan===Math.tan);
+
+result = results.every(r=>r);
@@ -0,0 +1,49 @@
+// Sockets are served by epoll. There are no timers here - only the open
+// sockets keep us running until every transfer has finished.
+// Some sends are made to fail as if the send buffer was full, so those
+// sockets have to wait for EPOLLOUT before they can send the rest - and
+// while they wait, nothing at all is happening on any socket
+var net = require("net");
+var results = [];
+
+function makeData(n, seed) {
+  var s = "";
+  for (var i=0;i<n;i++) s += String.fromCharCode(32+((i*seed)%90));
+  return s;
+}
+var CLIENTS = 3, SIZE = 20000;
+var sent = [];
+
+var server = net.createServer(function(c) {
+  var rx = "";
+  c.on('data', function(d) {
+    rx += d;
+    if (rx.length < SIZE) return;
+    // first char says which client we are
+    var n = rx.charCodeAt(0)-48;
+    c.end(n+":"+(rx == sent[n]));
+  });
+});
+server.listen(4446);
+
+function client(n) {
+  sent[n] = n+makeData(SIZE-1, n+3);
+  var reply = "";
+  var c = net.connect({port:4446}, function() {
+    E.blockNetSends(n+1);
+    c.write(sent[n]);
+  });
+  c.on('data', function(d) { reply += d; });
+  c.on('close', function() {
+    results.push(reply == n+":true");
+    results.push(E.blockNetSends(0) == 0); // every blocked send was retried
+    if (n+1 < CLIENTS) {
+      client(n+1);
+    } else {
+      server.close();
+      result = results.every(r=>r);
+      if (!result) console.log(results);
+    }
+  });
+}
+client(0);
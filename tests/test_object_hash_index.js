@@ -0,0 +1,41 @@
+// Objects with lots of fields get a hash index of their names
+var results = [];
+var o = {};
+for (var i=0;i<200;i++) o["k"+i] = i;
+var ok = true;
+for (var i=0;i<200;i++) if (o["k"+i]!==i) ok = false;
+results.push(ok);
+results.push(o.k123===123 && o.nope===undefined && !("nope" in o) && ("k7" in o));
+
+// delete lots, in an order that breaks up probe sequences
+for (var i=0;i<200;i+=3) delete o["k"+i];
+ok = true;
+for (var i=0;i<200;i++) if (o["k"+i]!==((i%3)?i:undefined)) ok = false;
+results.push(ok);
+results.push(Object.keys(o).length==133);
+// add them back
+for (var i=0;i<200;i+=3) o["k"+i] = -i;
+results.push(o.k0===0 && o.k3===-3 && o.k199===199 && Object.keys(o).length==200);
+
+// int names aren't indexed, but are still found
+for (var i=0;i<20;i++) o[i] = "i"+i;
+results.push(o[5]=="i5" && o["5"]=="i5" && o.k5===5);
+
+// copying, JSON and removing all fields
+var c = JSON.parse(JSON.stringify(o));
+results.push(c.k151===151 && c[19]=="i19");
+Object.keys(c).forEach(k=>delete c[k]);
+results.push(Object.keys(c).length==0 && c.k1===undefined);
+c.k1 = 1;
+results.push(c.k1===1);
+
+// lots of global variables
+for (var i=0;i<50;i++) eval("var glob"+i+"="+i);
+results.push(glob42==42 && this["glob7"]==7);
+for (var i=0;i<50;i++) delete this["glob"+i];
+results.push(typeof glob42=="undefined");
+
+E.defrag();
+results.push(o.k100===100 && o.k199===199);
+
+result = results.every(r=>r);
@@ -0,0 +1,62 @@
+// RegExps are compiled when created, and matched without backtracking
+var results = [];
+function test(re, str, expected) {
+  var m = re.exec(str);
+  var r = JSON.stringify(m) == JSON.stringify(expected);
+  if (!r) console.log(re, str, "got", m, "expected", expected);
+  results.push(r);
+}
+
+// Things that would take forever with backtracking
+var s = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+results.push(!/(a*)*b/.test(s));
+results.push(!/(a|aa)+c/.test(s));
+results.push(/^(a+)+$/.test(s));
+
+// Groups, alternation and quantifiers
+test(/(a|ab)(c|bcd)(d*)/, "abcd", ["abcd","a","bcd",""]);
+test(/a(b|c)+d/, "xxacbbd", ["acbbd","b"]);
+test(/colou?r/, "my color", ["color"]);
+test(/(?:ab)+/, "xababab", ["ababab"]);
+test(/x|y|z/, "--z", ["z"]);
+test(/a{2,3}/, "caaaa", ["aaa"]);
+test(/a{2}/, "caaaa", ["aa"]);
+test(/a{2,}/, "caaaaa", ["aaaaa"]);
+test(/a{,2}/, "a{,2}", ["a{,2}"]);
+test(/(a{1,2}){2}/, "aaaa", ["aaaa","aa"]);
+test(/(x)?y/, "y", ["y",undefined]);
+// Lazy quantifiers
+test(/<.*?>/, "<a><b>", ["<a>"]);
+test(/a+?/, "aaa", ["a"]);
+// Case insensitive
+test(/[A-Z]+/i, "hello World", ["hello"]);
+test(/HELLO/i, "say hello", ["hello"]);
+
+results.push("x".replace(/(y)?x/,"[$1]")=="[]");
+results.push("ab".replace(/(a)|b/g,function(m,a){return a===undefined?"U":a;})=="aU");
+
+// split on RegExps that can match the empty string
+function split(str, re, expected) {
+  var r = str.split(re);
+  if (r.length!=expected.length || r.some((x,i)=>x!==expected[i])) {
+    console.log(JSON.stringify(str)+".split("+re+") gave", r);
+    results.push(false);
+  } else results.push(true);
+}
+split("x", /(z)?/, ["x"]);
+split("abc", /(?:)/, ["a","b","c"]);
+split("ab", /a*?/, ["a","b"]);
+split("ab", /a*/, ["","b"]);
+split("abc", /$/, ["abc"]);
+split("", /(?:)/, []);
+split("", /x/, [""]);
+// capturing groups go in the result
+split("a1b22c", /(\d+)/, ["a","1","b","22","c"]);
+split("A<B>b</B>", /<(\/)?([^<>]+)>/, ["A",undefined,"B","b","/","B",""]);
+
+// Errors are reported when the RegExp is created
+["(a","a)","*a","[a","(a)\\1","[z-a]"].forEach(function(re) {
+  try { new RegExp(re); results.push(false); } catch (e) { results.push(true); }
+});
+
+result = results.every(r=>r);
@@ -0,0 +1,47 @@
+// Variable lookups are remembered for each position in the code, while the scopes are unchanged
+var results = [];
+var x = "global";
+
+function f() {
+  var r = [];
+  for (var i=0;i<3;i++) {
+    r.push(x);
+    var x = "local"; // added to our scope - must now hide the global
+  }
+  return r.join(",");
+}
+results.push(f()=="global,local,local");
+results.push(f()=="global,local,local"); // new scope each call
+
+function g(obj) {
+  var r = [];
+  for (var i=0;i<3;i++) {
+    r.push(typeof y);
+    if (i==0) y = 1; // new global
+    if (i==1) delete global.y;
+  }
+  return r.join(",");
+}
+results.push(g()=="undefined,number,undefined");
+
+// closures see the right scope each time
+function counter() { var n = 0; return function() { return ++n; }; }
+var c1 = counter(), c2 = counter();
+c1(); c1();
+results.push(c1()==3 && c2()==1);
+
+// a call in the middle of a loop doesn't break lookups in the caller
+function h() { var z = 5; return z; }
+var s = 0;
+for (var j=0;j<10;j++) s += h() + j;
+results.push(s==95);
+
+// catch scopes
+var e = "outer", r2 = [];
+for (var k=0;k<2;k++) {
+  r2.push(e);
+  try { throw "inner"; } catch (e) { r2.push(e); }
+}
+results.push(r2.join(",")=="outer,inner,outer,inner");
+
+result = results.every(r=>r);
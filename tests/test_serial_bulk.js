@@ -0,0 +1,44 @@
+// Serial.inject pushes data in blocks, which go in the bulk character buffer
+// with one event each, like data from USB/DMA would
+var results = [];
+var rxA = "", rxB = "";
+LoopbackA.on('data', function(d) { rxA += d; });
+LoopbackB.on('data', function(d) { rxB += d; });
+
+function makeData(n, seed) {
+  var s = "";
+  for (var i=0;i<n;i++) s += String.fromCharCode(32+((i*seed)%90));
+  return s;
+}
+
+E.getErrorFlags(); // clear flags
+// more than would fit in the event queue as normal character events (1024 events of 4)
+var big = makeData(5000, 7);
+LoopbackA.inject(big);
+
+var round = 0, sentA = "", sentB = "";
+function next() {
+  if (round==0) {
+    results.push(rxA == big);
+    results.push(E.getErrorFlags().indexOf("FIFO_FULL")<0);
+    rxA = "";
+  }
+  if (round<20) {
+    // interleave blocks for two devices, of sizes that wrap around the buffer at different places
+    var a = makeData(300+round*97, round+3), b = makeData(50+round*31, round+5);
+    LoopbackA.inject(a);
+    LoopbackB.inject(b);
+    LoopbackA.inject("xy"); // short, so goes in a normal event
+    sentA += a+"xy";
+    sentB += b;
+    round++;
+    setTimeout(next, 1);
+  } else {
+    results.push(rxA == sentA);
+    results.push(rxB == sentB);
+    results.push(E.getErrorFlags().length == 0);
+    result = results.every(r=>r);
+    if (!result) console.log(results, rxA.length, sentA.length, rxB.length, sentB.length);
+  }
+}
+setTimeout(next, 1);
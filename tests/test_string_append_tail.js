@@ -0,0 +1,31 @@
+// Appending to a string remembers where its end is, so check that's always right
+var results = [];
+
+var a = "", b = "";
+for (var i=0;i<500;i++) {
+  a += i%10;
+  if (i%3==0) b += "<"+i+">"; // interleave appends to different strings
+}
+results.push(a.length==500 && a.substr(490)=="0123456789" && a[123]=="3");
+results.push(b.length==797 && b.substr(0,10)=="<0><3><6><" && b.substr(-5)=="<498>");
+
+// garbage collection and freeing strings shouldn't confuse it
+var c = "Hello";
+for (i=0;i<100;i++) c += " world";
+process.memory(); // GC
+c += "!";
+results.push(c.length==606 && c.substr(-7)==" world!");
+var d = c;
+c = undefined; // d still references the string
+d += "?";
+results.push(d.length==607 && d.substr(-8)==" world!?");
+d = "x";
+for (i=0;i<50;i++) d += "yz";
+results.push(d.length==101 && d.substr(-3)=="zyz");
+
+// appending a string to itself
+var e = "abc";
+for (i=0;i<5;i++) e += e;
+results.push(e.length==96 && e.substr(90)=="abcabc");
+
+result = results.every(r=>r);
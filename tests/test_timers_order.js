@@ -0,0 +1,31 @@
+// Timers are kept ordered by the time they fire at
+var order = [];
+for (var i=0;i<50;i++) {
+  var d = (i*37)%50; // 0..49, shuffled
+  setTimeout(function(d) { order.push(d); }, 5+d*2, d);
+}
+
+// cleared timers don't fire
+var cleared = [];
+for (i=0;i<10;i++)
+  cleared.push(setTimeout(function() { order.push("cleared"); }, 20+i));
+cleared.forEach(function(id) { clearTimeout(id); });
+
+// timers with the same timeout fire in the order they were added
+var same = [];
+for (i=0;i<5;i++) setTimeout(function(n) { same.push(n); }, 30, i);
+
+// changeInterval moves an interval to its new place
+var ticks = 0;
+var iv = setInterval(function() {
+  if (++ticks==3) clearInterval(iv);
+}, 1000);
+changeInterval(iv, 10);
+
+// timers still fire after the same delay if the system time changes
+setTime(getTime()-100);
+
+setTimeout(function() {
+  result = order.length==50 && order.every(function(d,i) { return d===i; }) &&
+           same.join()=="0,1,2,3,4" && ticks==3;
+}, 200);
@@ -0,0 +1,49 @@
+// Watches are dispatched from a per-pin table. On Linux builds with no GPIO,
+// writing to a watched pin fires its watch like a real input would
+var log = [];
+var results = [];
+function w(name) { return function(e) { log.push(name+(e.state?"1":"0")); }; }
+
+digitalWrite([D5,D6,D7], 0);
+var a = setWatch(w("a"), D5, {repeat:true, edge:"rising"});
+var b = setWatch(w("b"), D6, {repeat:true, edge:"both"});
+setWatch(w("c"), D5, {repeat:false, edge:"falling"});
+setWatch(w("d"), D7, {repeat:true, edge:"both", debounce:50});
+var e = setWatch(w("e"), D5, {repeat:true, edge:"both"});
+
+digitalWrite(D5, 1);
+digitalWrite(D6, 1);
+digitalWrite(D5, 0);
+digitalWrite(D5, 1);
+digitalWrite(D8, 1); // not watched
+
+setTimeout(function() {
+  // watches only fire for their own pin and edge, and 'c' is only called once
+  results.push(log.join(",") == "a1,e1,b1,c0,e0,a1,e1");
+  log = [];
+  clearWatch(a);
+  clearWatch(e);
+  digitalWrite(D5, 0);
+  digitalWrite(D5, 1);
+  digitalWrite(D6, 0);
+  // debounced: a short pulse is ignored
+  digitalWrite(D7, 1);
+  digitalWrite(D7, 0);
+}, 10);
+setTimeout(function() {
+  // only 'b' is left (apart from 'd', which is debounced)
+  results.push(log.join(",") == "b0");
+  log = [];
+  digitalWrite(D7, 1);
+}, 100);
+setTimeout(function() {
+  results.push(log.join(",") == "d1");
+  clearWatch();
+  log = [];
+  digitalWrite([D5,D6,D7], 7);
+}, 200);
+setTimeout(function() {
+  results.push(log.length == 0);
+  result = results.every(r=>r);
+  if (!result) console.log(results, log);
+}, 250);